@@ -0,0 +1,320 @@
+// searches the fastest kernel configuration for a device.
+
+// Tuning files hold one line per image size and mask:
+// width height left up right down kernelPath localX localY blockX blockY milliseconds
+
+#include <CL/cl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "autotune.hpp"
+#include "cpu_boxblur.hpp"
+#include "host_utils.hpp"
+#include "pixel_types.hpp"
+#include "program_cache.hpp"
+
+#define TUNE_WARMUP 1 // untimed launches per configuration
+#define TUNE_REPEATS 5 // timed launches per configuration
+
+using namespace std;
+
+static const char* tuneKernels[] = {"./boxblur_naive.cl", "./boxblur_blocking.cl", "./boxblur_blocking_local.cl", "./boxblur_vector.cl"};
+static const cl_int tuneSizes[] = {1, 2, 4, 8, 16, 32}; // candidate local and block sizes per dimension
+
+
+// run one configuration, returns median kernel time in ms or a negative value on failure
+static double time_config (cl_device_id device, cl_command_queue queue, cl_kernel kernel,
+                           cl_mem* buffers, const cl_int* reference, cl_int width, cl_int height, const cl_int* k,
+                           const TuningConfig& config)
+{
+    cl_int ret;
+    cl_int blocksize[2] = {config.blockSize[0], config.blockSize[1]};
+
+    ret = clEnqueueWriteBuffer(queue, buffers[3], CL_TRUE, 0, 2 * sizeof(cl_int), blocksize, 0, NULL, NULL);
+    if (ret != CL_SUCCESS)
+        return -1;
+
+    // tile plus halo for boxblur_blocking_local.cl, unused by the other kernels
+    size_t localmem = (size_t) (k[0] + config.localSize[0] + k[2]) * (k[1] + config.localSize[1] + k[3]) * sizeof(cl_int);
+
+    cl_ulong maxLocalmem;
+    clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &maxLocalmem, NULL);
+
+    if (localmem > maxLocalmem)
+        return -1;
+
+    for (cl_uint i = 0; i < 4; i++)
+        clSetKernelArg(kernel, i, sizeof(cl_mem), (void*) &buffers[i]);
+
+    clSetKernelArg(kernel, 4, localmem, NULL);
+    clSetKernelArg(kernel, 5, sizeof(cl_mem), (void*) &buffers[4]);
+
+    // blocks covering the image, rounded up to whole work groups
+    const size_t localSize[2] = {(size_t) config.localSize[0], (size_t) config.localSize[1]};
+    const size_t globalSizes[2] = {round_up((width + config.blockSize[0] - 1) / config.blockSize[0], localSize[0]),
+                                   round_up((height + config.blockSize[1] - 1) / config.blockSize[1], localSize[1])};
+
+    for (int i = 0; i < TUNE_WARMUP; i++)
+    {
+        ret = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, globalSizes, localSize, 0, NULL, NULL);
+        if (ret != CL_SUCCESS)
+            return -1;
+    }
+
+    // reject configurations with wrong results
+    vector<cl_int> result(width * height);
+
+    ret = clEnqueueReadBuffer(queue, buffers[4], CL_TRUE, 0, width * height * sizeof(cl_int), result.data(), 0, NULL, NULL);
+    if (ret != CL_SUCCESS || !equal(result.begin(), result.end(), reference))
+        return -1;
+
+    vector<double> times;
+
+    for (int i = 0; i < TUNE_REPEATS; i++)
+    {
+        cl_event event;
+
+        ret = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, globalSizes, localSize, 0, NULL, &event);
+        if (ret != CL_SUCCESS)
+            return -1;
+
+        clWaitForEvents(1, &event);
+
+        cl_ulong start, end;
+        clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start, NULL);
+        clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, NULL);
+        clReleaseEvent(event);
+
+        times.push_back((end - start) * 1e-6);
+    }
+
+    sort(times.begin(), times.end());
+
+    return times[times.size() / 2];
+}
+
+
+bool autotune (cl_context context, cl_device_id device, cl_int width, cl_int height, const cl_int* k, TuningConfig* best)
+{
+    cl_int ret;
+
+    cl_command_queue queue = clCreateCommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE, &ret);
+    if (ret != CL_SUCCESS)
+        return false;
+
+    // random test image and its reference result
+    vector<cl_int> image(width * height);
+    vector<cl_int> reference(width * height);
+
+    for (size_t i = 0; i < image.size(); i++)
+        image[i] = rand() % 256;
+
+    cpu_boxblur(image.data(), reference.data(), width, height, k, 0);
+
+    cl_int imageSize[3] = {width, height, width}; // packed rows
+
+    // mask dimensions and the reciprocal of the mask size
+    cl_int params[MASK_PARAMS];
+    mask_params(k, params);
+
+    // image, image size, mask, block size, output
+    cl_mem buffers[5];
+    buffers[0] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, width * height * sizeof(cl_int), image.data(), &ret);
+    buffers[1] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, 3 * sizeof(cl_int), imageSize, &ret);
+    buffers[2] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(params), params, &ret);
+    buffers[3] = clCreateBuffer(context, CL_MEM_READ_ONLY, 2 * sizeof(cl_int), NULL, &ret);
+    buffers[4] = clCreateBuffer(context, CL_MEM_WRITE_ONLY, width * height * sizeof(cl_int), NULL, &ret);
+
+    size_t maxGroupSize;
+    clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(size_t), &maxGroupSize, NULL);
+
+    // run length of the vector kernel, ignored by the others
+    cl_int vectorWidth = vector_width(device);
+
+    ostringstream options;
+    options << "-Werror -D VECTOR_WIDTH=" << vectorWidth;
+
+    best->milliseconds = -1;
+
+    for (size_t i = 0; i < sizeof(tuneKernels) / sizeof(tuneKernels[0]); i++)
+    {
+        string source;
+        if (!read_kernel(tuneKernels[i], &source))
+            continue;
+
+        cl_program program = build_program(context, device, source.c_str(), options.str().c_str(), NULL, &ret);
+        if (ret != CL_SUCCESS)
+        {
+            if (program)
+                clReleaseProgram(program);
+
+            continue;
+        }
+
+        cl_kernel kernel = clCreateKernel(program, "boxblur", &ret);
+
+        size_t kernelGroupSize = maxGroupSize;
+        clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &kernelGroupSize, NULL);
+
+        // the naive kernel computes exactly one pixel per work item,
+        // the vector kernel whole runs of vectorWidth pixels
+        bool blocking = i > 0;
+        bool vector = strstr(tuneKernels[i], "vector") != NULL;
+        size_t numBlockSizes = blocking ? sizeof(tuneSizes) / sizeof(tuneSizes[0]) : 1;
+
+        for (size_t bx = 0; bx < numBlockSizes; bx++)
+        for (size_t by = 0; by < numBlockSizes; by++)
+        for (size_t lx = 0; lx < sizeof(tuneSizes) / sizeof(tuneSizes[0]); lx++)
+        for (size_t ly = 0; ly < sizeof(tuneSizes) / sizeof(tuneSizes[0]); ly++)
+        {
+            TuningConfig config;
+            config.kernelPath = tuneKernels[i];
+            config.blockSize[0] = tuneSizes[bx];
+            config.blockSize[1] = tuneSizes[by];
+            config.localSize[0] = tuneSizes[lx];
+            config.localSize[1] = tuneSizes[ly];
+
+            if (vector && config.blockSize[0] % vectorWidth != 0)
+                continue;
+
+            // the NDRange is rounded up, but a work group should not
+            // be much larger than the whole image
+            if (config.blockSize[0] * config.localSize[0] >= 2 * width ||
+                config.blockSize[1] * config.localSize[1] >= 2 * height)
+                continue;
+
+            if ((size_t) (config.localSize[0] * config.localSize[1]) > kernelGroupSize)
+                continue;
+
+            config.milliseconds = time_config(device, queue, kernel, buffers, reference.data(), width, height, k, config);
+
+            if (config.milliseconds < 0)
+                continue;
+
+            cout << config.kernelPath << " local " << config.localSize[0] << "x" << config.localSize[1]
+                 << " block " << config.blockSize[0] << "x" << config.blockSize[1]
+                 << ": " << config.milliseconds << " ms\n";
+
+            if (best->milliseconds < 0 || config.milliseconds < best->milliseconds)
+                *best = config;
+        }
+
+        clReleaseKernel(kernel);
+        clReleaseProgram(program);
+    }
+
+    for (int i = 0; i < 5; i++)
+        clReleaseMemObject(buffers[i]);
+
+    clReleaseCommandQueue(queue);
+
+    return best->milliseconds >= 0;
+}
+
+
+cl_int vector_width (cl_device_id device)
+{
+    cl_uint preferred = 1;
+    clGetDeviceInfo(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_INT, sizeof(cl_uint), &preferred, NULL);
+
+    // GPUs without vector units report 1 - runs of 4 pixels
+    // still share their loads and the sliding sum
+    cl_int width = 4;
+    while (width < 16 && width < (cl_int) preferred)
+        width *= 2;
+
+    return width;
+}
+
+
+string tuning_path (cl_device_id device, const char* tuningDir)
+{
+    size_t len = 0;
+    clGetDeviceInfo(device, CL_DEVICE_NAME, 0, NULL, &len);
+
+    string name(len, '\0');
+    clGetDeviceInfo(device, CL_DEVICE_NAME, len, &name[0], NULL);
+
+    // device names contain spaces and other characters unsuitable for file names
+    string file;
+    for (size_t i = 0; i < name.size() && name[i] != '\0'; i++)
+        file += isalnum((unsigned char) name[i]) ? name[i] : '_';
+
+    return string(tuningDir) + "/" + file + ".txt";
+}
+
+
+// check if a tuning file line belongs to image size and mask, parse the configuration if it does
+static bool parse_line (const string& line, cl_int width, cl_int height, const cl_int* k, TuningConfig* config)
+{
+    istringstream in(line);
+    cl_int key[6];
+
+    for (int i = 0; i < 6; i++)
+        if (!(in >> key[i]))
+            return false;
+
+    if (key[0] != width || key[1] != height ||
+        key[2] != k[0] || key[3] != k[1] || key[4] != k[2] || key[5] != k[3])
+        return false;
+
+    TuningConfig parsed;
+    if (!(in >> parsed.kernelPath >> parsed.localSize[0] >> parsed.localSize[1]
+             >> parsed.blockSize[0] >> parsed.blockSize[1] >> parsed.milliseconds))
+        return false;
+
+    if (config)
+        *config = parsed;
+
+    return true;
+}
+
+
+bool load_tuning (const string& path, cl_int width, cl_int height, const cl_int* k, TuningConfig* config)
+{
+    ifstream file(path.c_str());
+    string line;
+
+    while (getline(file, line))
+        if (parse_line(line, width, height, k, config))
+            return true;
+
+    return false;
+}
+
+
+bool store_tuning (const string& path, cl_int width, cl_int height, const cl_int* k, const TuningConfig& config)
+{
+    // keep all lines of other image sizes and masks
+    vector<string> lines;
+    {
+        ifstream file(path.c_str());
+        string line;
+
+        while (getline(file, line))
+            if (!parse_line(line, width, height, k, NULL))
+                lines.push_back(line);
+    }
+
+    ostringstream entry;
+    entry << width << " " << height << " " << k[0] << " " << k[1] << " " << k[2] << " " << k[3] << " "
+          << config.kernelPath << " " << config.localSize[0] << " " << config.localSize[1] << " "
+          << config.blockSize[0] << " " << config.blockSize[1] << " " << config.milliseconds;
+    lines.push_back(entry.str());
+
+    mkdir(path.substr(0, path.rfind('/')).c_str(), 0755); // fails harmlessly if directory exists
+
+    ofstream file(path.c_str());
+    for (size_t i = 0; i < lines.size(); i++)
+        file << lines[i] << "\n";
+
+    return file.good();
+}
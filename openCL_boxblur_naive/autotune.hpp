@@ -0,0 +1,37 @@
+// searches the fastest kernel configuration for a device.
+
+#ifndef AUTOTUNE_HPP
+#define AUTOTUNE_HPP
+
+#include <CL/cl.h>
+#include <string>
+
+// configuration of a single "boxblur" kernel launch
+struct TuningConfig
+{
+    std::string kernelPath; // boxblur_naive.cl, boxblur_blocking.cl, boxblur_blocking_local.cl or boxblur_vector.cl
+    cl_int localSize[2]; // work items per work group per dimension
+    cl_int blockSize[2]; // pixels per work item per dimension
+    double milliseconds; // median kernel time
+};
+
+// Times every combination of kernel, work group size and block size
+// for an image of width * height values and mask k = {left, up, right, down},
+// using openCL profiling events. Configurations that do not fit the device
+// or produce wrong results are skipped. Returns false if none works.
+bool autotune (cl_context context, cl_device_id device, cl_int width, cl_int height, const cl_int* k, TuningConfig* best);
+
+// run length of boxblur_vector.cl for a device (build option VECTOR_WIDTH) -
+// its preferred int vector width, at least 4 and at most 16
+cl_int vector_width (cl_device_id device);
+
+// name of the tuning file of a device in tuningDir
+std::string tuning_path (cl_device_id device, const char* tuningDir);
+
+// read the configuration for an image size and mask from a tuning file
+bool load_tuning (const std::string& path, cl_int width, cl_int height, const cl_int* k, TuningConfig* config);
+
+// add or replace the configuration for an image size and mask in a tuning file
+bool store_tuning (const std::string& path, cl_int width, cl_int height, const cl_int* k, const TuningConfig& config);
+
+#endif
@@ -0,0 +1,503 @@
+// blurs many PNG files in a pipeline of decode threads, device launches and encode threads.
+
+#include <CL/cl.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include "batch_blur.hpp"
+#include "png_ops.hpp"
+#include "profiling.hpp"
+
+using namespace std;
+
+#define QUEUE_IMAGES_PER_THREAD 4 // decoded and blurred images waiting per decode/encode thread
+
+
+// decoded or blurred image
+struct BatchImage
+{
+    size_t input; // index into inputs
+    unsigned char* pixels; // malloc'ed, width * height * channels bytes
+    cl_int width;
+    cl_int height;
+    cl_int channels;
+};
+
+// queue between two stages - push blocks while full, pop blocks
+// while empty and returns false once the queue is closed and empty
+class StageQueue
+{
+public:
+    explicit StageQueue (size_t capacity) : capacity(capacity), closed(false) {}
+
+    void push (const BatchImage& image)
+    {
+        unique_lock<mutex> lock(guard);
+        notFull.wait(lock, [this] { return items.size() < capacity; });
+
+        items.push_back(image);
+        notEmpty.notify_one();
+    }
+
+    bool pop (BatchImage* image)
+    {
+        unique_lock<mutex> lock(guard);
+        notEmpty.wait(lock, [this] { return !items.empty() || closed; });
+
+        if (items.empty())
+            return false;
+
+        *image = items.front();
+        items.pop_front();
+        notFull.notify_one();
+
+        return true;
+    }
+
+    // no more pushes - wakes up all waiting pops
+    void close ()
+    {
+        lock_guard<mutex> lock(guard);
+        closed = true;
+        notEmpty.notify_all();
+    }
+
+private:
+    deque<BatchImage> items;
+    size_t capacity;
+    bool closed;
+
+    mutex guard;
+    condition_variable notFull;
+    condition_variable notEmpty;
+};
+
+// device buffers and host staging memory of one launch
+struct BatchSlot
+{
+    cl_mem d_input;
+    cl_mem d_output;
+    cl_mem d_imageSize;
+    size_t deviceBytes; // size of d_input and d_output
+
+    unsigned char* h_input; // packed images
+    unsigned char* h_output;
+    size_t hostBytes; // size of h_input and h_output
+
+    cl_int imageSize[2]; // packed width and height
+    vector<BatchImage> images; // images of the launch
+    vector<cl_int> firstRows; // row of every image in the packed image
+    cl_event done; // download of the launch, NULL if the slot is free
+};
+
+
+// grow buffers of a slot to bytes
+static cl_int reserve_slot (cl_context context, BatchSlot* slot, size_t bytes)
+{
+    cl_int ret = CL_SUCCESS;
+
+    if (bytes > slot->hostBytes)
+    {
+        free(slot->h_input);
+        free(slot->h_output);
+
+        slot->h_input = (unsigned char*) malloc (bytes);
+        slot->h_output = (unsigned char*) malloc (bytes);
+        slot->hostBytes = slot->h_input && slot->h_output ? bytes : 0;
+
+        if (!slot->hostBytes)
+            return CL_OUT_OF_HOST_MEMORY;
+    }
+
+    if (bytes > slot->deviceBytes)
+    {
+        if (slot->d_input)
+            clReleaseMemObject(slot->d_input);
+
+        if (slot->d_output)
+            clReleaseMemObject(slot->d_output);
+
+        slot->d_input = clCreateBuffer(context, CL_MEM_READ_ONLY, bytes, NULL, &ret);
+        slot->d_output = NULL;
+
+        if (ret == CL_SUCCESS)
+            slot->d_output = clCreateBuffer(context, CL_MEM_WRITE_ONLY, bytes, NULL, &ret);
+
+        slot->deviceBytes = ret == CL_SUCCESS ? bytes : 0;
+    }
+
+    return ret;
+}
+
+
+// pack the images of a slot and enqueue upload, kernel and download
+static cl_int launch_slot (cl_context context, cl_command_queue queue, cl_kernel* kernels, cl_mem d_mask,
+                           const cl_int* k, BatchSlot* slot)
+{
+    cl_int ret;
+    cl_int channels = slot->images[0].channels;
+    cl_int gap = max(k[1], k[3]); // zero rows between images
+
+    // stack images, widest one defines the row length
+    cl_int width = 0;
+    cl_int height = 0;
+    slot->firstRows.clear();
+
+    for (size_t i = 0; i < slot->images.size(); i++)
+    {
+        if (i > 0)
+            height += gap;
+
+        slot->firstRows.push_back(height);
+        width = max(width, slot->images[i].width);
+        height += slot->images[i].height;
+    }
+
+    size_t rowBytes = (size_t) width * channels;
+    size_t bytes = rowBytes * height;
+
+    ret = reserve_slot(context, slot, bytes);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    // a single image needs no padding
+    if (slot->images.size() > 1)
+        memset(slot->h_input, 0, bytes);
+
+    for (size_t i = 0; i < slot->images.size(); i++)
+    {
+        const BatchImage& image = slot->images[i];
+        size_t imageRowBytes = (size_t) image.width * channels;
+
+        for (cl_int y = 0; y < image.height; y++)
+            memcpy(slot->h_input + (slot->firstRows[i] + y) * rowBytes, image.pixels + y * imageRowBytes, imageRowBytes);
+    }
+
+    slot->imageSize[0] = width;
+    slot->imageSize[1] = height;
+
+    // the queue is in-order - no events needed between the commands of a launch
+    ret = clEnqueueWriteBuffer(queue, slot->d_input, CL_FALSE, 0, bytes, slot->h_input, 0, NULL, NULL);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    ret = clEnqueueWriteBuffer(queue, slot->d_imageSize, CL_FALSE, 0, 2 * sizeof(cl_int), slot->imageSize, 0, NULL, NULL);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    cl_kernel kernel = kernels[channels == 1 ? 1 : 0];
+
+    clSetKernelArg(kernel, 0, sizeof(cl_mem), (void*) &slot->d_input);
+    clSetKernelArg(kernel, 1, sizeof(cl_mem), (void*) &slot->d_imageSize);
+    clSetKernelArg(kernel, 2, sizeof(cl_mem), (void*) &d_mask);
+    clSetKernelArg(kernel, 3, sizeof(cl_mem), (void*) &slot->d_output);
+
+    // one work item per pixel
+    const size_t globalSizes[2] = {(size_t) width, (size_t) height};
+
+    ret = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, globalSizes, NULL, 0, NULL, NULL);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    ret = clEnqueueReadBuffer(queue, slot->d_output, CL_FALSE, 0, bytes, slot->h_output, 0, NULL, &slot->done);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    // start right away - the next slot is packed meanwhile
+    return clFlush(queue);
+}
+
+
+// wait for the launch of a slot and hand its images to the encoders
+static cl_int retire_slot (BatchSlot* slot, StageQueue* encodeQueue, atomic<cl_int>* failed)
+{
+    if (!slot->done)
+        return CL_SUCCESS;
+
+    cl_int ret = clWaitForEvents(1, &slot->done);
+    clReleaseEvent(slot->done);
+    slot->done = NULL;
+
+    size_t rowBytes = (size_t) slot->imageSize[0] * slot->images[0].channels;
+
+    for (size_t i = 0; i < slot->images.size(); i++)
+    {
+        BatchImage image = slot->images[i];
+
+        // unpack into the decoded image's memory - the input is not needed anymore
+        if (ret == CL_SUCCESS)
+        {
+            size_t imageRowBytes = (size_t) image.width * image.channels;
+
+            for (cl_int y = 0; y < image.height; y++)
+                memcpy(image.pixels + y * imageRowBytes, slot->h_output + (slot->firstRows[i] + y) * rowBytes, imageRowBytes);
+
+            encodeQueue->push(image);
+        }
+        else
+        {
+            free(image.pixels);
+            (*failed)++;
+        }
+    }
+
+    slot->images.clear();
+
+    return ret;
+}
+
+
+cl_int batch_blur (cl_context context, cl_device_id device, cl_program program,
+                   const vector<string>& inputs, const char* outputDir, const cl_int* k,
+                   cl_int decodeThreads, cl_int encodeThreads, cl_int slots, cl_int packImages, BatchStats* stats)
+{
+    cl_int ret;
+
+    // every stage needs at least one thread
+    decodeThreads = max(decodeThreads, 1);
+    encodeThreads = max(encodeThreads, 1);
+    slots = max(slots, 1);
+    packImages = max(packImages, 1);
+
+    stats->written = 0;
+    stats->failed = 0;
+    stats->launches = 0;
+
+    double start = host_time_ms();
+
+    mkdir(outputDir, 0755); // fails harmlessly if directory exists
+
+    cl_command_queue queue = clCreateCommandQueue(context, device, 0, &ret);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    cl_kernel kernels[2] = {NULL, NULL}; // RGBA, grayscale
+    cl_mem d_mask = NULL;
+
+    kernels[0] = clCreateKernel(program, "boxblur", &ret);
+
+    if (ret == CL_SUCCESS)
+        kernels[1] = clCreateKernel(program, "boxblur_gray", &ret);
+
+    if (ret == CL_SUCCESS)
+        d_mask = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, 4 * sizeof(cl_int), (void*) k, &ret);
+
+    vector<BatchSlot> ring(slots);
+
+    for (cl_int s = 0; s < slots; s++)
+    {
+        BatchSlot& slot = ring[s];
+        slot.d_input = slot.d_output = slot.d_imageSize = NULL;
+        slot.h_input = slot.h_output = NULL;
+        slot.deviceBytes = slot.hostBytes = 0;
+        slot.done = NULL;
+
+        if (ret == CL_SUCCESS)
+            slot.d_imageSize = clCreateBuffer(context, CL_MEM_READ_ONLY, 2 * sizeof(cl_int), NULL, &ret);
+    }
+
+    StageQueue decodeQueue(decodeThreads * QUEUE_IMAGES_PER_THREAD + packImages);
+    StageQueue encodeQueue(encodeThreads * QUEUE_IMAGES_PER_THREAD + slots * packImages);
+
+    atomic<size_t> nextInput(0);
+    atomic<cl_int> runningDecoders(decodeThreads);
+    atomic<cl_int> written(0);
+    atomic<cl_int> failed(0);
+
+    // decode stage - every thread takes the next file until none is left
+    vector<thread> decoders;
+
+    for (cl_int t = 0; t < decodeThreads; t++)
+        decoders.push_back(thread([&] {
+            for (size_t i = nextInput++; i < inputs.size(); i = nextInput++)
+            {
+                BatchImage image;
+                image.input = i;
+                image.pixels = load_png(inputs[i].c_str(), &image.width, &image.height, &image.channels);
+
+                if (image.pixels)
+                    decodeQueue.push(image);
+                else
+                    failed++;
+            }
+
+            // the last decoder ends the stage
+            if (--runningDecoders == 0)
+                decodeQueue.close();
+        }));
+
+    // encode stage
+    vector<thread> encoders;
+
+    for (cl_int t = 0; t < encodeThreads; t++)
+        encoders.push_back(thread([&] {
+            BatchImage image;
+
+            while (encodeQueue.pop(&image))
+            {
+                if (save_png(batch_output_path(inputs[image.input], outputDir).c_str(), image.pixels, image.width, image.height, image.channels))
+                    written++;
+                else
+                    failed++;
+
+                free(image.pixels);
+            }
+        }));
+
+    // launch stage - fill slots round robin, waiting for a slot's previous launch before reusing it
+    BatchImage next;
+    bool haveNext = decodeQueue.pop(&next);
+    cl_int s = 0;
+
+    while (haveNext)
+    {
+        BatchSlot& slot = ring[s];
+        s = (s + 1) % slots;
+
+        if (ret == CL_SUCCESS)
+            ret = retire_slot(&slot, &encodeQueue, &failed);
+
+        // images of one launch need the same kernel
+        slot.images.push_back(next);
+        haveNext = decodeQueue.pop(&next);
+
+        while (haveNext && (cl_int) slot.images.size() < packImages && next.channels == slot.images[0].channels)
+        {
+            slot.images.push_back(next);
+            haveNext = decodeQueue.pop(&next);
+        }
+
+        if (ret == CL_SUCCESS)
+            ret = launch_slot(context, queue, kernels, d_mask, k, &slot);
+
+        if (ret == CL_SUCCESS)
+            stats->launches++;
+        else
+        {
+            // keep draining the decoders, so they do not block
+            failed += (cl_int) slot.images.size();
+
+            if (slot.done)
+            {
+                clWaitForEvents(1, &slot.done);
+                clReleaseEvent(slot.done);
+                slot.done = NULL;
+            }
+
+            for (size_t i = 0; i < slot.images.size(); i++)
+                free(slot.images[i].pixels);
+
+            slot.images.clear();
+        }
+    }
+
+    for (cl_int i = 0; i < slots; i++)
+    {
+        cl_int retired = retire_slot(&ring[i], &encodeQueue, &failed);
+
+        if (ret == CL_SUCCESS)
+            ret = retired;
+    }
+
+    encodeQueue.close();
+
+    for (size_t t = 0; t < decoders.size(); t++)
+        decoders[t].join();
+
+    for (size_t t = 0; t < encoders.size(); t++)
+        encoders[t].join();
+
+    stats->written = written;
+    stats->failed = failed;
+    stats->milliseconds = host_time_ms() - start;
+
+    for (cl_int i = 0; i < slots; i++)
+    {
+        BatchSlot& slot = ring[i];
+        cl_mem mems[] = {slot.d_input, slot.d_output, slot.d_imageSize};
+
+        for (int m = 0; m < 3; m++)
+            if (mems[m])
+                clReleaseMemObject(mems[m]);
+
+        free(slot.h_input);
+        free(slot.h_output);
+    }
+
+    if (d_mask)
+        clReleaseMemObject(d_mask);
+
+    for (int i = 0; i < 2; i++)
+        if (kernels[i])
+            clReleaseKernel(kernels[i]);
+
+    clReleaseCommandQueue(queue);
+
+    if (ret != CL_SUCCESS)
+        cout << "batch_blur: " << ret << "\n";
+
+    return ret;
+}
+
+
+static bool ends_with (const string& text, const string& suffix)
+{
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+
+bool batch_inputs (const char* path, vector<string>* inputs)
+{
+    struct stat info;
+
+    if (stat(path, &info) != 0)
+        return false;
+
+    if (S_ISDIR(info.st_mode))
+    {
+        DIR* dir = opendir(path);
+        if (!dir)
+            return false;
+
+        for (struct dirent* entry = readdir(dir); entry; entry = readdir(dir))
+        {
+            string name = entry->d_name;
+
+            if (ends_with(name, ".png") || ends_with(name, ".PNG"))
+                inputs->push_back(string(path) + "/" + name);
+        }
+
+        closedir(dir);
+        sort(inputs->begin(), inputs->end());
+
+        return true;
+    }
+
+    // list file - one path per line
+    ifstream list(path);
+    string line;
+
+    while (getline(list, line))
+        if (!line.empty())
+            inputs->push_back(line);
+
+    return true;
+}
+
+
+string batch_output_path (const string& input, const char* outputDir)
+{
+    size_t slash = input.find_last_of('/');
+
+    return string(outputDir) + "/" + (slash == string::npos ? input : input.substr(slash + 1));
+}
@@ -0,0 +1,43 @@
+// blurs many PNG files in a pipeline of decode threads, device launches and encode threads.
+
+#ifndef BATCH_BLUR_HPP
+#define BATCH_BLUR_HPP
+
+#include <CL/cl.h>
+#include <string>
+#include <vector>
+
+// result of a batch
+struct BatchStats
+{
+    cl_int written; // blurred files written
+    cl_int failed; // files that could not be read, blurred or written
+    cl_int launches; // kernel launches (fewer than files when packing)
+    double milliseconds; // from the first decode to the last encode
+};
+
+// Blurs every input file into outputDir (same file name) with the kernels
+// "boxblur" and "boxblur_gray" of program (boxblur_rgba.cl). Three stages
+// run at the same time:
+//   - decodeThreads threads read PNG files
+//   - the calling thread uploads, launches and downloads on a ring of slots
+//     device buffer sets, so up to slots launches are in flight
+//   - encodeThreads threads write PNG files
+// Stages are connected by bounded queues, so memory stays bounded too.
+
+// packImages > 1 packs up to packImages decoded images with the same number
+// of channels into one buffer and one launch. They are stacked vertically,
+// padded with zero columns to the widest one and separated by
+// max(up, down) zero rows. The kernel adds 0 beyond the image edges, so
+// every image is blurred exactly as if it was launched alone.
+cl_int batch_blur (cl_context context, cl_device_id device, cl_program program,
+                   const std::vector<std::string>& inputs, const char* outputDir, const cl_int* k,
+                   cl_int decodeThreads, cl_int encodeThreads, cl_int slots, cl_int packImages, BatchStats* stats);
+
+// PNG files of a directory (sorted by name) or the lines of a list file
+bool batch_inputs (const char* path, std::vector<std::string>* inputs);
+
+// output path of an input file - its file name in outputDir
+std::string batch_output_path (const std::string& input, const char* outputDir);
+
+#endif
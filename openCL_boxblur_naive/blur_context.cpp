@@ -0,0 +1,229 @@
+// keeps context, queue, kernel and buffers of a blur alive across many images.
+
+#include <CL/cl.h>
+#include <string.h>
+#include <sstream>
+
+#include "blur_context.hpp"
+#include "host_utils.hpp"
+#include "pixel_types.hpp"
+#include "program_cache.hpp"
+
+using namespace std;
+
+
+BlurContext::BlurContext (cl_device_id device, const TuningConfig& config, const char* cacheDir, cl_int* ret)
+    : device(device), capacity(0), stencilMask(false)
+{
+    string source;
+
+    if (!read_kernel(config.kernelPath.c_str(), &source))
+    {
+        *ret = CL_INVALID_VALUE;
+        return;
+    }
+
+    // written with the first image
+    memset(mask, 0, sizeof(mask));
+
+    *ret = init(device, source, config, cacheDir);
+}
+
+
+BlurContext::BlurContext (cl_device_id device, const Stencil& stencil, const TuningConfig& config, const char* cacheDir, cl_int* ret)
+    : device(device), capacity(0), stencilMask(true)
+{
+    // the generated image kernel ignores plane offsets
+    if (!stencil_is_planar(stencil))
+    {
+        *ret = CL_INVALID_VALUE;
+        return;
+    }
+
+    // fixed for all images
+    stencil_extent(stencil, mask);
+
+    *ret = init(device, generate_stencil_source(stencil), config, cacheDir);
+}
+
+
+cl_int BlurContext::init (cl_device_id device, const string& source, const TuningConfig& config, const char* cacheDir)
+{
+    cl_int ret;
+
+    memset(imageSize, 0, sizeof(imageSize));
+    localSize[0] = config.localSize[0];
+    localSize[1] = config.localSize[1];
+    blockSize[0] = config.blockSize[0];
+    blockSize[1] = config.blockSize[1];
+
+    clContext.reset(clCreateContext(NULL, 1, &device, NULL, NULL, &ret));
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    clQueue.reset(clCreateCommandQueue(clContext.get(), device, 0, &ret));
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    // run length of the vector kernel - the other kernels ignore it
+    cl_int vectorWidth = vector_width(device);
+
+    if (config.kernelPath.find("boxblur_vector.cl") != string::npos)
+        blockSize[0] = (cl_int) round_up(blockSize[0], vectorWidth);
+
+    ostringstream options;
+    options << "-Werror -D VECTOR_WIDTH=" << vectorWidth;
+
+    program.reset(build_program(clContext.get(), device, source.c_str(), options.str().c_str(), cacheDir, &ret));
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    kernel.reset(clCreateKernel(program.get(), "boxblur", &ret));
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    d_imageSize.reset(clCreateBuffer(clContext.get(), CL_MEM_READ_ONLY, 3 * sizeof(cl_int), NULL, &ret));
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    // mask dimensions and the reciprocal of the mask size
+    cl_int params[MASK_PARAMS];
+    mask_params(mask, params);
+
+    d_mask.reset(clCreateBuffer(clContext.get(), CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(params), params, &ret));
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    d_blockSize.reset(clCreateBuffer(clContext.get(), CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, 2 * sizeof(cl_int), blockSize, &ret));
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    // arguments that never change - the images are set by reserve()
+    cl_mem args[3] = {d_imageSize.get(), d_mask.get(), d_blockSize.get()};
+
+    for (cl_uint i = 0; i < 3; i++)
+    {
+        ret = clSetKernelArg(kernel.get(), i + 1, sizeof(cl_mem), (void*) &args[i]);
+        if (ret != CL_SUCCESS)
+            return ret;
+    }
+
+    // local memory of a work group tile plus mask halo (see boxblur_blocking_local.cl)
+    return clSetKernelArg(kernel.get(), 4, (size_t) (mask[0] + localSize[0] + mask[2]) * (mask[1] + localSize[1] + mask[3]) * sizeof(cl_int), NULL);
+}
+
+
+cl_int BlurContext::reserve (size_t bytes)
+{
+    cl_int ret;
+
+    if (bytes <= capacity)
+        return CL_SUCCESS;
+
+    // the old buffers live on until the calls still using them are done
+    d_image.reset(clCreateBuffer(clContext.get(), CL_MEM_READ_ONLY, bytes, NULL, &ret));
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    d_blurred.reset(clCreateBuffer(clContext.get(), CL_MEM_WRITE_ONLY, bytes, NULL, &ret));
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    capacity = bytes;
+
+    cl_mem input = d_image.get();
+    cl_mem output = d_blurred.get();
+
+    ret = clSetKernelArg(kernel.get(), 0, sizeof(cl_mem), (void*) &input);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    return clSetKernelArg(kernel.get(), 5, sizeof(cl_mem), (void*) &output);
+}
+
+
+cl_int BlurContext::update_sizes (cl_int width, cl_int height, const cl_int* k)
+{
+    cl_int ret;
+    cl_int newSize[3] = {width, height, width};
+
+    // blocking writes - the host arrays change with the next different call
+    if (memcmp(newSize, imageSize, sizeof(imageSize)) != 0)
+    {
+        ret = clEnqueueWriteBuffer(clQueue.get(), d_imageSize.get(), CL_TRUE, 0, sizeof(newSize), newSize, 0, NULL, NULL);
+        if (ret != CL_SUCCESS)
+            return ret;
+
+        memcpy(imageSize, newSize, sizeof(imageSize));
+    }
+
+    if (!stencilMask && memcmp(k, mask, sizeof(mask)) != 0)
+    {
+        cl_int params[MASK_PARAMS];
+        mask_params(k, params);
+
+        ret = clEnqueueWriteBuffer(clQueue.get(), d_mask.get(), CL_TRUE, 0, sizeof(params), params, 0, NULL, NULL);
+        if (ret != CL_SUCCESS)
+            return ret;
+
+        memcpy(mask, k, sizeof(mask));
+
+        // the tile halo grows with the mask
+        return clSetKernelArg(kernel.get(), 4, (size_t) (mask[0] + localSize[0] + mask[2]) * (mask[1] + localSize[1] + mask[3]) * sizeof(cl_int), NULL);
+    }
+
+    return CL_SUCCESS;
+}
+
+
+cl_int BlurContext::blur_async (const cl_int* image, cl_int* output, cl_int width, cl_int height, const cl_int* k, cl_event* done)
+{
+    cl_int ret;
+    size_t bytes = (size_t) width * height * sizeof(cl_int);
+
+    *done = NULL;
+
+    ret = reserve(bytes);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    ret = update_sizes(width, height, k);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    // the queue is in-order - no events needed between the commands of a call
+    ret = clEnqueueWriteBuffer(clQueue.get(), d_image.get(), CL_FALSE, 0, bytes, image, 0, NULL, NULL);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    // enough blocks to cover the image, rounded up to whole work groups
+    const size_t globalSizes[2] = {round_up((width + blockSize[0] - 1) / blockSize[0], localSize[0]),
+                                   round_up((height + blockSize[1] - 1) / blockSize[1], localSize[1])};
+    const size_t localSizes[2] = {(size_t) localSize[0], (size_t) localSize[1]};
+
+    ret = clEnqueueNDRangeKernel(clQueue.get(), kernel.get(), 2, NULL, globalSizes, localSizes, 0, NULL, NULL);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    ret = clEnqueueReadBuffer(clQueue.get(), d_blurred.get(), CL_FALSE, 0, bytes, output, 0, NULL, done);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    // submit now, the caller may not wait for a while
+    return clFlush(clQueue.get());
+}
+
+
+cl_int BlurContext::blur (const cl_int* image, cl_int* output, cl_int width, cl_int height, const cl_int* k)
+{
+    cl_event done;
+    cl_int ret = blur_async(image, output, width, height, k, &done);
+
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    ret = clWaitForEvents(1, &done);
+    clReleaseEvent(done);
+
+    return ret;
+}
@@ -0,0 +1,106 @@
+// keeps context, queue, kernel and buffers of a blur alive across many images.
+
+#ifndef BLUR_CONTEXT_HPP
+#define BLUR_CONTEXT_HPP
+
+#include <CL/cl.h>
+#include <string>
+
+#include "autotune.hpp"
+#include "stencil.hpp"
+
+// owns one reference to an openCL object and releases it on destruction
+template <class T, cl_int (CL_API_CALL *Release) (T)>
+class ClHandle
+{
+public:
+    ClHandle () : object(NULL) {}
+    explicit ClHandle (T object) : object(object) {}
+    ~ClHandle () { reset(NULL); }
+
+    T get () const { return object; }
+
+    // release the current object and take ownership of other
+    void reset (T other)
+    {
+        if (object)
+            Release(object);
+
+        object = other;
+    }
+
+private:
+    ClHandle (const ClHandle&);
+    ClHandle& operator= (const ClHandle&);
+
+    T object;
+};
+
+typedef ClHandle<cl_context, clReleaseContext> ClContext;
+typedef ClHandle<cl_command_queue, clReleaseCommandQueue> ClQueue;
+typedef ClHandle<cl_program, clReleaseProgram> ClProgram;
+typedef ClHandle<cl_kernel, clReleaseKernel> ClKernel;
+typedef ClHandle<cl_mem, clReleaseMemObject> ClMem;
+
+// Blurs any number of images with one direct engine kernel (boxblur_naive.cl,
+// boxblur_blocking.cl, boxblur_blocking_local.cl, boxblur_vector.cl or a
+// generated stencil kernel). Context, queue and kernel are created once, the
+// image buffers grow to the largest image seen and are reused, so a call only
+// costs its transfers and the kernel. Image rows are packed (pitch == width).
+class BlurContext
+{
+public:
+    // box blur with config's kernel, work group and block size
+    BlurContext (cl_device_id device, const TuningConfig& config, const char* cacheDir, cl_int* ret);
+
+    // stencil kernel with config's work group and block size (config.kernelPath is not used)
+    BlurContext (cl_device_id device, const Stencil& stencil, const TuningConfig& config, const char* cacheDir, cl_int* ret);
+
+    // Enqueues upload, kernel and download of an image and returns without
+    // waiting. done is the download event - wait for it, then release it.
+    // image and output must stay valid until then. Calls run in order of
+    // submission. k = {left, up, right, down} is ignored by stencil contexts.
+    // A call with other image or mask sizes than the last one waits for the
+    // previous calls before updating the size buffers.
+    cl_int blur_async (const cl_int* image, cl_int* output, cl_int width, cl_int height, const cl_int* k, cl_event* done);
+
+    // blur_async and wait for the result
+    cl_int blur (const cl_int* image, cl_int* output, cl_int width, cl_int height, const cl_int* k);
+
+    cl_context context () const { return clContext.get(); }
+    cl_command_queue queue () const { return clQueue.get(); }
+
+private:
+    BlurContext (const BlurContext&);
+    BlurContext& operator= (const BlurContext&);
+
+    cl_int init (cl_device_id device, const std::string& source, const TuningConfig& config, const char* cacheDir);
+
+    // grow image buffers to at least bytes
+    cl_int reserve (size_t bytes);
+
+    // write image and mask sizes if they changed since the last call
+    cl_int update_sizes (cl_int width, cl_int height, const cl_int* k);
+
+    cl_device_id device;
+    ClContext clContext;
+    ClQueue clQueue;
+    ClProgram program;
+    ClKernel kernel;
+
+    ClMem d_image; // capacity bytes each
+    ClMem d_blurred;
+    size_t capacity;
+
+    ClMem d_imageSize;
+    ClMem d_mask;
+    ClMem d_blockSize;
+
+    cl_int imageSize[3]; // contents of the size buffers - width, height, row pitch
+    cl_int mask[4];
+    cl_int blockSize[2];
+    cl_int localSize[2];
+    bool stencilMask; // mask is the stencil's reach
+};
+
+#endif
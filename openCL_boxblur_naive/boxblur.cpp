@@ -1,136 +1,1390 @@
 // the host program for boxblur_x.cl.
 
+// build: g++ -O3 -march=native boxblur.cpp cpu_boxblur.cpp program_cache.cpp kernel_variants.cpp autotune.cpp strip_stream.cpp iterated_blur.cpp stencil.cpp jacobi.cpp multi_device.cpp blur_context.cpp batch_blur.cpp tiled_image.cpp tiled_stream.cpp volume_blur.cpp pixel_types.cpp profiling.cpp png_ops.cpp host_utils.cpp -lOpenCL -lpng -pthread
+
 #include <CL/cl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <sys/stat.h>
 #include <iostream>
-//#include "png_ops.hpp"
+#include <algorithm>
+#include <thread>
+#include "png_ops.hpp"
+#include "cpu_boxblur.hpp"
+#include "program_cache.hpp"
+#include "kernel_variants.hpp"
+#include "autotune.hpp"
+#include "strip_stream.hpp"
+#include "iterated_blur.hpp"
+#include "stencil.hpp"
+#include "jacobi.hpp"
+#include "multi_device.hpp"
+#include "blur_context.hpp"
+#include "batch_blur.hpp"
+#include "tiled_image.hpp"
+#include "tiled_stream.hpp"
+#include "volume_blur.hpp"
+#include "pixel_types.hpp"
+#include "profiling.hpp"
+#include "host_utils.hpp"
+
+
+// image size (any size - the NDRange is rounded up)
+#define IMAGE_WIDTH 8
+#define IMAGE_HEIGHT 8
+
+// "k" parameters for box blur
+#define MASK_SIZE_LEFT 1
+#define MASK_SIZE_UP 1
+#define MASK_SIZE_RIGHT 1
+#define MASK_SIZE_DOWN 1
+
+// work item/group settings - defaults if no tuned configuration
+// exists for the device (see "boxblur --autotune")
+#define LOCAL_X 4
+#define LOCAL_Y 4
+#define THREAD_NUM 4 // number of threads (defines block size - NEEDS TO BE ADJUSTED IF BLOCKS ARE NOT USED!)
+
+// device settings
+#define DEVICE_TYPE CL_DEVICE_TYPE_GPU // type of device to use - can be changed to CPU for debugging
+#define VERIFY_RESULT 1 // compare device result with native host implementation
+#define CPU_THREADS 0 // number of threads of native host implementation (0 = all hardware threads)
+#define ZERO_COPY 0 // map host-accessible device buffers instead of copying from/to malloc'ed memory
+#define PROFILING 0 // write timing report of all host phases and device commands
+#define PROFILE_REPORT "./boxblur_profile.json" // report file (".csv" for CSV, else JSON)
+#define PITCHED_ROWS 1 // pad image rows to the device's alignment (direct engine), else rows are packed
+
+#define PRINT_MAX_SIZE 32 // input and result matrices are printed up to this width and height
+
+#define MEM_SIZE (128)
+#define MAX_SOURCE_SIZE (10000)
+
+// box blur engine - KERNEL_PATH has to match the chosen engine
+#define ENGINE_DIRECT 0 // one kernel computes the full mask per pixel (boxblur_naive.cl, boxblur_blocking.cl, boxblur_blocking_local.cl, boxblur_vector.cl)
+#define ENGINE_SAT 1 // summed-area table, cost per pixel independent of mask size (boxblur_sat.cl)
+#define ENGINE_SEPARABLE 2 // horizontal + vertical sliding window pass, cost per pixel independent of mask size (boxblur_separable.cl)
+#define ENGINE_BORDER 3 // check-free interior kernel plus border kernel with selectable border mode (boxblur_border.cl)
+#define ENGINE ENGINE_DIRECT
+
+// values used for positions outside of the image - BORDER_ZERO, BORDER_CLAMP,
+// BORDER_MIRROR or BORDER_WRAP (see cpu_boxblur.hpp), other modes than BORDER_ZERO need ENGINE_BORDER
+#define BORDER_MODE BORDER_ZERO
+
+#define SCAN_LOCAL_SIZE 64 // work items per row in the summed-area table prefix scan
+
+// openCL paths
+#define KERNEL_PATH "./boxblur_blocking_local.cl"
+#define VECTOR_KERNEL_PATH "./boxblur_vector.cl" // direct kernel computing runs of the device's vector width per work item
+#define KERNEL_NAME "boxblur" // name of kernel function
+#define PROGRAM_CACHE_DIR "./.clcache" // cached program binaries (NULL to always build from source)
+#define TUNING_DIR "./.cltuning" // per-device tuning files written by "boxblur --autotune"
+#define SPECIALIZE_KERNELS 0 // pass image, mask and block sizes as build options instead of buffers
+
+// stencil mode - a generated kernel applies a weighted stencil instead of the box blur (direct engine only)
+#define STENCIL 0
+#define STENCIL_NAME "sharpen" // built-in stencil (box, sobel_x, sobel_y, laplacian, sharpen) or stencil description file - no volume stencil
+
+// image mode ("boxblur --image [input.png [output.png]]")
+#define IMAGE_KERNEL_PATH "./boxblur_rgba.cl" // 8 bit per channel kernels
+#define INPUT_FILENAME "alarm.png"
+#define OUTPUT_FILENAME "alarm_blurred.png"
+#define STRIP_ROWS 0 // rows per streamed strip (0 = as many as fit into device memory)
+
+// iterated mode ("boxblur --iterate [passes [sigma]]") - Gaussian approximation by repeated box blurs
+#define BLUR_PASSES 3 // number of box blur passes
+#define BLUR_SIGMA 0 // standard deviation of the approximated Gaussian (0 = every pass uses MASK_SIZE_*)
+#define FUSE_PASSES 1 // fuse consecutive passes into one launch, else one separable pass after the other
+#define ITERATED_KERNEL_PATH "./boxblur_iterated.cl" // fused passes
+#define SEPARABLE_KERNEL_PATH "./boxblur_separable.cl" // single passes
+
+// jacobi mode ("boxblur --jacobi [maxSteps [stepsPerLaunch]]") - heat diffusion on an IMAGE_WIDTH * IMAGE_HEIGHT grid
+#define JACOBI_KERNEL_PATH "./jacobi_temporal.cl"
+#define JACOBI_ALPHA 0.25f // diffusion coefficient * time step / grid spacing^2 (0.25 = Jacobi iteration, larger is unstable)
+#define JACOBI_MAX_STEPS 1000 // time steps if the iteration does not converge before
+#define JACOBI_STEPS_PER_LAUNCH 8 // time steps per kernel launch (temporal blocking)
+#define JACOBI_CHECK_INTERVAL 4 // kernel launches between convergence checks
+#define JACOBI_TOLERANCE 1e-3f // converged once no value changes more than this in one step
+
+// multi-device mode ("boxblur --multi [rounds [width height]]") - one image split into row bands over all devices of all platforms
+#define MULTI_KERNEL_PATH "./boxblur_naive.cl" // one work item per pixel
+#define MULTI_ROUNDS 3 // blurs of the same image - band heights are rebalanced from the measured throughput after every round
+#define MULTI_CPU_UNITS 4 // compute units per CPU sub-device (0 = whole CPU as one device)
+
+// service mode ("boxblur --service [images [width height]]") - many small images through one BlurContext
+#define SERVICE_IMAGES 1000 // number of blurs
+#define SERVICE_IN_FLIGHT 4 // blurs submitted before waiting for the oldest one
+
+// batch mode ("boxblur --batch <input dir or list file> [output dir [images per launch]]") - pipelined blur of many PNG files
+#define BATCH_OUTPUT_DIR "./blurred"
+#define BATCH_DECODE_THREADS 0 // threads reading PNG files (0 = half of the hardware threads)
+#define BATCH_ENCODE_THREADS 0 // threads writing PNG files (0 = half of the hardware threads)
+#define BATCH_SLOTS 3 // device buffer sets - launches in flight
+#define BATCH_PACK_IMAGES 1 // images packed into one buffer and launch (1 = one launch per image)
+
+// tiled mode ("boxblur --tiled <input.tiles> [output.tiles]") - blur a memory-mapped tiled raw image,
+// converters "boxblur --to-tiles <input.png> <output.tiles>" and "boxblur --to-png <input.tiles> <output.png>"
+#define TILED_KERNEL_PATH "./boxblur_tiled.cl"
+#define TILED_OUTPUT "blurred.tiles"
+#define TILE_WIDTH 256 // pixels per tile row
+#define TILE_HEIGHT 64 // rows per tile - also the strip height of the blur
+
+// volume mode ("boxblur --volume [width height depth]") - 3D box blur (or stencil) of a random volume with 2.5D blocking
+#define VOLUME_KERNEL_PATH "./boxblur_volume.cl"
+#define VOLUME_WIDTH 64
+#define VOLUME_HEIGHT 64
+#define VOLUME_DEPTH 64
+#define MASK_SIZE_FRONT 1 // planes before the voxel - xy mask is MASK_SIZE_LEFT/UP/RIGHT/DOWN
+#define MASK_SIZE_BACK 1 // planes after the voxel
+#define VOLUME_LOCAL_X 16 // work group size in the xy plane
+#define VOLUME_LOCAL_Y 16
+#define VOLUME_BLOCK_DEPTH 32 // planes streamed by one work group (0 = whole depth)
+#define VOLUME_STENCIL 0 // apply a generated volume stencil instead of the box blur
+#define VOLUME_STENCIL_NAME "laplacian3d" // any stencil, e.g. built-in box3d or laplacian3d, or stencil description file
+
+// pixel type mode ("boxblur --pixels <int|uint8|uint16|float|half> [width height]") - direct kernel (KERNEL_PATH)
+// on a random image of 8 or 16 bit, float or half precision pixels
+#define PIXEL_TYPE "uint8" // type if none is given
+
+#if STENCIL && ENGINE != ENGINE_DIRECT
+#error "STENCIL requires ENGINE_DIRECT"
+#endif
+
+#if BORDER_MODE != BORDER_ZERO && ENGINE != ENGINE_BORDER
+#error "BORDER_MODE requires ENGINE_BORDER"
+#endif
+
+// turn a macro value into a string literal
+#define STRINGIFY(x) #x
+#define TO_STRING(x) STRINGIFY(x)
+
+using namespace std;
+
+
+
+// display an error message if needed
+void checkError (int ret, const char* funcName)
+{
+    if (ret != CL_SUCCESS)
+        cout << funcName << ": " << ret << "\n";
+}
+
+
+// number of values from the start of one image row to the start of the next -
+// rows are padded to the device's base address alignment and global memory
+// cache line size, so every row starts aligned and its loads coalesce
+static cl_int row_pitch (cl_device_id device, cl_int width)
+{
+    cl_uint alignBits = 0;
+    cl_uint cacheLine = 0;
+    clGetDeviceInfo(device, CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(cl_uint), &alignBits, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_GLOBAL_MEM_CACHELINE_SIZE, sizeof(cl_uint), &cacheLine, NULL);
+
+    // both are powers of 2, so the larger one is a multiple of the other
+    size_t alignment = max(max((size_t) alignBits / 8, (size_t) cacheLine), sizeof(cl_int));
+
+    return (cl_int) (round_up(width * sizeof(cl_int), alignment) / sizeof(cl_int));
+}
+
+
+// copy the width * height values of a matrix with rows pitch values apart
+// into a packed matrix (free it after use)
+static cl_int* packRows(const cl_int* matrix, cl_int width, cl_int height, cl_int pitch)
+{
+    cl_int* packed = (cl_int*) malloc (width * height * sizeof(cl_int));
+
+    for (int i = 0; i < height; i++)
+        memcpy(packed + i * width, matrix + i * pitch, width * sizeof(cl_int));
+
+    return packed;
+}
+
+
+// output a matrix row by row - rows are pitch values apart
+void printMatrix(const char* title, cl_int* matrix, cl_int width, cl_int height, cl_int pitch)
+{
+    // larger matrices would flood the terminal
+    if (width > PRINT_MAX_SIZE || height > PRINT_MAX_SIZE)
+        return;
+
+    cout << title << ":\n";
+    for(int i = 0; i < height; i++)
+    {
+        for(int j = 0; j < width; j++)
+        {
+            cout << +matrix[i * pitch + j] << " ";
+        }
+
+        cout << "\n";
+    }
+}
+
+
+// create a matrix with random values in the range [0, maxVal),
+// rows are pitch values apart and padded with 0
+void createMatrix(cl_int* matrix, cl_int width, cl_int height, cl_int pitch, cl_int maxVal)
+{
+    srand (time(NULL)); // initialize random number seed
+
+    // fill matrix with random values
+    for(int i = 0; i < height; i++)
+    {
+        for(int j = 0; j < pitch; j++)
+            matrix[i * pitch + j] = j < width ? rand() % maxVal : 0;
+    }
+
+    // output original test matrix
+    printMatrix("Original data", matrix, width, height, pitch);
+    cout << "\n\n\n";
+}
+
+
+// compare a device result with the native host implementation,
+// returns the number of differing pixels (rows of image and blurred are pitch values apart)
+int verifyResult(cl_int* image, cl_int* blurred, cl_int width, cl_int height, cl_int pitch, cl_int* masksize)
+{
+    cl_int* packed = packRows(image, width, height, pitch);
+    cl_int* reference = (cl_int*) malloc (width * height * sizeof(cl_int));
+    cpu_boxblur_border(packed, reference, width, height, masksize, BORDER_MODE, CPU_THREADS);
+
+    int mismatches = 0;
+    for(int i = 0; i < height; i++)
+    {
+        for(int j = 0; j < width; j++)
+        {
+            if (blurred[i * pitch + j] != reference[i * width + j])
+                mismatches++;
+        }
+    }
+
+    free(packed);
+    free(reference);
+
+    return mismatches;
+}
+
+
+// compare a device result with the native host implementation of a stencil,
+// returns the number of differing pixels (rows of image and result are pitch values apart)
+int verifyStencil(cl_int* image, cl_int* result, cl_int width, cl_int height, cl_int pitch, const Stencil& stencil)
+{
+    cl_int* packed = packRows(image, width, height, pitch);
+    cl_int* reference = (cl_int*) malloc (width * height * sizeof(cl_int));
+    cpu_stencil(packed, reference, width, height, stencil, CPU_THREADS);
+
+    int mismatches = 0;
+    for(int i = 0; i < height; i++)
+    {
+        for(int j = 0; j < width; j++)
+        {
+            if (result[i * pitch + j] != reference[i * width + j])
+                mismatches++;
+        }
+    }
+
+    free(packed);
+    free(reference);
+
+    return mismatches;
+}
+
+
+// load STENCIL_NAME - the image kernels and cpu_stencil ignore plane offsets of volume stencils
+bool loadImageStencil(Stencil* stencil)
+{
+    if (!load_stencil(STENCIL_NAME, stencil))
+        return false;
+
+    if (!stencil_is_planar(*stencil))
+    {
+        cout << "Stencil " << STENCIL_NAME << " reaches into other planes - use it as VOLUME_STENCIL_NAME\n";
+        return false;
+    }
+
+    return true;
+}
+
+
+// blur test matrix with the native host implementation only
+// (used if no openCL device is available)
+int runOnHost(cl_int width, cl_int height)
+{
+#if STENCIL
+    Stencil stencil;
+    if (!loadImageStencil(&stencil))
+        return 1;
+#else
+    cl_int masksize[4] = {MASK_SIZE_LEFT, MASK_SIZE_UP, MASK_SIZE_RIGHT, MASK_SIZE_DOWN};
+#endif
+
+    cl_int* h_testValues = (cl_int*) malloc (width * height * sizeof(cl_int));
+    cl_int* h_blurred = (cl_int*) malloc (width * height * sizeof(cl_int));
+
+    createMatrix (h_testValues, width, height, width, 4);
+
+#if STENCIL
+    cpu_stencil(h_testValues, h_blurred, width, height, stencil, CPU_THREADS);
+#else
+    cpu_boxblur_border(h_testValues, h_blurred, width, height, masksize, BORDER_MODE, CPU_THREADS);
+#endif
+
+    printMatrix("Changed data", h_blurred, width, height, width);
+
+    free(h_testValues);
+    free(h_blurred);
+
+    return 0;
+}
+
+
+// blur every channel of an 8 bit image with the native host implementation
+void blurChannelsOnHost(unsigned char* pixels, unsigned char* blurred, cl_int width, cl_int height, cl_int channels, cl_int* masksize)
+{
+    cl_int* channel = (cl_int*) malloc (width * height * sizeof(cl_int));
+    cl_int* result = (cl_int*) malloc (width * height * sizeof(cl_int));
+
+    for (int c = 0; c < channels; c++)
+    {
+        for (int i = 0; i < width * height; i++)
+            channel[i] = pixels[i * channels + c];
+
+        cpu_boxblur(channel, result, width, height, masksize, CPU_THREADS);
+
+        for (int i = 0; i < width * height; i++)
+            blurred[i * channels + c] = (unsigned char) result[i];
+    }
+
+    free(channel);
+    free(result);
+}
+
+
+// blur a PNG file - on the device if context is not NULL, else on the host
+int blurImage(cl_context context, cl_device_id device_id, const char* inputFile, const char* outputFile)
+{
+    cl_int ret;
+    cl_int width, height, channels;
+    cl_int masksize[4] = {MASK_SIZE_LEFT, MASK_SIZE_UP, MASK_SIZE_RIGHT, MASK_SIZE_DOWN};
+
+    unsigned char* h_image = load_png(inputFile, &width, &height, &channels);
+    if (!h_image)
+        return 1;
+
+    size_t imageBytes = (size_t) width * height * channels; // 1 byte per channel
+    unsigned char* h_blurred = (unsigned char*) malloc (imageBytes);
+
+    cout << "Image " << inputFile << " is X:" << width << " Y:" << height << " with " << channels << " channels\n";
+
+    if (!context)
+    {
+        blurChannelsOnHost(h_image, h_blurred, width, height, channels, masksize);
+        save_png(outputFile, h_blurred, width, height, channels);
+
+        free(h_image);
+        free(h_blurred);
+
+        return 0;
+    }
+
+    char* source_str = read_source(IMAGE_KERNEL_PATH);
+
+    cl_program program = build_program(context, device_id, source_str, "-Werror", PROGRAM_CACHE_DIR, &ret);
+    checkError(ret, "build_program");
+
+    // all channels are blurred in one pass
+    cl_kernel kernel = clCreateKernel(program, channels == 1 ? "boxblur_gray" : "boxblur", &ret);
+    checkError(ret, "clCreateKernel");
+
+    // blur image strip by strip - a single strip if the image fits into device memory
+    ret = stream_blur(context, device_id, kernel, h_image, h_blurred, width, height, channels, masksize, STRIP_ROWS);
+    checkError(ret, "stream_blur");
+
+#if VERIFY_RESULT
+    unsigned char* reference = (unsigned char*) malloc (imageBytes);
+    blurChannelsOnHost(h_image, reference, width, height, channels, masksize);
+
+    if (memcmp(reference, h_blurred, imageBytes) == 0)
+        cout << "Verification passed\n";
+    else
+        cout << "Verification FAILED: device result differs from host result\n";
+
+    free(reference);
+#endif
+
+    save_png(outputFile, h_blurred, width, height, channels);
+    cout << "Blurred image written to " << outputFile << "\n";
+
+    clReleaseKernel(kernel);
+    clReleaseProgram(program);
+
+    free(source_str);
+    free(h_image);
+    free(h_blurred);
+
+    return 0;
+}
+
+
+// blur test matrix several times - on the device if context is not NULL, else on the host
+int blurIterated(cl_context context, cl_device_id device_id, cl_int width, cl_int height, cl_int passes, double sigma)
+{
+    cl_int ret;
+
+    // mask of every pass - either fitted to sigma or the #defined mask
+    cl_int* masks = (cl_int*) malloc (4 * passes * sizeof(cl_int));
+
+    if (sigma > 0)
+        gauss_box_masks(sigma, passes, masks);
+    else
+    {
+        for (int p = 0; p < passes; p++)
+        {
+            masks[4 * p] = MASK_SIZE_LEFT;
+            masks[4 * p + 1] = MASK_SIZE_UP;
+            masks[4 * p + 2] = MASK_SIZE_RIGHT;
+            masks[4 * p + 3] = MASK_SIZE_DOWN;
+        }
+    }
+
+    cout << passes << " passes with masks";
+    for (int p = 0; p < passes; p++)
+        cout << " " << masks[4 * p] << "," << masks[4 * p + 1] << "," << masks[4 * p + 2] << "," << masks[4 * p + 3];
+    cout << "\n\n";
+
+    cl_int* h_testValues = (cl_int*) malloc (width * height * sizeof(cl_int));
+    cl_int* h_blurred = (cl_int*) malloc (width * height * sizeof(cl_int));
+    cl_int* h_temp = (cl_int*) malloc (width * height * sizeof(cl_int));
+
+    createMatrix (h_testValues, width, height, width, 4);
+
+    // native host implementation, one pass after the other
+    memcpy(h_temp, h_testValues, width * height * sizeof(cl_int));
+
+    for (int p = 0; p < passes; p++)
+    {
+        cpu_boxblur(h_temp, h_blurred, width, height, masks + 4 * p, CPU_THREADS);
+        memcpy(h_temp, h_blurred, width * height * sizeof(cl_int));
+    }
+
+    if (context)
+    {
+        char* source_str = read_source(FUSE_PASSES ? ITERATED_KERNEL_PATH : SEPARABLE_KERNEL_PATH);
+
+        cl_program program = build_program(context, device_id, source_str, "-Werror", PROGRAM_CACHE_DIR, &ret);
+        checkError(ret, "build_program");
+
+        // all passes run on the device, host memory is only touched before the first and after the last
+        ret = iterated_blur(context, device_id, program, FUSE_PASSES, h_testValues, h_blurred, width, height, masks, passes);
+        checkError(ret, "iterated_blur");
+
+#if VERIFY_RESULT
+        // h_temp holds the host result
+        if (memcmp(h_temp, h_blurred, width * height * sizeof(cl_int)) == 0)
+            cout << "Verification passed\n";
+        else
+            cout << "Verification FAILED: device result differs from host result\n";
+#endif
+
+        if (program)
+            clReleaseProgram(program);
+
+        free(source_str);
+    }
+
+    printMatrix("Changed data", h_blurred, width, height, width);
+
+    free(masks);
+    free(h_testValues);
+    free(h_blurred);
+    free(h_temp);
+
+    return 0;
+}
+
+
+// output a float grid row by row
+void printGrid(const char* title, const float* grid, cl_int width, cl_int height)
+{
+    if (width > PRINT_MAX_SIZE || height > PRINT_MAX_SIZE)
+        return;
+
+    cout << title << ":\n";
+    for(int i = 0; i < height; i++)
+    {
+        for(int j = 0; j < width; j++)
+            printf("%7.2f ", grid[i * width + j]);
+
+        cout << "\n";
+    }
+}
+
+
+// heat diffusion from a hot upper border - on the device if context is not NULL, else on the host
+int solveJacobi(cl_context context, cl_device_id device_id, cl_int width, cl_int height, cl_int maxSteps, cl_int stepsPerLaunch)
+{
+    cl_int ret;
+
+    float* h_grid = (float*) malloc (width * height * sizeof(float));
+    float* h_reference = (float*) malloc (width * height * sizeof(float));
+
+    // upper border at 100 degrees, everything else at 0
+    for (int i = 0; i < width * height; i++)
+        h_grid[i] = i < width ? 100.0f : 0.0f;
+
+    memcpy(h_reference, h_grid, width * height * sizeof(float));
+
+    cl_int steps = maxSteps;
+
+    if (context)
+    {
+        char* source_str = read_source(JACOBI_KERNEL_PATH);
+
+        cl_program program = build_program(context, device_id, source_str, "-Werror", PROGRAM_CACHE_DIR, &ret);
+        checkError(ret, "build_program");
+
+        float residual;
+        ret = jacobi_solve(context, device_id, program, h_grid, width, height, JACOBI_ALPHA,
+                           stepsPerLaunch, JACOBI_CHECK_INTERVAL, JACOBI_TOLERANCE, maxSteps, &steps, &residual);
+        checkError(ret, "jacobi_solve");
+
+        cout << steps << " steps, largest change in last step " << residual
+             << (residual <= JACOBI_TOLERANCE ? " (converged)" : "") << "\n\n";
+
+        if (program)
+            clReleaseProgram(program);
+
+        free(source_str);
+    }
+    else
+        cpu_jacobi(h_grid, width, height, JACOBI_ALPHA, steps);
+
+#if VERIFY_RESULT
+    if (context)
+    {
+        // same number of steps on the host - the device may contract multiply
+        // and add, so results can differ in the last bits
+        cpu_jacobi(h_reference, width, height, JACOBI_ALPHA, steps);
+
+        float difference = 0;
+        for (int i = 0; i < width * height; i++)
+            difference = fmaxf(difference, fabsf(h_grid[i] - h_reference[i]));
+
+        if (difference <= 1e-3f)
+            cout << "Verification passed\n";
+        else
+            cout << "Verification FAILED: device result differs from host result by " << difference << "\n";
+    }
+#endif
+
+    printGrid("Temperature", h_grid, width, height);
+
+    free(h_grid);
+    free(h_reference);
+
+    return 0;
+}
+
+
+// blur a random image split over all devices of all platforms, rounds times -
+// band heights of later rounds follow the throughput measured in the earlier ones
+int blurMulti(cl_int width, cl_int height, cl_int rounds)
+{
+    cl_int ret = CL_SUCCESS;
+    cl_int masksize[4] = {MASK_SIZE_LEFT, MASK_SIZE_UP, MASK_SIZE_RIGHT, MASK_SIZE_DOWN};
+
+    char* source_str = read_source(MULTI_KERNEL_PATH);
+    vector<SplitDevice> devices = open_split_devices(source_str, "-Werror", PROGRAM_CACHE_DIR, MULTI_CPU_UNITS);
+    free(source_str);
+
+    if (devices.empty())
+    {
+        cout << "No openCL device found - using native host implementation\n\n";
+        return runOnHost(width, height);
+    }
+
+    cout << "Splitting " << width << "x" << height << " image over " << devices.size() << " devices\n";
+
+    cl_int* h_image = (cl_int*) malloc (width * height * sizeof(cl_int));
+    cl_int* h_blurred = (cl_int*) malloc (width * height * sizeof(cl_int));
+
+    // not printed - the image is usually too large
+    srand(time(NULL));
+    for (int i = 0; i < width * height; i++)
+        h_image[i] = rand() % 256;
+
+    for (int round = 0; round < rounds && ret == CL_SUCCESS; round++)
+    {
+        double start = host_time_ms();
+        ret = split_blur(devices, h_image, h_blurred, width, height, masksize);
+        checkError(ret, "split_blur");
+
+        cout << "\nRound " << round + 1 << ": " << host_time_ms() - start << " ms\n";
+
+        for (size_t i = 0; i < devices.size(); i++)
+            cout << "  " << devices[i].name << ": " << devices[i].rows << " rows, "
+                 << devices[i].rowsPerMs << " rows/ms\n";
+    }
+
+#if VERIFY_RESULT
+    if (ret == CL_SUCCESS)
+    {
+        // the direct kernel adds 0 beyond the edges, whatever BORDER_MODE is
+        cl_int* h_reference = (cl_int*) malloc (width * height * sizeof(cl_int));
+        cpu_boxblur(h_image, h_reference, width, height, masksize, CPU_THREADS);
+
+        if (memcmp(h_reference, h_blurred, width * height * sizeof(cl_int)) == 0)
+            cout << "\nVerification passed\n";
+        else
+            cout << "\nVerification FAILED: device result differs from host result\n";
+
+        free(h_reference);
+    }
+#endif
+
+    close_split_devices(&devices);
+
+    free(h_image);
+    free(h_blurred);
+
+    return ret == CL_SUCCESS ? 0 : 1;
+}
+
+
+// blur many small images with one BlurContext - on the device if device_id is not NULL, else on the host
+int blurService(cl_device_id device_id, cl_int count, cl_int width, cl_int height)
+{
+    cl_int ret = CL_SUCCESS;
+    cl_int masksize[4] = {MASK_SIZE_LEFT, MASK_SIZE_UP, MASK_SIZE_RIGHT, MASK_SIZE_DOWN};
+    size_t imageBytes = (size_t) width * height * sizeof(cl_int);
+
+    // one input and output image per blur in flight
+    cl_int* h_images[SERVICE_IN_FLIGHT];
+    cl_int* h_outputs[SERVICE_IN_FLIGHT];
+    cl_event pending[SERVICE_IN_FLIGHT];
+
+    srand(time(NULL));
+    for (int slot = 0; slot < SERVICE_IN_FLIGHT; slot++)
+    {
+        h_images[slot] = (cl_int*) malloc (imageBytes);
+        h_outputs[slot] = (cl_int*) malloc (imageBytes);
+        pending[slot] = NULL;
+
+        for (int i = 0; i < width * height; i++)
+            h_images[slot][i] = rand() % 256;
+    }
+
+    double start;
+
+    if (device_id)
+    {
+        TuningConfig config;
+        config.kernelPath = KERNEL_PATH;
+        config.localSize[0] = LOCAL_X;
+        config.localSize[1] = LOCAL_Y;
+        config.blockSize[0] = (width + THREAD_NUM - 1) / THREAD_NUM;
+        config.blockSize[1] = (height + THREAD_NUM - 1) / THREAD_NUM;
+
+        string tuningFile = tuning_path(device_id, TUNING_DIR);
+        if (load_tuning(tuningFile, width, height, masksize, &config))
+            cout << "Using tuned configuration from " << tuningFile << "\n";
+
+        // context, program and buffers are set up once for all images
+        double setupStart = host_time_ms();
+        BlurContext blurContext(device_id, config, PROGRAM_CACHE_DIR, &ret);
+        checkError(ret, "BlurContext");
+
+        cout << "Setup took " << host_time_ms() - setupStart << " ms\n";
+
+        start = host_time_ms();
+
+        for (int i = 0; i < count && ret == CL_SUCCESS; i++)
+        {
+            int slot = i % SERVICE_IN_FLIGHT;
+
+            // wait for the oldest blur before reusing its images
+            if (pending[slot])
+            {
+                clWaitForEvents(1, &pending[slot]);
+                clReleaseEvent(pending[slot]);
+                pending[slot] = NULL;
+            }
+
+            ret = blurContext.blur_async(h_images[slot], h_outputs[slot], width, height, masksize, &pending[slot]);
+            checkError(ret, "BlurContext::blur_async");
+        }
+
+        for (int slot = 0; slot < SERVICE_IN_FLIGHT; slot++)
+            if (pending[slot])
+            {
+                clWaitForEvents(1, &pending[slot]);
+                clReleaseEvent(pending[slot]);
+            }
+    }
+    else
+    {
+        start = host_time_ms();
+
+        for (int i = 0; i < count; i++)
+            cpu_boxblur(h_images[i % SERVICE_IN_FLIGHT], h_outputs[i % SERVICE_IN_FLIGHT], width, height, masksize, CPU_THREADS);
+    }
+
+    double milliseconds = host_time_ms() - start;
+
+    cout << count << " images of " << width << "x" << height << " in " << milliseconds << " ms ("
+         << count / (milliseconds * 1e-3) << " images/s)\n";
+
+#if VERIFY_RESULT
+    if (device_id && ret == CL_SUCCESS)
+    {
+        // every slot holds the result of its last blur
+        cl_int* h_reference = (cl_int*) malloc (imageBytes);
+        bool passed = true;
+
+        for (int slot = 0; slot < SERVICE_IN_FLIGHT && slot < count; slot++)
+        {
+            cpu_boxblur(h_images[slot], h_reference, width, height, masksize, CPU_THREADS);
+            passed = passed && memcmp(h_reference, h_outputs[slot], imageBytes) == 0;
+        }
+
+        if (passed)
+            cout << "Verification passed\n";
+        else
+            cout << "Verification FAILED: device result differs from host result\n";
+
+        free(h_reference);
+    }
+#endif
+
+    for (int slot = 0; slot < SERVICE_IN_FLIGHT; slot++)
+    {
+        free(h_images[slot]);
+        free(h_outputs[slot]);
+    }
+
+    return ret == CL_SUCCESS ? 0 : 1;
+}
+
+
+// blur all PNG files of a directory or list file - on the device if context is not NULL, else on the host
+int blurBatch(cl_context context, cl_device_id device_id, const char* inputPath, const char* outputDir, cl_int packImages)
+{
+    cl_int ret = CL_SUCCESS;
+    cl_int masksize[4] = {MASK_SIZE_LEFT, MASK_SIZE_UP, MASK_SIZE_RIGHT, MASK_SIZE_DOWN};
+
+    vector<string> inputs;
+    if (!batch_inputs(inputPath, &inputs))
+    {
+        cout << "Cannot read inputs from " << inputPath << "\n";
+        return 1;
+    }
+
+    cout << "Blurring " << inputs.size() << " files into " << outputDir << "\n";
+
+    BatchStats stats;
+
+    if (context)
+    {
+        // half of the hardware threads decode, the other half encode
+        cl_int halfThreads = max((cl_int) thread::hardware_concurrency() / 2, 1);
+        cl_int decodeThreads = BATCH_DECODE_THREADS ? BATCH_DECODE_THREADS : halfThreads;
+        cl_int encodeThreads = BATCH_ENCODE_THREADS ? BATCH_ENCODE_THREADS : halfThreads;
+
+        char* source_str = read_source(IMAGE_KERNEL_PATH);
+
+        cl_program program = build_program(context, device_id, source_str, "-Werror", PROGRAM_CACHE_DIR, &ret);
+        checkError(ret, "build_program");
+
+        ret = batch_blur(context, device_id, program, inputs, outputDir, masksize,
+                         decodeThreads, encodeThreads, BATCH_SLOTS, packImages, &stats);
+        checkError(ret, "batch_blur");
+
+        cout << decodeThreads << " decode threads, " << encodeThreads << " encode threads, "
+             << stats.launches << " launches of up to " << packImages << " images\n";
+
+        if (program)
+            clReleaseProgram(program);
+
+        free(source_str);
+    }
+    else
+    {
+        double start = host_time_ms();
+
+        mkdir(outputDir, 0755); // fails harmlessly if directory exists
+
+        stats.written = 0;
+        stats.failed = 0;
+        stats.launches = 0;
+
+        for (size_t i = 0; i < inputs.size(); i++)
+        {
+            cl_int width, height, channels;
+            unsigned char* h_image = load_png(inputs[i].c_str(), &width, &height, &channels);
+
+            if (!h_image)
+            {
+                stats.failed++;
+                continue;
+            }
+
+            unsigned char* h_blurred = (unsigned char*) malloc ((size_t) width * height * channels);
+            blurChannelsOnHost(h_image, h_blurred, width, height, channels, masksize);
+
+            if (save_png(batch_output_path(inputs[i], outputDir).c_str(), h_blurred, width, height, channels))
+                stats.written++;
+            else
+                stats.failed++;
+
+            free(h_image);
+            free(h_blurred);
+        }
+
+        stats.milliseconds = host_time_ms() - start;
+    }
+
+    cout << stats.written << " files written, " << stats.failed << " failed, in " << stats.milliseconds << " ms ("
+         << stats.written / (stats.milliseconds * 1e-3) << " images/s)\n";
+
+    return ret == CL_SUCCESS && stats.failed == 0 ? 0 : 1;
+}
+
+
+// blur a tiled raw image file into a new one - on the device if context is not NULL, else on the host
+int blurTiled(cl_context context, cl_device_id device_id, const char* inputFile, const char* outputFile)
+{
+    cl_int ret = CL_SUCCESS;
+    cl_int masksize[4] = {MASK_SIZE_LEFT, MASK_SIZE_UP, MASK_SIZE_RIGHT, MASK_SIZE_DOWN};
+
+    // creating the output truncates it - it must not be the mapped input
+    struct stat inputInfo, outputInfo;
+
+    if (stat(inputFile, &inputInfo) == 0 && stat(outputFile, &outputInfo) == 0 &&
+        inputInfo.st_dev == outputInfo.st_dev && inputInfo.st_ino == outputInfo.st_ino)
+    {
+        cout << "blurTiled: output " << outputFile << " is the input file\n";
+        return 1;
+    }
+
+    // mapping is immediate - pages are read once the blur touches them
+    double start = host_time_ms();
+
+    TiledImage input, output;
+    if (!tiled_open(inputFile, false, &input))
+        return 1;
+
+    const TiledHeader& header = input.header;
 
+    if (!tiled_create(outputFile, header.width, header.height, header.channels, header.tileWidth, header.tileHeight, &output))
+    {
+        tiled_close(&input);
+        return 1;
+    }
 
-// image size (power of 2)
-#define IMAGE_WIDTH 8
-#define IMAGE_HEIGHT 8
+    cout << "Image " << inputFile << " is X:" << header.width << " Y:" << header.height << " with " << header.channels
+         << " channels in " << header.tilesX << "x" << header.tilesY << " tiles of " << header.tileWidth << "x" << header.tileHeight
+         << ", opened in " << host_time_ms() - start << " ms\n";
 
-// "k" parameters for box blur
-#define MASK_SIZE_LEFT 1
-#define MASK_SIZE_UP 1
-#define MASK_SIZE_RIGHT 1
-#define MASK_SIZE_DOWN 1
+    start = host_time_ms();
 
-// work item/group settings
-#define LOCAL_X 4
-#define LOCAL_Y 4
-#define THREAD_NUM 4 // number of threads (defines block size - NEEDS TO BE ADJUSTED IF BLOCKS ARE NOT USED!)
+    if (context)
+    {
+        char* source_str = read_source(TILED_KERNEL_PATH);
 
-#define MEM_SIZE (128)
-#define MAX_SOURCE_SIZE (10000)
+        cl_program program = build_program(context, device_id, source_str, "-Werror", PROGRAM_CACHE_DIR, &ret);
+        checkError(ret, "build_program");
 
-// openCL paths
-#define KERNEL_PATH "./boxblur_blocking_local.cl"
-#define KERNEL_NAME "boxblur" // name of kernel function
+        if (ret == CL_SUCCESS)
+        {
+            ret = tiled_blur(context, device_id, program, input, output, masksize);
+            checkError(ret, "tiled_blur");
+        }
 
-#define INPUT_FILENAME "alarm.jpg"
-#define OUTPUT_FILENAME "alarm_blurred.jpg"
+        if (program)
+            clReleaseProgram(program);
 
-using namespace std;
+        free(source_str);
+    }
+    else
+    {
+        unsigned char* h_image = tiled_load(input);
+        unsigned char* h_blurred = (unsigned char*) malloc ((size_t) header.width * header.height * header.channels);
+
+        blurChannelsOnHost(h_image, h_blurred, header.width, header.height, header.channels, masksize);
+        tiled_store(&output, h_blurred);
 
+        free(h_image);
+        free(h_blurred);
+    }
 
+    cout << "Blurred in " << host_time_ms() - start << " ms, written to " << outputFile << "\n";
 
-// display an error message if needed
-void checkError (int ret, const char* funcName)
-{
-    if (ret != CL_SUCCESS)
-        cout << funcName << ": " << ret << "\n";
+#if VERIFY_RESULT
+    if (context && ret == CL_SUCCESS)
+    {
+        size_t imageBytes = (size_t) header.width * header.height * header.channels;
+
+        unsigned char* h_image = tiled_load(input);
+        unsigned char* h_blurred = tiled_load(output);
+        unsigned char* reference = (unsigned char*) malloc (imageBytes);
+
+        blurChannelsOnHost(h_image, reference, header.width, header.height, header.channels, masksize);
+
+        if (memcmp(reference, h_blurred, imageBytes) == 0)
+            cout << "Verification passed\n";
+        else
+            cout << "Verification FAILED: device result differs from host result\n";
+
+        free(h_image);
+        free(h_blurred);
+        free(reference);
+    }
+#endif
+
+    tiled_close(&input);
+    tiled_close(&output);
+
+    return ret == CL_SUCCESS ? 0 : 1;
 }
 
 
-// read a file and convert it to a char*
-static char* read_source (const char *filename)
+// blur a random volume with the 3D box mask, or VOLUME_STENCIL_NAME - on the device if context is not NULL, else on the host
+int blurVolume(cl_context context, cl_device_id device_id, cl_int width, cl_int height, cl_int depth)
 {
-    long int
-        size = 0,
-        res  = 0;
+    cl_int ret = CL_SUCCESS;
+    cl_int masksize[6] = {MASK_SIZE_LEFT, MASK_SIZE_UP, MASK_SIZE_RIGHT, MASK_SIZE_DOWN, MASK_SIZE_FRONT, MASK_SIZE_BACK};
+    size_t voxels = (size_t) width * height * depth;
+
+#if VOLUME_STENCIL
+    Stencil stencil;
+    if (!load_stencil(VOLUME_STENCIL_NAME, &stencil))
+        return 1;
+
+    // the generated kernel is called with the extent of the stencil as mask
+    stencil_extent_volume(stencil, masksize);
+
+    cout << "Using volume stencil " << stencil.name << " with " << stencil.taps.size() << " taps\n";
+#endif
+
+    cl_int* h_volume = (cl_int*) malloc (voxels * sizeof(cl_int));
+    cl_int* h_blurred = (cl_int*) malloc (voxels * sizeof(cl_int));
+
+    // not printed - the volume is usually too large
+    srand(time(NULL));
+    for (size_t i = 0; i < voxels; i++)
+        h_volume[i] = rand() % 256;
+
+    cout << "Volume is X:" << width << " Y:" << height << " Z:" << depth << ", mask reaches "
+         << masksize[0] << "," << masksize[1] << "," << masksize[2] << "," << masksize[3] << "," << masksize[4] << "," << masksize[5] << "\n";
+
+    double start = host_time_ms();
+
+    if (context)
+    {
+#if VOLUME_STENCIL
+        char* source_str = strdup(generate_volume_stencil_source(stencil).c_str());
+#else
+        char* source_str = read_source(VOLUME_KERNEL_PATH);
+#endif
+
+        cl_program program = build_program(context, device_id, source_str, "-Werror", PROGRAM_CACHE_DIR, &ret);
+        checkError(ret, "build_program");
+
+        if (ret == CL_SUCCESS)
+        {
+            // xy tiles of the work groups - z is streamed (3D NDRange, see volume_blur.hpp)
+            const size_t localSize[2] = {VOLUME_LOCAL_X, VOLUME_LOCAL_Y};
+
+            ret = volume_blur(context, device_id, program, h_volume, h_blurred, width, height, depth, masksize, localSize, VOLUME_BLOCK_DEPTH);
+            checkError(ret, "volume_blur");
+        }
+
+        if (program)
+            clReleaseProgram(program);
+
+        free(source_str);
+    }
+    else
+    {
+#if VOLUME_STENCIL
+        cpu_stencil_volume(h_volume, h_blurred, width, height, depth, stencil, CPU_THREADS);
+#else
+        cpu_boxblur_volume(h_volume, h_blurred, width, height, depth, masksize, CPU_THREADS);
+#endif
+    }
+
+    cout << "Blurred in " << host_time_ms() - start << " ms\n";
+
+#if VERIFY_RESULT
+    if (context && ret == CL_SUCCESS)
+    {
+        cl_int* h_reference = (cl_int*) malloc (voxels * sizeof(cl_int));
+
+#if VOLUME_STENCIL
+        cpu_stencil_volume(h_volume, h_reference, width, height, depth, stencil, CPU_THREADS);
+#else
+        cpu_boxblur_volume(h_volume, h_reference, width, height, depth, masksize, CPU_THREADS);
+#endif
+
+        if (memcmp(h_reference, h_blurred, voxels * sizeof(cl_int)) == 0)
+            cout << "Verification passed\n";
+        else
+            cout << "Verification FAILED: device result differs from host result\n";
+
+        free(h_reference);
+    }
+#endif
 
-    char *src = NULL;
+    free(h_volume);
+    free(h_blurred);
+
+    return ret == CL_SUCCESS ? 0 : 1;
+}
 
-    FILE *file = fopen(filename, "rb");
 
-    if (!file)  return NULL;
+// blur a random image of pixelType pixels with the direct kernel - on the device if context is not NULL, else on the host
+int blurPixels(cl_context context, cl_device_id device_id, const char* typeName, cl_int width, cl_int height)
+{
+    cl_int ret = CL_SUCCESS;
+    cl_int masksize[4] = {MASK_SIZE_LEFT, MASK_SIZE_UP, MASK_SIZE_RIGHT, MASK_SIZE_DOWN};
 
-    if (fseek(file, 0, SEEK_END))
+    int pixelType = pixel_type(typeName);
+    if (pixelType < 0)
     {
-        fclose(file);
-        return NULL;
+        cout << "Unknown pixel type " << typeName << " - use int, uint8, uint16, float or half\n";
+        return 1;
     }
 
-    size = ftell(file);
-    if (size == 0)
+    size_t pixels = (size_t) width * height;
+    size_t imageBytes = pixels * pixel_size(pixelType);
+
+    // random values in the range of the type - 16 bit for uint16, else 8 bit
+    cl_int* h_values = (cl_int*) malloc (pixels * sizeof(cl_int));
+    createMatrix (h_values, width, height, width, pixelType == PIXEL_UINT16 ? 65536 : 256);
+
+    void* h_image = malloc (imageBytes);
+    void* h_blurred = malloc (imageBytes);
+    pixels_from_int(h_values, h_image, pixels, pixelType);
+
+    cout << "Pixel type is " << pixel_name(pixelType) << " (" << pixel_size(pixelType) << " bytes)\n";
+
+    double start = host_time_ms();
+
+    if (context)
     {
-        fclose(file);
-        return NULL;
+        // rows are packed - the pitch of the int kernels is counted in pixels
+        cl_int imageSize[3] = {width, height, width};
+        cl_int params[MASK_PARAMS];
+        mask_params(masksize, params);
+
+        cl_int blockSize[2] = {(width + THREAD_NUM - 1) / THREAD_NUM, (height + THREAD_NUM - 1) / THREAD_NUM};
+        cl_int vectorWidth = vector_width(device_id);
+
+        // the vector kernel computes runs of vectorWidth pixels - widen blocks to whole runs
+        if (strcmp(KERNEL_PATH, VECTOR_KERNEL_PATH) == 0)
+            blockSize[0] = (cl_int) round_up(blockSize[0], vectorWidth);
+
+        string build_params = "-Werror -D VECTOR_WIDTH=" + to_string(vectorWidth) + " " + pixel_build_options(pixelType);
+
+        char* source_str = read_source(KERNEL_PATH);
+
+        cl_program program = build_program(context, device_id, source_str, build_params.c_str(), PROGRAM_CACHE_DIR, &ret);
+        checkError(ret, "build_program");
+
+        cl_command_queue queue = NULL;
+        cl_kernel kernel = NULL;
+        cl_mem buffers[5] = {NULL, NULL, NULL, NULL, NULL}; // image, imageSize, k, blockSize, output
+
+        if (ret == CL_SUCCESS)
+            queue = clCreateCommandQueue(context, device_id, 0, &ret);
+        if (ret == CL_SUCCESS)
+            kernel = clCreateKernel(program, KERNEL_NAME, &ret);
+        if (ret == CL_SUCCESS)
+            buffers[0] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, imageBytes, h_image, &ret);
+        if (ret == CL_SUCCESS)
+            buffers[1] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(imageSize), imageSize, &ret);
+        if (ret == CL_SUCCESS)
+            buffers[2] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(params), params, &ret);
+        if (ret == CL_SUCCESS)
+            buffers[3] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(blockSize), blockSize, &ret);
+        if (ret == CL_SUCCESS)
+            buffers[4] = clCreateBuffer(context, CL_MEM_WRITE_ONLY, imageBytes, NULL, &ret);
+        checkError(ret, "clCreateBuffer");
+
+        if (ret == CL_SUCCESS)
+        {
+            for (int i = 0; i < 4; i++)
+                clSetKernelArg(kernel, i, sizeof(cl_mem), (void*) &buffers[i]);
+
+            // local memory holds sums (32 bit for every pixel type), not pixels
+            clSetKernelArg(kernel, 4, (size_t) (MASK_SIZE_LEFT + LOCAL_X + MASK_SIZE_RIGHT) * (MASK_SIZE_UP + LOCAL_Y + MASK_SIZE_DOWN) * sizeof(cl_int), NULL);
+            clSetKernelArg(kernel, 5, sizeof(cl_mem), (void*) &buffers[4]);
+
+            const size_t globalSizes[2] = {round_up((width + blockSize[0] - 1) / blockSize[0], LOCAL_X),
+                                           round_up((height + blockSize[1] - 1) / blockSize[1], LOCAL_Y)};
+            const size_t localSize[2] = {LOCAL_X, LOCAL_Y};
+
+            ret = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, globalSizes, localSize, 0, NULL, NULL);
+            checkError(ret, "clEnqueueNDRangeKernel");
+        }
+
+        if (ret == CL_SUCCESS)
+        {
+            ret = clEnqueueReadBuffer(queue, buffers[4], CL_TRUE, 0, imageBytes, h_blurred, 0, NULL, NULL);
+            checkError(ret, "clEnqueueReadBuffer");
+        }
+
+        for (int i = 0; i < 5; i++)
+            if (buffers[i])
+                clReleaseMemObject(buffers[i]);
+
+        if (kernel)
+            clReleaseKernel(kernel);
+
+        if (queue)
+            clReleaseCommandQueue(queue);
+
+        if (program)
+            clReleaseProgram(program);
+
+        free(source_str);
     }
+    else
+        cpu_boxblur_pixels(h_image, h_blurred, width, height, masksize, pixelType);
 
-    rewind(file);
+    cout << "Blurred in " << host_time_ms() - start << " ms\n";
 
-    src = (char *)calloc(size + 1, sizeof(char));
-    if (!src)
+#if VERIFY_RESULT
+    if (context && ret == CL_SUCCESS)
     {
-        src = NULL;
-        fclose(file);
-        return src;
+        void* h_reference = malloc (imageBytes);
+        cpu_boxblur_pixels(h_image, h_reference, width, height, masksize, pixelType);
+
+        if (memcmp(h_reference, h_blurred, imageBytes) == 0)
+            cout << "Verification passed\n";
+        else
+            cout << "Verification FAILED: device result differs from host result\n";
+
+        free(h_reference);
     }
+#endif
 
-    res = fread(src, 1, sizeof(char) * size, file);
-    if (res != sizeof(char) * size)
+    // output small results like printMatrix
+    if (ret == CL_SUCCESS && width <= PRINT_MAX_SIZE && height <= PRINT_MAX_SIZE)
     {
-        fclose(file);
-        free(src);
+        cout << "Changed data:\n";
+        for (int i = 0; i < height; i++)
+        {
+            for (int j = 0; j < width; j++)
+                cout << pixel_value(h_blurred, (size_t) i * width + j, pixelType) << " ";
 
-        return src;
+            cout << "\n";
+        }
     }
 
-    src[size] = '\0'; /* NULL terminated */
-    fclose(file);
+    free(h_values);
+    free(h_image);
+    free(h_blurred);
 
-    return src;
+    return ret == CL_SUCCESS ? 0 : 1;
 }
 
 
-// create a matrix with random values in the range [0, maxVal)
-void createMatrix(cl_int* matrix, cl_int width, cl_int height, cl_int maxVal)
+// modes selected by the first command line argument
+enum RunMode
 {
-    srand (time(NULL)); // initialize random number seed
+    MODE_MATRIX, // no mode argument - blur a random test matrix
+    MODE_AUTOTUNE,
+    MODE_IMAGE,
+    MODE_ITERATE,
+    MODE_JACOBI,
+    MODE_MULTI,
+    MODE_SERVICE,
+    MODE_BATCH,
+    MODE_TILED,
+    MODE_VOLUME,
+    MODE_PIXELS,
+    MODE_TO_TILES,
+    MODE_TO_PNG,
+    MODE_INVALID // unknown mode or required arguments missing
+};
+
+struct ModeName
+{
+    const char* name;
+    RunMode mode;
+    int requiredArgs; // arguments after the mode name without default
+    int firstCount; // argv[firstCount] to argv[lastCount] are sizes or counts - positive integers
+    int lastCount;
+};
+
+static const ModeName MODE_NAMES[] =
+{
+    {"--autotune", MODE_AUTOTUNE, 0, 0, -1},
+    {"--image", MODE_IMAGE, 0, 0, -1},
+    {"--iterate", MODE_ITERATE, 0, 2, 2},
+    {"--jacobi", MODE_JACOBI, 0, 2, 3},
+    {"--multi", MODE_MULTI, 0, 2, 4},
+    {"--service", MODE_SERVICE, 0, 2, 4},
+    {"--batch", MODE_BATCH, 1, 4, 4},
+    {"--tiled", MODE_TILED, 1, 0, -1},
+    {"--volume", MODE_VOLUME, 0, 2, 4},
+    {"--pixels", MODE_PIXELS, 0, 3, 4},
+    {"--to-tiles", MODE_TO_TILES, 2, 0, -1},
+    {"--to-png", MODE_TO_PNG, 2, 0, -1}
+};
+
+
+// whether an argument is a whole number > 0 that fits into a cl_int
+bool isCount(const char* arg)
+{
+    char* end;
+    long value = strtol(arg, &end, 10);
 
-    // fill matrix with random values
-    for(int i = 0; i < width * height; i++)
-    {
-        matrix[i] = rand() % maxVal;
-    }
+    return end != arg && *end == '\0' && value > 0 && value <= INT_MAX;
+}
 
-    // output original test matrix
-    cout << "Original data:\n";
-    for(int i = 0; i < height; i++)
+
+// find the mode named by argv[1] and check the arguments given for it
+RunMode parseMode(int argc, char* argv[])
+{
+    if (argc < 2)
+        return MODE_MATRIX;
+
+    for (size_t i = 0; i < sizeof(MODE_NAMES) / sizeof(MODE_NAMES[0]); i++)
     {
-        for(int j = 0; j < width; j++)
+        const ModeName& mode = MODE_NAMES[i];
+
+        if (strcmp(argv[1], mode.name) != 0)
+            continue;
+
+        if (argc - 2 < mode.requiredArgs)
+            return MODE_INVALID;
+
+        for (int a = mode.firstCount; a <= mode.lastCount && a < argc; a++)
+            if (!isCount(argv[a]))
+                return MODE_INVALID;
+
+        // sigma of the iterated blur - 0 uses the #defined mask
+        if (mode.mode == MODE_ITERATE && argc > 3)
         {
-            cout << +matrix[i * height + j] << " ";
+            char* end;
+            double sigma = strtod(argv[3], &end);
+
+            if (end == argv[3] || *end != '\0' || !(sigma >= 0))
+                return MODE_INVALID;
         }
 
-        cout << "\n";
+        return mode.mode;
+    }
+
+    return MODE_INVALID;
+}
+
+
+void printUsage(const char* program)
+{
+    cout << "usage: " << program << " [--autotune]\n"
+         << "       " << program << " --image [input.png [output.png]]\n"
+         << "       " << program << " --iterate [passes [sigma]]\n"
+         << "       " << program << " --jacobi [maxSteps [stepsPerLaunch]]\n"
+         << "       " << program << " --multi [rounds [width height]]\n"
+         << "       " << program << " --service [images [width height]]\n"
+         << "       " << program << " --batch <input dir or list file> [output dir [images per launch]]\n"
+         << "       " << program << " --tiled <input.tiles> [output.tiles]\n"
+         << "       " << program << " --volume [width height depth]\n"
+         << "       " << program << " --pixels [int|uint8|uint16|float|half [width height]]\n"
+         << "       " << program << " --to-tiles <input.png> <output.tiles>\n"
+         << "       " << program << " --to-png <input.tiles> <output.png>\n"
+         << "sizes and counts are positive integers, sigma is a number >= 0\n";
+}
+
+
+// i-th command line argument or a default if it is missing
+const char* argString(int argc, char* argv[], int i, const char* value)
+{
+    return argc > i ? argv[i] : value;
+}
+
+// parseMode has checked that present size and count arguments are positive
+cl_int argInt(int argc, char* argv[], int i, cl_int value)
+{
+    return argc > i ? atoi(argv[i]) : value;
+}
+
+
+// run one of the modes with its own arguments (argv[2] onwards) - context
+// and device are NULL if the native host implementation has to be used
+int runMode(RunMode mode, cl_context context, cl_device_id device_id, int argc, char* argv[])
+{
+    switch (mode)
+    {
+        case MODE_IMAGE:
+            return blurImage(context, device_id, argString(argc, argv, 2, INPUT_FILENAME), argString(argc, argv, 3, OUTPUT_FILENAME));
+
+        case MODE_ITERATE:
+            return blurIterated(context, device_id, IMAGE_WIDTH, IMAGE_HEIGHT,
+                                argInt(argc, argv, 2, BLUR_PASSES),
+                                argc > 3 ? atof(argv[3]) : BLUR_SIGMA);
+
+        case MODE_JACOBI:
+            return solveJacobi(context, device_id, IMAGE_WIDTH, IMAGE_HEIGHT,
+                               argInt(argc, argv, 2, JACOBI_MAX_STEPS),
+                               argInt(argc, argv, 3, JACOBI_STEPS_PER_LAUNCH));
+
+        case MODE_SERVICE:
+            // the BlurContext creates its own context
+            return blurService(device_id, argInt(argc, argv, 2, SERVICE_IMAGES),
+                               argInt(argc, argv, 3, IMAGE_WIDTH), argInt(argc, argv, 4, IMAGE_HEIGHT));
+
+        case MODE_BATCH:
+            return blurBatch(context, device_id, argv[2], argString(argc, argv, 3, BATCH_OUTPUT_DIR),
+                             argInt(argc, argv, 4, BATCH_PACK_IMAGES));
+
+        case MODE_TILED:
+            return blurTiled(context, device_id, argv[2], argString(argc, argv, 3, TILED_OUTPUT));
+
+        case MODE_VOLUME:
+            return blurVolume(context, device_id, argInt(argc, argv, 2, VOLUME_WIDTH),
+                              argInt(argc, argv, 3, VOLUME_HEIGHT), argInt(argc, argv, 4, VOLUME_DEPTH));
+
+        case MODE_PIXELS:
+            return blurPixels(context, device_id, argString(argc, argv, 2, PIXEL_TYPE),
+                              argInt(argc, argv, 3, IMAGE_WIDTH), argInt(argc, argv, 4, IMAGE_HEIGHT));
+
+        default:
+            return runOnHost(IMAGE_WIDTH, IMAGE_HEIGHT);
     }
-    cout << "\n\n\n";
 }
 
 
 int main (int argc, char* argv[])
 {
-    // open file containg kernel code
-    char* source_str = read_source(KERNEL_PATH);
+    RunMode mode = parseMode(argc, argv);
+
+    // modes that need no openCL device
+    switch (mode)
+    {
+        case MODE_INVALID:
+            printUsage(argv[0]);
+            return 1;
+
+        case MODE_TO_TILES:
+            return tiled_from_png(argv[2], argv[3], TILE_WIDTH, TILE_HEIGHT) ? 0 : 1;
 
-    // get length of source code in bytes
-    size_t source_size = strlen(source_str) * sizeof(char);
+        case MODE_TO_PNG:
+            return tiled_to_png(argv[2], argv[3]) ? 0 : 1;
+
+        case MODE_MULTI:
+            // opens all devices itself
+            return blurMulti(argInt(argc, argv, 3, IMAGE_WIDTH), argInt(argc, argv, 4, IMAGE_HEIGHT),
+                             argInt(argc, argv, 2, MULTI_ROUNDS));
+
+        default:
+            break;
+    }
 
     // Create OpenCL context with GPU as device
     cl_device_id device_id = NULL;
@@ -150,12 +1404,23 @@ int main (int argc, char* argv[])
 
     // get list of available devices
     ret = clGetDeviceIDs(platform_id, // the id of the platform to use
-                   CL_DEVICE_TYPE_GPU, // type of device to use - can be changed to CPU for debugging
+                   DEVICE_TYPE, // type of device to use
                    1, // max number of devices to be used
                    &device_id, // list of found device IDs
                    &ret_num_devices); // number of found device IDs
     checkError(ret, "clGetDeviceIDs");
 
+    // fall back to native host implementation on machines without device
+    if (ret != CL_SUCCESS || ret_num_devices == 0)
+    {
+        cout << "No openCL device found - using native host implementation\n\n";
+
+        return runMode(mode, NULL, NULL, argc, argv);
+    }
+
+
+    if (mode == MODE_SERVICE)
+        return runMode(mode, NULL, device_id, argc, argv);
 
     // create openCL context
     cl_context context = clCreateContext(NULL, // list of context property names - NULL == implementation-defined
@@ -166,61 +1431,154 @@ int main (int argc, char* argv[])
                                          &ret); // return value
     checkError(ret, "clCreateContext");
 
+    if (mode != MODE_MATRIX && mode != MODE_AUTOTUNE)
+    {
+        ret = runMode(mode, context, device_id, argc, argv);
+        clReleaseContext(context);
 
-    // Create program "object"
-    cl_program program_boxblur = clCreateProgramWithSource(context,
-                                                            1, // number of program strings
-                                                            (const char **) &source_str, // kernel source code
-                                                            (const size_t *) &source_size, // size of string
-                                                            &ret); // return value
-    checkError(ret, "clCreateProgramWithSource");
+        return ret;
+    }
 
-    // Compile openCL kernel
-    char build_params[] = {"-Werror"}; // treat warnings as errors
+    // kernel configuration - taken from the #defines above unless
+    // the device has been tuned for this image size and mask
+    cl_int mask[4] = {MASK_SIZE_LEFT, MASK_SIZE_UP, MASK_SIZE_RIGHT, MASK_SIZE_DOWN};
 
-    ret = clBuildProgram (program_boxblur, // program object
-                           1, // number of devices
-                           &device_id, // list of devices
-                           build_params, // compiler options
-                           NULL, // callback function pointer for debug output
-                           NULL); // callback function arguments
-    checkError(ret, "clBuildProgram");
+    TuningConfig config;
+    config.kernelPath = KERNEL_PATH;
+    config.localSize[0] = LOCAL_X;
+    config.localSize[1] = LOCAL_Y;
+    config.blockSize[0] = (IMAGE_WIDTH + THREAD_NUM - 1) / THREAD_NUM;
+    config.blockSize[1] = (IMAGE_HEIGHT + THREAD_NUM - 1) / THREAD_NUM;
 
+    string tuningFile = tuning_path(device_id, TUNING_DIR);
 
-    // if build failed, output debug info
-    if (ret != CL_SUCCESS)
+    // autotune mode: find fastest configuration, store it for later runs and exit
+    if (mode == MODE_AUTOTUNE)
     {
-        cout << "clBuildProgram: " << ret << "\n";
+        if (autotune(context, device_id, width, height, mask, &config))
+        {
+            cout << "\nBest configuration: " << config.kernelPath
+                 << " local " << config.localSize[0] << "x" << config.localSize[1]
+                 << " block " << config.blockSize[0] << "x" << config.blockSize[1]
+                 << " (" << config.milliseconds << " ms)\n";
+
+            if (!store_tuning(tuningFile, width, height, mask, config))
+                cout << "Could not write tuning file " << tuningFile << "\n";
+        }
+        else
+            cout << "No working configuration found\n";
+
+        clReleaseContext(context);
+
+        return 0;
+    }
+
+#if ENGINE == ENGINE_DIRECT
+    // tuned configurations only exist for single kernel engines
+    if (load_tuning(tuningFile, width, height, mask, &config))
+        cout << "Using tuned configuration from " << tuningFile << "\n";
+
+    // the vector kernel computes runs of vectorWidth pixels - widen blocks to whole runs
+    cl_int vectorWidth = vector_width(device_id);
 
-        size_t len = 0;
-        char* buffer;
+    if (config.kernelPath == VECTOR_KERNEL_PATH)
+        config.blockSize[0] = (cl_int) round_up(config.blockSize[0], vectorWidth);
+#endif
 
-        // check length of build log string
-        clGetProgramBuildInfo(program_boxblur, // program object to request info on
-                              device_id, // lol
-                              CL_PROGRAM_BUILD_LOG, // type of information to request
-                              0, // memory pointer to which information is written
-                              NULL, // size of returned information
-                              &len); // pointer to memory where to save length of returned string
+    // rows of input and output image - only the direct engine kernels read a pitch
+#if ENGINE == ENGINE_DIRECT && PITCHED_ROWS
+    cl_int pitch = row_pitch(device_id, width);
+#else
+    cl_int pitch = width;
+#endif
+    size_t bufferBytes = (size_t) pitch * height * sizeof(cl_int); // size of image including row padding
 
-        // allocate sufficient buffer - black cast magic due to compiling C with g++
-        buffer = static_cast<char*>(calloc(len, sizeof(char)));
+    // timings of host phases and device commands
+    ProfileReport report(width, height);
+    double phaseStart = host_time_ms();
 
-        // copy build log to buffer
-        clGetProgramBuildInfo(program_boxblur, device_id, CL_PROGRAM_BUILD_LOG, len, buffer, NULL);
+    // open file containg kernel code
+    char* source_str = read_source(config.kernelPath.c_str());
+
+    if (!source_str)
+    {
+        cout << config.kernelPath << ": cannot read kernel source\n";
+        clReleaseContext(context);
+
+        return 1;
+    }
 
-        // print build log
-        fprintf(stderr, "%s\n", buffer);
+#if STENCIL
+    // the generated kernel has the arguments of the box blur kernels,
+    // so the rest of the host code stays the same
+    Stencil stencil;
+    if (!loadImageStencil(&stencil))
+    {
+        free(source_str);
+        clReleaseContext(context);
 
-        free(buffer);
+        return 1;
     }
 
+    free(source_str);
+    source_str = strdup(generate_stencil_source(stencil).c_str());
+
+    cl_int reach[4];
+    stencil_extent(stencil, reach);
+
+    cout << "Using stencil " << stencil.name << " with " << stencil.taps.size() << " taps reaching "
+         << reach[0] << "," << reach[1] << "," << reach[2] << "," << reach[3] << "\n\n";
+#endif
+    report.add_host("source_load", phaseStart, host_time_ms());
+
+
+    // Compile openCL kernel (or load it from the program cache)
+#if ENGINE == ENGINE_BORDER
+    string build_params = "-Werror -DBORDER_MODE=" TO_STRING(BORDER_MODE); // treat warnings as errors, border mode of border kernel
+#else
+    string build_params = "-Werror"; // treat warnings as errors
+#endif
+
+#if ENGINE == ENGINE_DIRECT
+    // run length of the vector kernel - the other direct kernels ignore it
+    build_params += " -D VECTOR_WIDTH=" + to_string(vectorWidth);
+#endif
+    phaseStart = host_time_ms();
+
+#if SPECIALIZE_KERNELS
+    // image, mask and block sizes become compile-time constants of the program
+    VariantCache variants(context, device_id, source_str, build_params.c_str(), PROGRAM_CACHE_DIR);
+
+    VariantParams params;
+    memset(&params, 0, sizeof(params));
+    params.imageWidth = IMAGE_WIDTH;
+    params.imageHeight = IMAGE_HEIGHT;
+    params.imagePitch = pitch;
+    params.mask[0] = MASK_SIZE_LEFT;
+    params.mask[1] = MASK_SIZE_UP;
+    params.mask[2] = MASK_SIZE_RIGHT;
+    params.mask[3] = MASK_SIZE_DOWN;
+    params.block[0] = config.blockSize[0];
+    params.block[1] = config.blockSize[1];
+
+    cl_program program_boxblur = variants.get(params, &ret); // owned by variant cache
+    checkError(ret, "VariantCache::get");
+#else
+    cl_program program_boxblur = build_program(context,
+                                               device_id, // device to build for
+                                               source_str, // kernel source code
+                                               build_params.c_str(), // compiler options
+                                               PROGRAM_CACHE_DIR, // directory of cached binaries - NULL disables cache
+                                               &ret); // return value
+    checkError(ret, "build_program");
+#endif
+    report.add_host("build", phaseStart, host_time_ms());
 
 
     // Select device and create a command queue for it
     cl_command_queue command_queue = clCreateCommandQueue(context,
                                                             device_id,
-                                                            0, // properties -NULL is default
+                                                            PROFILING ? CL_QUEUE_PROFILING_ENABLE : 0, // properties - 0 is default
                                                             &ret); // return value
     checkError(ret, "clCreateCommandQueue");
 
@@ -230,51 +1588,83 @@ int main (int argc, char* argv[])
                                               &ret); // return value pointer
     checkError(ret, "clCreateKernel");
 
+#if ENGINE == ENGINE_SAT
+    // prefix sum kernels building the summed-area table
+    cl_kernel kernel_sat_rows = clCreateKernel(program_boxblur, "sat_rows", &ret);
+    checkError(ret, "clCreateKernel_SAT_ROWS");
+
+    cl_kernel kernel_sat_cols = clCreateKernel(program_boxblur, "sat_cols", &ret);
+    checkError(ret, "clCreateKernel_SAT_COLS");
+#elif ENGINE == ENGINE_SEPARABLE
+    // horizontal pass kernel - "boxblur" is the vertical pass
+    cl_kernel kernel_rows = clCreateKernel(program_boxblur, "boxblur_rows", &ret);
+    checkError(ret, "clCreateKernel_ROWS");
+#elif ENGINE == ENGINE_BORDER
+    // border bands - "boxblur" covers the interior
+    cl_kernel kernel_border = clCreateKernel(program_boxblur, "boxblur_border", &ret);
+    checkError(ret, "clCreateKernel_BORDER");
+#endif
+
     // prepare kernel argument host memory
-    cl_int* h_testValues = (cl_int*) malloc (width * height * sizeof(cl_int)); // host memory for input image
-	cl_int* h_matrixSize = (cl_int*) malloc (2 * sizeof(cl_int));	// host memory for matrix dimensions
-    cl_int* h_masksize = (cl_int*) malloc (4 * sizeof(cl_int)); // host memory for mask dimensions
+#if ZERO_COPY
+    // input and output image are mapped from their device buffers below
+    cl_int* h_testValues = NULL;
+    cl_int* h_blurred = NULL;
+#else
+    cl_int* h_testValues = (cl_int*) malloc (bufferBytes); // host memory for input image (same row layout as on the device)
+    cl_int* h_blurred = (cl_int*) malloc (bufferBytes); // host memory for output image
+#endif
+	cl_int* h_matrixSize = (cl_int*) malloc (3 * sizeof(cl_int));	// host memory for matrix dimensions and row pitch
+    cl_int* h_masksize = (cl_int*) malloc (MASK_PARAMS * sizeof(cl_int)); // host memory for mask dimensions and reciprocal
 	cl_int* h_blocksize = (cl_int*) malloc (2 * sizeof(cl_int)); // host memory for block size
-    cl_int* h_blurred = (cl_int*) malloc (width * height * sizeof(cl_int)); // host memory for output image
 
+#if !ZERO_COPY
     // initialize allocated host memory with data
-    createMatrix (h_testValues, IMAGE_WIDTH, IMAGE_HEIGHT, 4); // create random matrix
-    memset((void*) h_blurred, 0, width * height * sizeof(cl_int)); // initialize output matrix as 0-matrix
+    createMatrix (h_testValues, IMAGE_WIDTH, IMAGE_HEIGHT, pitch, 4); // create random matrix
+#endif
 
 	// set matrix dimensions
 	h_matrixSize[0] = IMAGE_WIDTH;
 	h_matrixSize[1] = IMAGE_HEIGHT;
+	h_matrixSize[2] = pitch;
 
-    // set mask dimensions
-    h_masksize[0] = MASK_SIZE_LEFT;
-    h_masksize[1] = MASK_SIZE_UP;
-    h_masksize[2] = MASK_SIZE_RIGHT;
-    h_masksize[3] = MASK_SIZE_DOWN;
+    // set mask dimensions - and the reciprocal of the mask size the direct
+    // kernels normalize with (see pixel_types.hpp)
+    cl_int maskDimensions[4] = {MASK_SIZE_LEFT, MASK_SIZE_UP, MASK_SIZE_RIGHT, MASK_SIZE_DOWN};
+    mask_params(maskDimensions, h_masksize);
 
     // set block sizes based on number
-    // of available threads
-	h_blocksize[0] = (IMAGE_WIDTH) / THREAD_NUM;
-	h_blocksize[1] = (IMAGE_HEIGHT) / THREAD_NUM;
+    // of available threads (or tuned configuration)
+	h_blocksize[0] = config.blockSize[0];
+	h_blocksize[1] = config.blockSize[1];
 
     // create openCL buffer objects
+    phaseStart = host_time_ms();
+
     // create input buffer
     cl_mem d_image = clCreateBuffer (context,
-  	                                 CL_MEM_READ_ONLY, // flags - read-only in kernel
-  	                                 width * height * sizeof(cl_int), // size of buffer
+  	                                 CL_MEM_READ_ONLY | (ZERO_COPY ? CL_MEM_ALLOC_HOST_PTR : 0), // flags - read-only in kernel, host-accessible memory for zero-copy
+  	                                 bufferBytes, // size of buffer
   	                                 NULL, // host pointer to memory for buffer
   	                                 &ret); // return value
     checkError(ret, "clCreateBuffer_INPUT");
 
+#if SPECIALIZE_KERNELS
+    // parameters are build options - kernels do not read these arguments
+    cl_mem d_matrixSize = NULL;
+    cl_mem d_masksize = NULL;
+    cl_mem d_blocksize = NULL;
+#else
 	cl_mem d_matrixSize = clCreateBuffer (context,
 										  CL_MEM_READ_ONLY,
-										  2 * sizeof(cl_int),
+										  3 * sizeof(cl_int),
 										  NULL,
 										  &ret);
 	checkError(ret, "clCreateBuffer_MATRIXSIZE");
 
     cl_mem d_masksize = clCreateBuffer (context,
                                         CL_MEM_READ_ONLY,
-                                        4 * sizeof(cl_int),
+                                        MASK_PARAMS * sizeof(cl_int),
                                         NULL,
                                         &ret);
     checkError(ret, "clCreateBuffer_MASKSIZE");
@@ -285,77 +1675,278 @@ int main (int argc, char* argv[])
 										  NULL,
 										  &ret);
 	checkError(ret, "clCreateBuffer_BLOCKSIZE");
+#endif
 
     // create output image object
     cl_mem d_blurred = clCreateBuffer (context,
-                                       CL_MEM_WRITE_ONLY, // write-only in kernel
-                                       width * height * sizeof(cl_int),
+                                       CL_MEM_WRITE_ONLY | (ZERO_COPY ? CL_MEM_ALLOC_HOST_PTR : 0), // write-only in kernel
+                                       bufferBytes,
                                        NULL,
                                        &ret);
     checkError(ret, "clCreateBuffer_OUTPUT");
 
-
+#if ENGINE == ENGINE_SAT
+    // create summed-area table - one extra zero row and column
+    cl_mem d_sat = clCreateBuffer (context,
+                                   CL_MEM_READ_WRITE, // written by scan kernels, read by lookup kernel
+                                   (width + 1) * (height + 1) * sizeof(cl_uint),
+                                   NULL,
+                                   &ret);
+    checkError(ret, "clCreateBuffer_SAT");
+#elif ENGINE == ENGINE_SEPARABLE
+    // create intermediate buffer for horizontal sums
+    cl_mem d_rowsums = clCreateBuffer (context,
+                                       CL_MEM_READ_WRITE, // written by horizontal pass, read by vertical pass
+                                       width * height * sizeof(cl_int),
+                                       NULL,
+                                       &ret);
+    checkError(ret, "clCreateBuffer_ROWSUMS");
+#endif
+    report.add_host("buffer_creation", phaseStart, host_time_ms());
+
+
+    // all transfers are non-blocking - the first kernel waits for their events
+    cl_event transfers[4];
+    cl_uint numTransfers = 0;
+
+#if ZERO_COPY
+    // map input buffer and create test data directly in it: no copy at all on
+    // devices sharing memory with the host, pinned (DMA) memory on discrete devices
+    h_testValues = (cl_int*) clEnqueueMapBuffer(command_queue,
+                                                d_image, // buffer object
+                                                CL_TRUE, // blocking map - data is written right away
+                                                CL_MAP_WRITE_INVALIDATE_REGION, // old contents are not needed
+                                                0, // offset
+                                                bufferBytes, // size of mapped region
+                                                0,
+                                                NULL,
+                                                NULL,
+                                                &ret);
+    checkError(ret, "clEnqueueMapBuffer_INPUT");
+
+    createMatrix (h_testValues, IMAGE_WIDTH, IMAGE_HEIGHT, pitch, 4); // create random matrix
+
+    // hand input back to the device
+    ret = clEnqueueUnmapMemObject(command_queue, d_image, h_testValues, 0, NULL, &transfers[numTransfers++]);
+    checkError(ret, "clEnqueueUnmapMemObject_INPUT");
+    report.add_event("unmap_input", transfers[numTransfers - 1], bufferBytes, 0);
+#else
     // write input image to kernel
     ret = clEnqueueWriteBuffer(command_queue,
                                d_image, // buffer object
-                               CL_TRUE, // blocking write
+                               CL_FALSE, // non-blocking write - h_testValues stays valid
                                0, // offset
-                               width * height * sizeof(cl_int), // size of data being written
+                               bufferBytes, // size of data being written
                                (void*) h_testValues, // host pointer to data to be written
                                0, // number of events before this
                                NULL, // list of events to be executed before this
-                               NULL); // event handle to this write action
+                               &transfers[numTransfers++]); // event handle to this write action
     checkError(ret, "clEnqueueWriteBuffer_INPUT");
+    report.add_event("write_input", transfers[numTransfers - 1], bufferBytes, 0);
+#endif
 
+#if !SPECIALIZE_KERNELS
 	// write matrixsize array to kernel
     ret = clEnqueueWriteBuffer(command_queue,
                                d_matrixSize,
-                               CL_TRUE,
+                               CL_FALSE,
                                0,
-                               2 * sizeof(cl_int),
+                               3 * sizeof(cl_int),
                                (void*) h_matrixSize,
                                0,
                                NULL,
-                               NULL);
+                               &transfers[numTransfers++]);
     checkError(ret, "clEnqueueWriteBuffer_MATRIXSIZE");
+    report.add_event("write_matrixsize", transfers[numTransfers - 1], 3 * sizeof(cl_int), 0);
 
     // write masksize array to kernel
     ret = clEnqueueWriteBuffer(command_queue,
                                d_masksize,
-                               CL_TRUE,
+                               CL_FALSE,
                                0,
-                               4 * sizeof(cl_int),
+                               MASK_PARAMS * sizeof(cl_int),
                                (void*) h_masksize,
                                0,
                                NULL,
-                               NULL);
+                               &transfers[numTransfers++]);
     checkError(ret, "clEnqueueWriteBuffer_MASKSIZE");
+    report.add_event("write_masksize", transfers[numTransfers - 1], MASK_PARAMS * sizeof(cl_int), 0);
 
 	// write blocksize array to kernel
     ret = clEnqueueWriteBuffer(command_queue,
                                d_blocksize,
-                               CL_TRUE,
+                               CL_FALSE,
                                0,
                                2 * sizeof(cl_int),
                                (void*) h_blocksize,
                                0,
                                NULL,
-                               NULL);
+                               &transfers[numTransfers++]);
     checkError(ret, "clEnqueueWriteBuffer_BLOCKSIZE");
+    report.add_event("write_blocksize", transfers[numTransfers - 1], 2 * sizeof(cl_int), 0);
+#endif
 
-    // write output image to kernel
-    ret = clEnqueueWriteBuffer(command_queue,
-                               d_blurred,
-                               CL_TRUE,
-                               0,
-                               width * height * sizeof(cl_int),
-                               (void*) h_blurred,
-                               0,
-                               NULL,
-                               NULL);
-    checkError(ret, "clEnqueueWriteBuffer_OUTPUT");
+    // (the output image is written completely by the kernel and needs no upload)
+
+    cl_event kernelDone; // last kernel of the engine
+    size_t imageBytes = width * height * sizeof(cl_int);
+
+#if ENGINE == ENGINE_SAT
+    // set kernel arguments of row scan
+    ret = clSetKernelArg(kernel_sat_rows, 0, sizeof(cl_mem), (void*) &d_image); // image to scan
+    checkError(ret, "clSetKernelArg_SAT_ROWS_0");
+
+    ret = clSetKernelArg(kernel_sat_rows, 1, sizeof(cl_mem), (void*) &d_matrixSize); // size of matrix in XY dimensions
+    checkError(ret, "clSetKernelArg_SAT_ROWS_1");
+
+    ret = clSetKernelArg(kernel_sat_rows, 2, SCAN_LOCAL_SIZE * sizeof(cl_uint), NULL); // local scan buffer
+    checkError(ret, "clSetKernelArg_SAT_ROWS_2");
+
+    ret = clSetKernelArg(kernel_sat_rows, 3, sizeof(cl_mem), (void*) &d_sat); // summed-area table
+    checkError(ret, "clSetKernelArg_SAT_ROWS_3");
+
+    // set kernel arguments of column scan
+    ret = clSetKernelArg(kernel_sat_cols, 0, sizeof(cl_mem), (void*) &d_matrixSize);
+    checkError(ret, "clSetKernelArg_SAT_COLS_0");
+
+    ret = clSetKernelArg(kernel_sat_cols, 1, sizeof(cl_mem), (void*) &d_sat);
+    checkError(ret, "clSetKernelArg_SAT_COLS_1");
+
+    // set kernel arguments of lookup
+    ret = clSetKernelArg(kernel_boxblur, 0, sizeof(cl_mem), (void*) &d_sat); // summed-area table
+    checkError(ret, "clSetKernelArg_0");
+
+    ret = clSetKernelArg(kernel_boxblur, 1, sizeof(cl_mem), (void*) &d_matrixSize); // size of matrix in XY dimensions
+    checkError(ret, "clSetKernelArg_1");
+
+    ret = clSetKernelArg(kernel_boxblur, 2, sizeof(cl_mem), (void*) &d_masksize); // size of mask in NSWE dimensions
+    checkError(ret, "clSetKernelArg_2");
+
+    ret = clSetKernelArg(kernel_boxblur, 3, sizeof(cl_mem), (void*) &d_blurred); // output image
+    checkError(ret, "clSetKernelArg_3");
+
+    // one work group per image row
+    const size_t scanGlobalSizes[2] = {SCAN_LOCAL_SIZE, (size_t) height};
+    const size_t scanLocalSize[2] = {SCAN_LOCAL_SIZE, 1};
+
+    // one work item per table column
+    const size_t colGlobalSize[1] = {(size_t) width + 1};
+
+    // one work item per pixel
+    const size_t globalSizes[2] = {(size_t) width, (size_t) height};
+
+    cout << "Image size is X:" << IMAGE_WIDTH << " Y:" << IMAGE_HEIGHT << "\n";
+    cout << "Using summed-area table with " << SCAN_LOCAL_SIZE << " work items per row scan\n\n";
+
+    // the queue is in-order, so every kernel sees the results of the previous one
+    cl_event satRowsDone, satColsDone;
+
+    ret = clEnqueueNDRangeKernel(command_queue, kernel_sat_rows, 2, NULL, scanGlobalSizes, scanLocalSize, numTransfers, transfers, &satRowsDone);
+    checkError(ret, "clEnqueueNDRangeKernel_SAT_ROWS");
+    report.add_event("kernel_sat_rows", satRowsDone, 2 * imageBytes, width * height);
+    clReleaseEvent(satRowsDone);
+
+    ret = clEnqueueNDRangeKernel(command_queue, kernel_sat_cols, 1, NULL, colGlobalSize, NULL, 0, NULL, &satColsDone);
+    checkError(ret, "clEnqueueNDRangeKernel_SAT_COLS");
+    report.add_event("kernel_sat_cols", satColsDone, 2 * imageBytes, width * height);
+    clReleaseEvent(satColsDone);
+
+    ret = clEnqueueNDRangeKernel(command_queue, kernel_boxblur, 2, NULL, globalSizes, NULL, 0, NULL, &kernelDone);
+    checkError(ret, "clEnqueueNDRangeKernel");
+#elif ENGINE == ENGINE_SEPARABLE
+    // set kernel arguments of horizontal pass
+    ret = clSetKernelArg(kernel_rows, 0, sizeof(cl_mem), (void*) &d_image); // image to blur
+    checkError(ret, "clSetKernelArg_ROWS_0");
+
+    ret = clSetKernelArg(kernel_rows, 1, sizeof(cl_mem), (void*) &d_matrixSize); // size of matrix in XY dimensions
+    checkError(ret, "clSetKernelArg_ROWS_1");
+
+    ret = clSetKernelArg(kernel_rows, 2, sizeof(cl_mem), (void*) &d_masksize); // size of mask in NSWE dimensions
+    checkError(ret, "clSetKernelArg_ROWS_2");
+
+    ret = clSetKernelArg(kernel_rows, 3, sizeof(cl_mem), (void*) &d_rowsums); // horizontal sums
+    checkError(ret, "clSetKernelArg_ROWS_3");
+
+    // set kernel arguments of vertical pass
+    ret = clSetKernelArg(kernel_boxblur, 0, sizeof(cl_mem), (void*) &d_rowsums); // horizontal sums
+    checkError(ret, "clSetKernelArg_0");
+
+    ret = clSetKernelArg(kernel_boxblur, 1, sizeof(cl_mem), (void*) &d_matrixSize);
+    checkError(ret, "clSetKernelArg_1");
+
+    ret = clSetKernelArg(kernel_boxblur, 2, sizeof(cl_mem), (void*) &d_masksize);
+    checkError(ret, "clSetKernelArg_2");
+
+    ret = clSetKernelArg(kernel_boxblur, 3, sizeof(cl_mem), (void*) &d_blurred); // output image
+    checkError(ret, "clSetKernelArg_3");
+
+    // one work item per row, then one work item per column
+    const size_t rowGlobalSize[1] = {(size_t) height};
+    const size_t colGlobalSize[1] = {(size_t) width};
+
+    cout << "Image size is X:" << IMAGE_WIDTH << " Y:" << IMAGE_HEIGHT << "\n";
+    cout << "Using separable passes with " << height << " row and " << width << " column work items\n\n";
+
+    // the queue is in-order, so the vertical pass sees all horizontal sums
+    cl_event rowsDone;
+
+    ret = clEnqueueNDRangeKernel(command_queue, kernel_rows, 1, NULL, rowGlobalSize, NULL, numTransfers, transfers, &rowsDone);
+    checkError(ret, "clEnqueueNDRangeKernel_ROWS");
+    report.add_event("kernel_rows", rowsDone, 2 * imageBytes, width * height);
+    clReleaseEvent(rowsDone);
+
+    ret = clEnqueueNDRangeKernel(command_queue, kernel_boxblur, 1, NULL, colGlobalSize, NULL, 0, NULL, &kernelDone);
+    checkError(ret, "clEnqueueNDRangeKernel");
+#elif ENGINE == ENGINE_BORDER
+    // both kernels have the same arguments
+    cl_kernel borderKernels[2] = {kernel_boxblur, kernel_border};
 
+    for (int i = 0; i < 2; i++)
+    {
+        ret = clSetKernelArg(borderKernels[i], 0, sizeof(cl_mem), (void*) &d_image); // image to blur
+        checkError(ret, "clSetKernelArg_0");
+
+        ret = clSetKernelArg(borderKernels[i], 1, sizeof(cl_mem), (void*) &d_matrixSize); // size of matrix in XY dimensions
+        checkError(ret, "clSetKernelArg_1");
+
+        ret = clSetKernelArg(borderKernels[i], 2, sizeof(cl_mem), (void*) &d_masksize); // size of mask in NSWE dimensions
+        checkError(ret, "clSetKernelArg_2");
+
+        ret = clSetKernelArg(borderKernels[i], 3, sizeof(cl_mem), (void*) &d_blurred); // output image
+        checkError(ret, "clSetKernelArg_3");
+    }
+
+    // band sizes as in boxblur_border.cl - if the mask is larger
+    // than the image, the bands cover all of it
+    int top = min(MASK_SIZE_UP, height);
+    int bottom = min(MASK_SIZE_DOWN, height - top);
+    int leftCols = min(MASK_SIZE_LEFT, width);
+    int rightCols = min(MASK_SIZE_RIGHT, width - leftCols);
+
+    // interior pixels, addressed by their image position through the global offset
+    const size_t interiorOffset[2] = {(size_t) leftCols, (size_t) top};
+    const size_t interiorSizes[2] = {(size_t) (width - leftCols - rightCols), (size_t) (height - top - bottom)};
+
+    // one work item per border pixel
+    const size_t borderSize[1] = {(size_t) ((top + bottom) * width + (height - top - bottom) * (leftCols + rightCols))};
 
+    cout << "Image size is X:" << IMAGE_WIDTH << " Y:" << IMAGE_HEIGHT << "\n";
+    cout << "Using " << interiorSizes[0] * interiorSizes[1] << " interior and " << borderSize[0] << " border work items, border mode " << BORDER_MODE << "\n\n";
+
+    // both kernels write disjoint pixels - the border kernel follows on the in-order queue
+    if (interiorSizes[0] > 0 && interiorSizes[1] > 0)
+    {
+        cl_event interiorDone;
+
+        ret = clEnqueueNDRangeKernel(command_queue, kernel_boxblur, 2, interiorOffset, interiorSizes, NULL, numTransfers, transfers, &interiorDone);
+        checkError(ret, "clEnqueueNDRangeKernel_INTERIOR");
+        report.add_event("kernel_interior", interiorDone, 2 * interiorSizes[0] * interiorSizes[1] * sizeof(cl_int), interiorSizes[0] * interiorSizes[1]);
+        clReleaseEvent(interiorDone);
+    }
+
+    ret = clEnqueueNDRangeKernel(command_queue, kernel_border, 1, NULL, borderSize, NULL, numTransfers, transfers, &kernelDone);
+    checkError(ret, "clEnqueueNDRangeKernel_BORDER");
+#else
     // set kernel arguments
     ret = clSetKernelArg(kernel_boxblur, // kernel "object"
                          0, // argument index
@@ -376,24 +1967,29 @@ int main (int argc, char* argv[])
     checkError(ret, "clSetKernelArg_3");
 
     // implicitly allocate local memory by passing "NULL" instead of cl_mem object
-    ret = clSetKernelArg(kernel_boxblur, 4, (size_t) (MASK_SIZE_LEFT + LOCAL_X + MASK_SIZE_RIGHT) * (MASK_SIZE_UP + LOCAL_Y + MASK_SIZE_DOWN), NULL);
+    // (one work group tile plus mask halo - size is given in bytes)
+    ret = clSetKernelArg(kernel_boxblur, 4, (size_t) (MASK_SIZE_LEFT + config.localSize[0] + MASK_SIZE_RIGHT) * (MASK_SIZE_UP + config.localSize[1] + MASK_SIZE_DOWN) * sizeof(cl_int), NULL);
     checkError(ret, "clSetKernelArg_4");
 
     ret = clSetKernelArg(kernel_boxblur, 5, sizeof(cl_mem), (void*) &d_blurred); // output image
     checkError(ret, "clSetKernelArg_5");
 
     // enqueue kernel and run it
-	// set number of work items
-	int globalX = IMAGE_WIDTH / h_blocksize[0];
-	int globalY = IMAGE_HEIGHT / h_blocksize[1];
+	// set number of work items - enough blocks to cover the image, rounded up
+	// to whole work groups (the kernels skip pixels outside of the image)
+	size_t globalX = round_up((width + h_blocksize[0] - 1) / h_blocksize[0], config.localSize[0]);
+	size_t globalY = round_up((height + h_blocksize[1] - 1) / h_blocksize[1], config.localSize[1]);
     const size_t globalSizes[2] = {globalX, globalY}; // number of work items per dimension
-    const size_t localSize[2] = {LOCAL_X, LOCAL_Y}; // number of work items per work group per dimension
+    const size_t localSize[2] = {(size_t) config.localSize[0], (size_t) config.localSize[1]}; // number of work items per work group per dimension
 
-    cout << "Image size is X:" << IMAGE_WIDTH << " Y:" << IMAGE_HEIGHT << "\n";
-    cout << "Number of threads is " << THREAD_NUM << "\n";
+    cout << "Image size is X:" << IMAGE_WIDTH << " Y:" << IMAGE_HEIGHT << ", row pitch is " << pitch << " values\n";
+    cout << "Kernel is " << config.kernelPath;
+    if (config.kernelPath == VECTOR_KERNEL_PATH)
+        cout << " with runs of " << vectorWidth << " pixels";
+    cout << "\n";
     cout << "Block sizes are X:" << h_blocksize[0] << " Y:" << h_blocksize[1] << "\n";
     cout << "Number of work items per dimension: X:" << globalX << " Y:" << globalY << "\n";
-    cout << "Number of work items per work group per dimension: X:" << LOCAL_X << " Y:" << LOCAL_Y << "\n\n";
+    cout << "Number of work items per work group per dimension: X:" << config.localSize[0] << " Y:" << config.localSize[1] << "\n\n";
 
     ret = clEnqueueNDRangeKernel(command_queue, // command queue in which to enqueue task
                                     kernel_boxblur, // kernel to enqueue
@@ -401,57 +1997,112 @@ int main (int argc, char* argv[])
                                     NULL, // reserved for future use
                                     globalSizes, // number of work items per dimension
                                     localSize, // number of work items per work group per dimension
-                                    0, // number of events that shall be executed before this one
-                                    NULL, // list of events to be executed before this one - not needed
-                                    NULL); // event handle - not needed
+                                    numTransfers, // number of events that shall be executed before this one
+                                    transfers, // list of events to be executed before this one - all uploads
+                                    &kernelDone); // event handle - the read waits for it
     checkError(ret, "clEnqueueNDRangeKernel");
 
-    // wait for command queue to finish before reading results
-    ret = clFinish(command_queue);
-    checkError(ret, "clFinish");
+#endif
+
+    // every engine reads the image (or intermediate data) once and writes the output once
+    report.add_event("kernel_boxblur", kernelDone, 2 * imageBytes, width * height);
 
+    cl_event readDone;
+
+#if ZERO_COPY
+    // map output once the kernel is done - no copy on devices sharing memory with the host
+    h_blurred = (cl_int*) clEnqueueMapBuffer(command_queue, d_blurred, CL_TRUE, CL_MAP_READ, 0, bufferBytes, 1, &kernelDone, &readDone, &ret);
+    checkError(ret, "clEnqueueMapBuffer_OUTPUT");
+    report.add_event("map_output", readDone, bufferBytes, 0);
+
+    // map input again for verification
+    h_testValues = (cl_int*) clEnqueueMapBuffer(command_queue, d_image, CL_TRUE, CL_MAP_READ, 0, bufferBytes, 0, NULL, NULL, &ret);
+    checkError(ret, "clEnqueueMapBuffer_INPUT");
+#else
     // read from device and transfer buffer back to host
     ret = clEnqueueReadBuffer (command_queue,
                                d_blurred, // buffer object
                                CL_TRUE, // blocking read
                                0, // offset
-                               width * height * sizeof(cl_int), // size of buffer
+                               bufferBytes, // size of buffer
                                (void *) h_blurred, // host pointer to memory where to write buffer contents
-                               0, // number of events to complete before this
-                               NULL, // list of events to complete
-                               NULL); // event handle to this write action
+                               1, // number of events to complete before this
+                               &kernelDone, // list of events to complete - the (last) kernel
+                               &readDone); // event handle to this read action
     checkError(ret, "clEnqueueReadBuffer");
+    report.add_event("read_output", readDone, bufferBytes, 0);
+#endif
 
-    // output blurred test matrix
-    cout << "Changed data:\n";
-    for(int i = 0; i < height; i++)
-    {
-        for(int j = 0; j < width; j++)
-        {
-            cout << +h_blurred[i * height + j] << " ";
-        }
+    clReleaseEvent(readDone);
 
-        cout << "\n";
-    }
+    for (cl_uint i = 0; i < numTransfers; i++)
+        clReleaseEvent(transfers[i]);
+
+    clReleaseEvent(kernelDone);
+
+    // output blurred test matrix
+    printMatrix("Changed data", h_blurred, width, height, pitch);
+
+#if VERIFY_RESULT
+#if STENCIL
+    int mismatches = verifyStencil(h_testValues, h_blurred, width, height, pitch, stencil);
+#else
+    int mismatches = verifyResult(h_testValues, h_blurred, width, height, pitch, h_masksize);
+#endif
+
+    if (mismatches == 0)
+        cout << "\nVerification passed\n";
+    else
+        cout << "\nVerification FAILED: " << mismatches << " pixels differ from host result\n";
+#endif
+
+#if PROFILING
+    if (report.write(PROFILE_REPORT))
+        cout << "Timing report written to " << PROFILE_REPORT << "\n";
+    else
+        cout << "Could not write timing report " << PROFILE_REPORT << "\n";
+#endif
+
+#if ZERO_COPY
+    clEnqueueUnmapMemObject(command_queue, d_image, h_testValues, 0, NULL, NULL);
+    clEnqueueUnmapMemObject(command_queue, d_blurred, h_blurred, 0, NULL, NULL);
+    clFinish(command_queue);
+#endif
 
     // release OpenCL resources
    clReleaseMemObject(d_image);
+#if !SPECIALIZE_KERNELS
    clReleaseMemObject(d_matrixSize);
    clReleaseMemObject(d_masksize);
    clReleaseMemObject(d_blocksize);
+#endif
    clReleaseMemObject(d_blurred);
-
-   clReleaseProgram(program_boxblur);
+#if ENGINE == ENGINE_SAT
+   clReleaseMemObject(d_sat);
+   clReleaseKernel(kernel_sat_rows);
+   clReleaseKernel(kernel_sat_cols);
+#elif ENGINE == ENGINE_SEPARABLE
+   clReleaseMemObject(d_rowsums);
+   clReleaseKernel(kernel_rows);
+#elif ENGINE == ENGINE_BORDER
+   clReleaseKernel(kernel_border);
+#endif
+
+#if !SPECIALIZE_KERNELS
+   clReleaseProgram(program_boxblur); // variants are released by their cache
+#endif
    clReleaseKernel(kernel_boxblur);
    clReleaseCommandQueue(command_queue);
    clReleaseContext(context);
 
    // release host memory
+#if !ZERO_COPY
    free(h_testValues);
+   free(h_blurred);
+#endif
    free(h_matrixSize);
    free(h_masksize);
    free(h_blocksize);
-   free(h_blurred);
 
 
     return 0;
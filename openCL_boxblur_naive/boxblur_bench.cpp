@@ -0,0 +1,687 @@
+// benchmark of all box blur kernels over a range of image sizes and masks.
+
+// build: g++ -O3 -march=native boxblur_bench.cpp cpu_boxblur.cpp program_cache.cpp autotune.cpp pixel_types.cpp host_utils.cpp -lOpenCL -pthread
+// usage: boxblur_bench [maxSize [repeats]]
+
+// Every kernel variant is run for every image size and mask. The last of the
+// BENCH_WARMUP untimed launches is compared with the native host implementation,
+// then BENCH_REPEATS launches are timed with openCL profiling events (start of the
+// first pass to end of the last pass, transfers are not included). Median and
+// 95th percentile are printed as a table and written to BENCH_REPORT as CSV.
+// The exit code is 1 if any result was wrong or any launch failed.
+
+// The default device type includes CPU implementations such as PoCL,
+// so the benchmark also runs on machines without a GPU.
+
+#include <CL/cl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "autotune.hpp"
+#include "cpu_boxblur.hpp"
+#include "host_utils.hpp"
+#include "pixel_types.hpp"
+#include "program_cache.hpp"
+
+// device settings
+#define BENCH_DEVICE_TYPE CL_DEVICE_TYPE_ALL // first device of this type on any platform
+
+// measurement settings
+#define BENCH_MAX_SIZE 16384 // largest image width and height (first argument)
+#define BENCH_WARMUP 2 // untimed launches per measurement, the last one is verified
+#define BENCH_REPEATS 10 // timed launches per measurement (second argument)
+#define BENCH_MAX_TAPS (1ULL << 32) // skip direct kernels if width * height * mask size is larger
+
+// work item/group settings
+#define BENCH_LOCAL 8 // work items per work group per dimension (less if the NDRange is smaller)
+#define BENCH_BLOCK 4 // pixels per work item per dimension of the blocking kernels
+#define SCAN_LOCAL_SIZE 64 // work items per row in the summed-area table prefix scan
+
+// box blur engines (see boxblur.cpp)
+#define ENGINE_DIRECT 0
+#define ENGINE_SAT 1
+#define ENGINE_SEPARABLE 2
+
+#define PROGRAM_CACHE_DIR "./.clcache" // cached program binaries (NULL to always build from source)
+#define BENCH_REPORT "./boxblur_bench.csv"
+
+using namespace std;
+
+
+// a kernel file and how to launch it
+struct BenchVariant
+{
+    const char* name;
+    const char* kernelPath;
+    int engine;
+    cl_int block; // pixels per work item per dimension (direct engine only, 0 = one run of the device's vector width)
+};
+
+static const BenchVariant benchVariants[] = {
+    {"naive", "./boxblur_naive.cl", ENGINE_DIRECT, 1},
+    {"blocking", "./boxblur_blocking.cl", ENGINE_DIRECT, BENCH_BLOCK},
+    {"blocking_local", "./boxblur_blocking_local.cl", ENGINE_DIRECT, BENCH_BLOCK},
+    {"vector", "./boxblur_vector.cl", ENGINE_DIRECT, 0},
+    {"sat", "./boxblur_sat.cl", ENGINE_SAT, 1},
+    {"separable", "./boxblur_separable.cl", ENGINE_SEPARABLE, 1}
+};
+
+// image width and height - 1081 is no multiple of any block or work group size
+static const cl_int benchSizes[] = {8, 64, 256, 1024, 1081, 4096, 16384};
+
+// "k" parameters {left, up, right, down}, symmetric and asymmetric
+static const cl_int benchMasks[][4] = {
+    {1, 1, 1, 1},
+    {2, 2, 2, 2},
+    {7, 7, 7, 7},
+    {15, 15, 15, 15},
+    {0, 0, 4, 4},
+    {3, 1, 0, 6},
+    {8, 0, 8, 0}
+};
+
+#define NUM_VARIANTS (sizeof(benchVariants) / sizeof(benchVariants[0]))
+#define NUM_SIZES (sizeof(benchSizes) / sizeof(benchSizes[0]))
+#define NUM_MASKS (sizeof(benchMasks) / sizeof(benchMasks[0]))
+
+// one kernel launch of a variant
+struct Pass
+{
+    cl_kernel kernel;
+    cl_uint dims;
+    size_t global[2];
+    size_t local[2];
+    bool fixedLocal; // false: let the implementation choose the work group size
+};
+
+// built program of a variant, kernels in launch order
+struct VariantProgram
+{
+    cl_program program;
+    vector<cl_kernel> kernels;
+    vector<size_t> groupSizes; // maximum work group size per kernel
+};
+
+// device buffers of one image size, shared by all variants and masks
+struct SizeBuffers
+{
+    cl_mem image;
+    cl_mem imageSize;
+    cl_mem k;
+    cl_mem blockSize;
+    cl_mem output;
+    cl_mem scratch; // summed-area table or row sums
+};
+
+// one line of the result table
+struct BenchResult
+{
+    string variant;
+    cl_int width;
+    cl_int height;
+    cl_int k[4];
+    double median; // ms
+    double p95; // ms
+    const char* status;
+};
+
+
+// first device of BENCH_DEVICE_TYPE on any platform
+static bool find_device (cl_platform_id* platform, cl_device_id* device)
+{
+    cl_uint numPlatforms = 0;
+    if (clGetPlatformIDs(0, NULL, &numPlatforms) != CL_SUCCESS || numPlatforms == 0)
+        return false;
+
+    vector<cl_platform_id> platforms(numPlatforms);
+    clGetPlatformIDs(numPlatforms, platforms.data(), NULL);
+
+    for (cl_uint i = 0; i < numPlatforms; i++)
+    {
+        cl_uint numDevices = 0;
+        if (clGetDeviceIDs(platforms[i], BENCH_DEVICE_TYPE, 1, device, &numDevices) == CL_SUCCESS && numDevices > 0)
+        {
+            *platform = platforms[i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+// build a variant and create its kernels
+static bool build_variant (cl_context context, cl_device_id device, const BenchVariant& variant, VariantProgram* program)
+{
+    cl_int ret;
+    string source;
+
+    program->program = NULL;
+
+    if (!read_kernel(variant.kernelPath, &source))
+    {
+        cout << variant.kernelPath << ": cannot read kernel source\n";
+        return false;
+    }
+
+    // run length of the vector kernel
+    ostringstream options;
+    if (variant.block == 0)
+        options << "-D VECTOR_WIDTH=" << vector_width(device);
+
+    program->program = build_program(context, device, source.c_str(), options.str().c_str(), PROGRAM_CACHE_DIR, &ret);
+    if (ret != CL_SUCCESS)
+        return false;
+
+    vector<const char*> names;
+
+    if (variant.engine == ENGINE_SAT)
+    {
+        names.push_back("sat_rows");
+        names.push_back("sat_cols");
+    }
+    else if (variant.engine == ENGINE_SEPARABLE)
+        names.push_back("boxblur_rows");
+
+    names.push_back("boxblur");
+
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        cl_kernel kernel = clCreateKernel(program->program, names[i], &ret);
+        if (ret != CL_SUCCESS)
+        {
+            cout << variant.kernelPath << ": clCreateKernel " << names[i] << ": " << ret << "\n";
+            return false;
+        }
+
+        size_t groupSize = 1;
+        clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &groupSize, NULL);
+
+        program->kernels.push_back(kernel);
+        program->groupSizes.push_back(groupSize);
+    }
+
+    return true;
+}
+
+
+static void release_variant (VariantProgram* program)
+{
+    for (size_t i = 0; i < program->kernels.size(); i++)
+        clReleaseKernel(program->kernels[i]);
+
+    if (program->program)
+        clReleaseProgram(program->program);
+}
+
+
+static void release_buffers (SizeBuffers* buffers)
+{
+    cl_mem* mems[] = {&buffers->image, &buffers->imageSize, &buffers->k, &buffers->blockSize, &buffers->output, &buffers->scratch};
+
+    for (size_t i = 0; i < sizeof(mems) / sizeof(mems[0]); i++)
+    {
+        if (*mems[i])
+            clReleaseMemObject(*mems[i]);
+
+        *mems[i] = NULL;
+    }
+}
+
+
+// allocate all buffers of one image size and upload the image
+static bool create_buffers (cl_context context, cl_command_queue queue, const cl_int* image, cl_int width, cl_int height, SizeBuffers* buffers)
+{
+    cl_int ret[6];
+    cl_int imageSize[3] = {width, height, width}; // packed rows - the direct kernels read a row pitch
+
+    size_t imageBytes = (size_t) width * height * sizeof(cl_int);
+    size_t tableBytes = (size_t) (width + 1) * (height + 1) * sizeof(cl_uint); // large enough for row sums, too
+
+    buffers->image = clCreateBuffer(context, CL_MEM_READ_ONLY, imageBytes, NULL, &ret[0]);
+    buffers->imageSize = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, 3 * sizeof(cl_int), imageSize, &ret[1]);
+    buffers->k = clCreateBuffer(context, CL_MEM_READ_ONLY, MASK_PARAMS * sizeof(cl_int), NULL, &ret[2]);
+    buffers->blockSize = clCreateBuffer(context, CL_MEM_READ_ONLY, 2 * sizeof(cl_int), NULL, &ret[3]);
+    buffers->output = clCreateBuffer(context, CL_MEM_WRITE_ONLY, imageBytes, NULL, &ret[4]);
+    buffers->scratch = clCreateBuffer(context, CL_MEM_READ_WRITE, tableBytes, NULL, &ret[5]);
+
+    for (int i = 0; i < 6; i++)
+        if (ret[i] != CL_SUCCESS)
+            return false;
+
+    return clEnqueueWriteBuffer(queue, buffers->image, CL_TRUE, 0, imageBytes, image, 0, NULL, NULL) == CL_SUCCESS;
+}
+
+
+// largest work group of at most BENCH_LOCAL * BENCH_LOCAL work items that is not larger than the NDRange
+static void fit_local (const size_t* global, size_t maxGroupSize, size_t* local)
+{
+    local[0] = min((size_t) BENCH_LOCAL, global[0]);
+    local[1] = min((size_t) BENCH_LOCAL, global[1]);
+
+    while (local[0] * local[1] > maxGroupSize)
+    {
+        if (local[1] > 1)
+            local[1] /= 2;
+        else
+            local[0] /= 2;
+    }
+}
+
+
+// set kernel arguments for one mask and return the launches of a variant,
+// an empty list if the variant cannot run on the device
+static vector<Pass> setup_passes (cl_device_id device, cl_command_queue queue, const BenchVariant& variant, const VariantProgram& program,
+                                  SizeBuffers* buffers, cl_int width, cl_int height, const cl_int* k)
+{
+    vector<Pass> passes;
+
+    // mask dimensions and the reciprocal of the mask size (direct kernels)
+    cl_int params[MASK_PARAMS];
+    mask_params(k, params);
+
+    if (clEnqueueWriteBuffer(queue, buffers->k, CL_TRUE, 0, sizeof(params), params, 0, NULL, NULL) != CL_SUCCESS)
+        return passes;
+
+    if (variant.engine == ENGINE_DIRECT)
+    {
+        cl_int blockSize[2] = {variant.block, variant.block};
+
+        if (variant.block == 0)
+        {
+            blockSize[0] = vector_width(device);
+            blockSize[1] = 1;
+        }
+
+        Pass pass;
+        pass.kernel = program.kernels[0];
+        pass.dims = 2;
+        pass.global[0] = (width + blockSize[0] - 1) / blockSize[0];
+        pass.global[1] = (height + blockSize[1] - 1) / blockSize[1];
+        pass.fixedLocal = true;
+        fit_local(pass.global, program.groupSizes[0], pass.local);
+
+        // whole work groups - the kernels skip work items outside of the image
+        pass.global[0] = round_up(pass.global[0], pass.local[0]);
+        pass.global[1] = round_up(pass.global[1], pass.local[1]);
+
+        // tile plus halo for boxblur_blocking_local.cl, unused by the other kernels
+        size_t localmem = (k[0] + pass.local[0] + k[2]) * (k[1] + pass.local[1] + k[3]) * sizeof(cl_int);
+
+        cl_ulong maxLocalmem = 0;
+        clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &maxLocalmem, NULL);
+
+        if (localmem > maxLocalmem)
+            return passes;
+
+        if (clEnqueueWriteBuffer(queue, buffers->blockSize, CL_TRUE, 0, 2 * sizeof(cl_int), blockSize, 0, NULL, NULL) != CL_SUCCESS)
+            return passes;
+
+        clSetKernelArg(pass.kernel, 0, sizeof(cl_mem), (void*) &buffers->image);
+        clSetKernelArg(pass.kernel, 1, sizeof(cl_mem), (void*) &buffers->imageSize);
+        clSetKernelArg(pass.kernel, 2, sizeof(cl_mem), (void*) &buffers->k);
+        clSetKernelArg(pass.kernel, 3, sizeof(cl_mem), (void*) &buffers->blockSize);
+        clSetKernelArg(pass.kernel, 4, localmem, NULL);
+        clSetKernelArg(pass.kernel, 5, sizeof(cl_mem), (void*) &buffers->output);
+
+        passes.push_back(pass);
+    }
+    else if (variant.engine == ENGINE_SAT)
+    {
+        // one work group scans one row, so the scan width is limited by the kernel's work group size
+        size_t scanSize = SCAN_LOCAL_SIZE;
+        while (scanSize > program.groupSizes[0])
+            scanSize /= 2;
+
+        Pass rows = {program.kernels[0], 2, {scanSize, (size_t) height}, {scanSize, 1}, true};
+        Pass cols = {program.kernels[1], 1, {(size_t) width + 1, 1}, {1, 1}, false};
+        Pass blur = {program.kernels[2], 2, {(size_t) width, (size_t) height}, {1, 1}, false};
+
+        clSetKernelArg(rows.kernel, 0, sizeof(cl_mem), (void*) &buffers->image);
+        clSetKernelArg(rows.kernel, 1, sizeof(cl_mem), (void*) &buffers->imageSize);
+        clSetKernelArg(rows.kernel, 2, scanSize * sizeof(cl_uint), NULL);
+        clSetKernelArg(rows.kernel, 3, sizeof(cl_mem), (void*) &buffers->scratch);
+
+        clSetKernelArg(cols.kernel, 0, sizeof(cl_mem), (void*) &buffers->imageSize);
+        clSetKernelArg(cols.kernel, 1, sizeof(cl_mem), (void*) &buffers->scratch);
+
+        clSetKernelArg(blur.kernel, 0, sizeof(cl_mem), (void*) &buffers->scratch);
+        clSetKernelArg(blur.kernel, 1, sizeof(cl_mem), (void*) &buffers->imageSize);
+        clSetKernelArg(blur.kernel, 2, sizeof(cl_mem), (void*) &buffers->k);
+        clSetKernelArg(blur.kernel, 3, sizeof(cl_mem), (void*) &buffers->output);
+
+        passes.push_back(rows);
+        passes.push_back(cols);
+        passes.push_back(blur);
+    }
+    else if (variant.engine == ENGINE_SEPARABLE)
+    {
+        Pass rows = {program.kernels[0], 1, {(size_t) height, 1}, {1, 1}, false};
+        Pass cols = {program.kernels[1], 1, {(size_t) width, 1}, {1, 1}, false};
+
+        for (int i = 0; i < 2; i++)
+        {
+            cl_kernel kernel = i == 0 ? rows.kernel : cols.kernel;
+            cl_mem in = i == 0 ? buffers->image : buffers->scratch;
+            cl_mem out = i == 0 ? buffers->scratch : buffers->output;
+
+            clSetKernelArg(kernel, 0, sizeof(cl_mem), (void*) &in);
+            clSetKernelArg(kernel, 1, sizeof(cl_mem), (void*) &buffers->imageSize);
+            clSetKernelArg(kernel, 2, sizeof(cl_mem), (void*) &buffers->k);
+            clSetKernelArg(kernel, 3, sizeof(cl_mem), (void*) &out);
+        }
+
+        passes.push_back(rows);
+        passes.push_back(cols);
+    }
+
+    return passes;
+}
+
+
+// launch all passes of a variant, add the time from start of the first
+// to end of the last pass to times (if not NULL)
+static bool run_passes (cl_command_queue queue, const vector<Pass>& passes, vector<double>* times)
+{
+    vector<cl_event> events(passes.size());
+
+    for (size_t i = 0; i < passes.size(); i++)
+    {
+        const Pass& pass = passes[i];
+
+        cl_int ret = clEnqueueNDRangeKernel(queue, pass.kernel, pass.dims, NULL, pass.global,
+                                            pass.fixedLocal ? pass.local : NULL, 0, NULL, &events[i]);
+        if (ret != CL_SUCCESS)
+        {
+            cout << "clEnqueueNDRangeKernel: " << ret << "\n";
+
+            for (size_t j = 0; j < i; j++)
+                clReleaseEvent(events[j]);
+
+            return false;
+        }
+    }
+
+    bool success = clWaitForEvents(1, &events.back()) == CL_SUCCESS;
+
+    if (success && times)
+    {
+        cl_ulong start, end;
+        clGetEventProfilingInfo(events.front(), CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start, NULL);
+        clGetEventProfilingInfo(events.back(), CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, NULL);
+
+        times->push_back((end - start) * 1e-6);
+    }
+
+    for (size_t i = 0; i < events.size(); i++)
+        clReleaseEvent(events[i]);
+
+    return success;
+}
+
+
+// value below which the given fraction of sorted times lies
+static double percentile (const vector<double>& sorted, double fraction)
+{
+    size_t index = (size_t) ceil(fraction * sorted.size());
+
+    return sorted[index > 0 ? index - 1 : 0];
+}
+
+
+// warm up, verify and time one variant for one image size and mask
+static void measure (cl_command_queue queue, const vector<Pass>& passes, const SizeBuffers& buffers,
+                     const cl_int* reference, cl_int width, cl_int height, int repeats, BenchResult* result)
+{
+    size_t pixels = (size_t) width * height;
+
+    for (int i = 0; i < BENCH_WARMUP; i++)
+    {
+        if (!run_passes(queue, passes, NULL))
+        {
+            result->status = "failed";
+            return;
+        }
+    }
+
+    vector<cl_int> blurred(pixels);
+
+    if (clEnqueueReadBuffer(queue, buffers.output, CL_TRUE, 0, pixels * sizeof(cl_int), blurred.data(), 0, NULL, NULL) != CL_SUCCESS)
+    {
+        result->status = "failed";
+        return;
+    }
+
+    if (!equal(blurred.begin(), blurred.end(), reference))
+    {
+        result->status = "MISMATCH";
+        return;
+    }
+
+    vector<double> times;
+
+    for (int i = 0; i < repeats; i++)
+    {
+        if (!run_passes(queue, passes, &times))
+        {
+            result->status = "failed";
+            return;
+        }
+    }
+
+    sort(times.begin(), times.end());
+
+    result->median = percentile(times, 0.5);
+    result->p95 = percentile(times, 0.95);
+    result->status = "ok";
+}
+
+
+// megapixels per second for a time in ms
+static double throughput (cl_int width, cl_int height, double milliseconds)
+{
+    return milliseconds > 0 ? (double) width * height / (milliseconds * 1e3) : 0;
+}
+
+
+static void print_result (const BenchResult& result)
+{
+    ostringstream mask;
+    mask << result.k[0] << "," << result.k[1] << "," << result.k[2] << "," << result.k[3];
+
+    ostringstream size;
+    size << result.width << "x" << result.height;
+
+    cout << left << setw(16) << result.variant << setw(13) << size.str() << setw(13) << mask.str() << right;
+
+    if (result.median >= 0)
+        cout << fixed << setprecision(3)
+             << setw(12) << result.median << setw(12) << result.p95
+             << setw(12) << throughput(result.width, result.height, result.median)
+             << setw(12) << throughput(result.width, result.height, result.p95);
+    else
+        cout << setw(48) << "";
+
+    cout << "  " << result.status << "\n";
+}
+
+
+static bool write_report (const char* path, const vector<BenchResult>& results)
+{
+    ofstream file(path);
+
+    file << "variant,width,height,left,up,right,down,median_ms,p95_ms,median_mpix_s,p95_mpix_s,status\n";
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult& r = results[i];
+
+        file << r.variant << "," << r.width << "," << r.height << ","
+             << r.k[0] << "," << r.k[1] << "," << r.k[2] << "," << r.k[3] << ",";
+
+        if (r.median >= 0)
+            file << r.median << "," << r.p95 << ","
+                 << throughput(r.width, r.height, r.median) << "," << throughput(r.width, r.height, r.p95);
+        else
+            file << ",,,";
+
+        file << "," << r.status << "\n";
+    }
+
+    return file.good();
+}
+
+
+int main (int argc, char** argv)
+{
+    cl_int maxSize = argc > 1 ? atoi(argv[1]) : BENCH_MAX_SIZE;
+    int repeats = argc > 2 ? atoi(argv[2]) : BENCH_REPEATS;
+
+    if (maxSize <= 0 || repeats <= 0)
+    {
+        cout << "usage: " << argv[0] << " [maxSize [repeats]]\n";
+        return 1;
+    }
+
+    cl_int ret;
+    cl_platform_id platform_id;
+    cl_device_id device_id;
+
+    if (!find_device(&platform_id, &device_id))
+    {
+        cout << "No openCL device found\n";
+        return 1;
+    }
+
+    char deviceName[256] = "";
+    clGetDeviceInfo(device_id, CL_DEVICE_NAME, sizeof(deviceName), deviceName, NULL);
+
+    cl_ulong maxAlloc = 0, globalMem = 0;
+    clGetDeviceInfo(device_id, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(cl_ulong), &maxAlloc, NULL);
+    clGetDeviceInfo(device_id, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(cl_ulong), &globalMem, NULL);
+
+    cl_context context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &ret);
+    if (ret != CL_SUCCESS)
+    {
+        cout << "clCreateContext: " << ret << "\n";
+        return 1;
+    }
+
+    cl_command_queue queue = clCreateCommandQueue(context, device_id, CL_QUEUE_PROFILING_ENABLE, &ret);
+    if (ret != CL_SUCCESS)
+    {
+        cout << "clCreateCommandQueue: " << ret << "\n";
+        clReleaseContext(context);
+        return 1;
+    }
+
+    cout << "Device: " << deviceName << "\n"
+         << BENCH_WARMUP << " warmup and " << repeats << " timed launches per measurement\n\n";
+
+    // build all variants once
+    VariantProgram programs[NUM_VARIANTS];
+    bool built[NUM_VARIANTS];
+
+    for (size_t v = 0; v < NUM_VARIANTS; v++)
+        built[v] = build_variant(context, device_id, benchVariants[v], &programs[v]);
+
+    cout << left << setw(16) << "variant" << setw(13) << "size" << setw(13) << "mask" << right
+         << setw(12) << "median ms" << setw(12) << "p95 ms" << setw(12) << "median MP/s" << setw(12) << "p95 MP/s" << "\n";
+
+    vector<BenchResult> results;
+    bool success = true;
+
+    srand(1); // same images in every run
+
+    for (size_t s = 0; s < NUM_SIZES && benchSizes[s] <= maxSize; s++)
+    {
+        cl_int width = benchSizes[s];
+        cl_int height = benchSizes[s];
+        size_t pixels = (size_t) width * height;
+
+        // image, output and summed-area table have to fit into device memory
+        size_t tableBytes = (size_t) (width + 1) * (height + 1) * sizeof(cl_uint);
+
+        if (tableBytes > maxAlloc || 2 * pixels * sizeof(cl_int) + tableBytes > globalMem)
+        {
+            cout << width << "x" << height << ": skipped (not enough device memory)\n";
+            continue;
+        }
+
+        vector<cl_int> image(pixels);
+        vector<cl_int> reference(pixels);
+
+        for (size_t i = 0; i < pixels; i++)
+            image[i] = rand() % 256;
+
+        SizeBuffers buffers = {NULL, NULL, NULL, NULL, NULL, NULL};
+
+        if (!create_buffers(context, queue, image.data(), width, height, &buffers))
+        {
+            cout << width << "x" << height << ": skipped (buffer allocation failed)\n";
+            release_buffers(&buffers);
+            continue;
+        }
+
+        for (size_t m = 0; m < NUM_MASKS; m++)
+        {
+            const cl_int* k = benchMasks[m];
+            unsigned long long masksize = (unsigned long long) (k[0] + 1 + k[2]) * (k[1] + 1 + k[3]);
+
+            cpu_boxblur(image.data(), reference.data(), width, height, k, 0);
+
+            for (size_t v = 0; v < NUM_VARIANTS; v++)
+            {
+                const BenchVariant& variant = benchVariants[v];
+
+                BenchResult result;
+                result.variant = variant.name;
+                result.width = width;
+                result.height = height;
+                copy(k, k + 4, result.k);
+                result.median = -1;
+                result.p95 = -1;
+
+                vector<Pass> passes;
+
+                if (!built[v])
+                    result.status = "build failed";
+                else if (variant.engine == ENGINE_DIRECT && pixels * masksize > BENCH_MAX_TAPS)
+                    result.status = "skipped";
+                else if ((passes = setup_passes(device_id, queue, variant, programs[v], &buffers, width, height, k)).empty())
+                    result.status = "unsupported";
+                else
+                    measure(queue, passes, buffers, reference.data(), width, height, repeats, &result);
+
+                if (result.status == string("failed") || result.status == string("MISMATCH") || !built[v])
+                    success = false;
+
+                print_result(result);
+                results.push_back(result);
+            }
+        }
+
+        release_buffers(&buffers);
+    }
+
+    if (!write_report(BENCH_REPORT, results))
+        cout << "Cannot write " << BENCH_REPORT << "\n";
+    else
+        cout << "\nReport written to " << BENCH_REPORT << "\n";
+
+    for (size_t v = 0; v < NUM_VARIANTS; v++)
+        release_variant(&programs[v]);
+
+    clReleaseCommandQueue(queue);
+    clReleaseContext(context);
+
+    return success ? 0 : 1;
+}
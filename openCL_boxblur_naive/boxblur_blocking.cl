@@ -1,32 +1,68 @@
 // An openCL kernel implementation of a box blur filter.
 
 // Takes an intensity image represented by width * height
-// integer values. Then, it applies a box blur to the image and writes it
+// PIXEL values. Then, it applies a box blur to the image and writes it
 // to the output buffer.
 
 // Uses blocking optimization to achieve better performance as opposed to
 // a naive implementation where the number of work items is equal to
 // the number of pixels in the image.
 
-__kernel void boxblur (__read_only __global int* image,
-							 __read_only __global int* imageSize,
-                             __read_only __global int* k,
-							 __read_only __global int* blockSize,
-							 __read_write __local int* localmem, // not needed but kept so host code can stay unchanged
-                             __write_only __global int* output)
+// Rows are IMAGE_PITCH values apart (see boxblur_naive.cl). Blocks at the
+// right and bottom edge may reach beyond the image - those pixels are skipped.
+
+// compile-time kernel parameters of specialized variants (see boxblur_naive.cl)
+#ifndef IMAGE_WIDTH
+#define IMAGE_WIDTH imageSize[0]
+#endif
+#ifndef IMAGE_HEIGHT
+#define IMAGE_HEIGHT imageSize[1]
+#endif
+#ifndef IMAGE_PITCH
+#define IMAGE_PITCH imageSize[2]
+#endif
+#ifndef MASK_SIZE_LEFT
+#define MASK_SIZE_LEFT k[0]
+#endif
+#ifndef MASK_SIZE_UP
+#define MASK_SIZE_UP k[1]
+#endif
+#ifndef MASK_SIZE_RIGHT
+#define MASK_SIZE_RIGHT k[2]
+#endif
+#ifndef MASK_SIZE_DOWN
+#define MASK_SIZE_DOWN k[3]
+#endif
+#ifndef BLOCK_WIDTH
+#define BLOCK_WIDTH blockSize[0]
+#endif
+#ifndef BLOCK_HEIGHT
+#define BLOCK_HEIGHT blockSize[1]
+#endif
+
+// pixel and sum types, loads, stores and division-free normalization
+#include "pixel_types.clh"
+
+
+__kernel void boxblur (__global PIXEL* image,
+							 __global int* imageSize,
+                             __global int* k,
+							 __global int* blockSize,
+							 __local SUM* localmem, // not needed but kept so host code can stay unchanged
+                             __global PIXEL* output)
 {
 	// extract mask dimensions for easier use
-	int left = k[0];
-	int up = k[1];
-	int right = k[2];
-	int down = k[3];
+	int left = MASK_SIZE_LEFT;
+	int up = MASK_SIZE_UP;
+	int right = MASK_SIZE_RIGHT;
+	int down = MASK_SIZE_DOWN;
 
-    int blockX = get_global_id(0) * blockSize[0]; // x position of first element in block (internal block coordinates (0,0))
-	int blockY = get_global_id(1) * blockSize[1]; // y position of first element in block
+    int blockX = get_global_id(0) * BLOCK_WIDTH; // x position of first element in block (internal block coordinates (0,0))
+	int blockY = get_global_id(1) * BLOCK_HEIGHT; // y position of first element in block
 
 	// get block sizes
-	int blockWidth = blockSize[0];
-	int blockHeight = blockSize[1];
+	int blockWidth = BLOCK_WIDTH;
+	int blockHeight = BLOCK_HEIGHT;
 
 	// calculate all positions in block
 	for (int i = 0; i < blockHeight; i++)
@@ -37,30 +73,33 @@ __kernel void boxblur (__read_only __global int* image,
 			int col = blockX + j;
 			int row = blockY + i;
 
+			// block or work item beyond the edge of the image
+			if (col >= IMAGE_WIDTH || row >= IMAGE_HEIGHT)
+				continue;
+
 			// get sum of all elements inside the mask
 			// centered at (col, row)
-			int sum = 0;
-			int val;
+			SUM sum = 0;
+			SUM val;
 
 			for(int c_row = row - up; c_row <= row + down; c_row++)
 				for(int c_col = col - left; c_col <= col + right; c_col++)
 				{
 					// check if value is out of bounds - if yes, use neutral element 0
 					val = c_row < 0 ||
-					       c_row >= imageSize[1] ||
+					       c_row >= IMAGE_HEIGHT ||
 						   c_col < 0 ||
-						   c_col >= imageSize[0] ?
-						   0 : image[c_col + (c_row * imageSize[0])];
+						   c_col >= IMAGE_WIDTH ?
+						   0 : LOAD(image, c_col + (c_row * IMAGE_PITCH));
 
 					sum += val; // sum neighbors
 				}
 
 			// divide by size of mask
-			int masksize = (left + 1 + right) * (up + 1 + down); // +1 because of "middle" element
-			int pixelValue = sum / masksize;
+			SUM pixelValue = NORMALIZE(sum);
 
 			// write new pixel intensity value to output image
-			output[col + (row * imageSize[0])] = pixelValue;
+			STORE(output, col + (row * IMAGE_PITCH), pixelValue);
 		}
 	}
 }
@@ -1,7 +1,7 @@
 // An openCL kernel implementation of a box blur filter.
 
 // Takes an intensity image represented by width * height
-// integer values. Then, it applies a box blur to the image and writes it
+// PIXEL values. Then, it applies a box blur to the image and writes it
 // to the output buffer.
 
 // Uses blocking optimization to achieve better performance as opposed to
@@ -10,212 +10,140 @@
 
 // Uses local GPU memory to compute values more efficiently within work groups.
 
-__kernel void boxblur (__read_only __global int* image,
-							 __read_only __global int* imageSize,
-                             __read_only __global int* k,
-							 __read_only __global int* blockSize,
-							 __read_write __local int* localmem,
-                             __write_only __global int* output)
+// A work group covers (local size X * block width) * (local size Y * block height)
+// pixels. It processes them tile by tile, where one tile has the size of the work
+// group (one pixel per work item). For every tile, all work items together copy the
+// tile plus its mask halo, (left + local size X + right) * (up + local size Y + down)
+// values, into local memory. Consecutive work items load consecutive addresses, so
+// the loads are coalesced and there are no special cases for corners or edges. The
+// mask sums are then computed from local memory only.
+
+// Rows are IMAGE_PITCH values apart (see boxblur_naive.cl). Tiles reaching
+// beyond the image load zeros there and do not write those pixels - all work
+// items stay in the loops, since every one of them has to reach the barriers.
+
+// compile-time kernel parameters of specialized variants (see boxblur_naive.cl)
+#ifndef IMAGE_WIDTH
+#define IMAGE_WIDTH imageSize[0]
+#endif
+#ifndef IMAGE_HEIGHT
+#define IMAGE_HEIGHT imageSize[1]
+#endif
+#ifndef IMAGE_PITCH
+#define IMAGE_PITCH imageSize[2]
+#endif
+#ifndef MASK_SIZE_LEFT
+#define MASK_SIZE_LEFT k[0]
+#endif
+#ifndef MASK_SIZE_UP
+#define MASK_SIZE_UP k[1]
+#endif
+#ifndef MASK_SIZE_RIGHT
+#define MASK_SIZE_RIGHT k[2]
+#endif
+#ifndef MASK_SIZE_DOWN
+#define MASK_SIZE_DOWN k[3]
+#endif
+#ifndef BLOCK_WIDTH
+#define BLOCK_WIDTH blockSize[0]
+#endif
+#ifndef BLOCK_HEIGHT
+#define BLOCK_HEIGHT blockSize[1]
+#endif
+
+// pixel and sum types, loads, stores and division-free normalization
+#include "pixel_types.clh"
+
+
+__kernel void boxblur (__global PIXEL* image,
+							 __global int* imageSize,
+                             __global int* k,
+							 __global int* blockSize,
+							 __local SUM* localmem, // tile plus halo, converted to SUM
+                             __global PIXEL* output)
 {
 	// extract mask dimensions for easier use
-	int left = k[0];
-	int up = k[1];
-	int right = k[2];
-	int down = k[3];
-
-    int blockX = get_global_id(0) * blockSize[0]; // x position of first element in block (internal block coordinates (0,0))
-	int blockY = get_global_id(1) * blockSize[1]; // y position of first element in block
+	int left = MASK_SIZE_LEFT;
+	int up = MASK_SIZE_UP;
+	int right = MASK_SIZE_RIGHT;
+	int down = MASK_SIZE_DOWN;
 
 	// get block sizes
-	int blockWidth = blockSize[0];
-	int blockHeight = blockSize[1];
-
-
-	// calculate all positions in block
-	for (int i = 0; i < blockHeight; i++)
-	{
-		for (int j = 0; j < blockWidth; j++)
-		{
-			// find position of global matrix entry to calculate
-			int col = blockX + j;
-			int row = blockY + i;
-
-			// copy current value into local memory
-			// (notice: "offset" needed because local memory size
-			// is equal to work group size extended by mask size)
-			localmem[(left + get_local_id(0)) + ((up + (get_local_id(1)) * (left + get_local_size(0) + right)))] = image[col + (row * imageSize[0])];
-
-			// if current value is on a work group border,
-			// load missing neighbor values into local memory (non-overlapping!)
-			int val;
-			int localpos;
-
-			// top left value in work group
-			if(get_global_id(0) == 0 &&
-			   get_global_id(1) == 0)
-			{
-				output[col + (row * imageSize[0])] = 1; // DEBUG - why are all values in block filled with this value? same below
-
-
-				/*for(int y = get_global_id(1) - up; y < get_global_id(1); y++)
-					for(int x = get_global_id(0) - left; x < get_global_id(0); x++)
-					{
-						// use neutral element if position is OOB in input image
-						val = y < 0 || x < 0 || y >= imageSize[1] || x >= imageSize[0] ? 0 : image[x + (y * imageSize[0])];
+	int blockWidth = BLOCK_WIDTH;
+	int blockHeight = BLOCK_HEIGHT;
 
-						// calculate position in local memory
-						localpos = (left + x) + ((up + y) * (left + get_local_size(0) + right));
+	int width = IMAGE_WIDTH;
+	int height = IMAGE_HEIGHT;
+	int pitch = IMAGE_PITCH;
 
-						// copy neighbor values from global to local memory
-						localmem[localpos] = val;
-					}*/
-			}
+	// position of this work item in its work group
+	int localX = get_local_id(0);
+	int localY = get_local_id(1);
+	int localWidth = get_local_size(0);
+	int localHeight = get_local_size(1);
 
-			// top right
-			else if(get_local_id(0) == get_local_size(0) - 1 &&
-			        get_local_id(1) == 0)
-			{
-				output[col + (row * imageSize[0])] = 2;
-				/*for(int y = get_global_id(1) - up; y < get_global_id(1); y++)
-					for(int x = get_global_id(0) + 1; x <= get_global_id(0) + right; x++)
-					{
-						val = y < 0 || x < 0 || y >= imageSize[1] || x >= imageSize[0] ? 0 : image[x + (y * imageSize[0])];
-						localpos = (left + x) + ((up + y) * (left + get_local_size(0) + right));
-						localmem[localpos] = val;
-					}*/
-			}
-
-			// bottom left
-			else if (get_local_id(0) == 0 &&
-			         get_local_id(1) == get_local_size(1) - 1)
-			{
-				output[col + (row * imageSize[0])] = 3;
-				/*for(int y = get_global_id(1) + 1; y <= get_global_id(1) + down; y++)
-					for(int x = get_global_id(0) - left; x < get_global_id(0); x++)
-					{
-						val = y < 0 || x < 0 || y >= imageSize[1] || x >= imageSize[0] ? 0 : image[x + (y * imageSize[0])];
-						localpos = (left + x) + ((up + y) * (left + get_local_size(0) + right));
-						localmem[localpos] = val;
-					}*/
-			}
+	int localIndex = localX + localY * localWidth; // flattened work item index
+	int groupSize = localWidth * localHeight;
 
-			// bottom right
-			else if (get_local_id(0) == get_local_size(0) - 1 &&
-			         get_local_id(1) == get_local_size(1) - 1)
-			{
-				output[col + (row * imageSize[0])] = 4;
-				/*for(int y = get_global_id(1) + 1; y <= get_global_id(1) + down; y++)
-					for(int x = get_global_id(0) + 1; x <= get_global_id(0) + right; x++)
-					{
-						val = y < 0 || x < 0 || y >= imageSize[1] || x >= imageSize[0] ? 0 : image[x + (y * imageSize[0])];
-						localpos = (left + x) + ((up + y) * (left + get_local_size(0) + right));
-						localmem[localpos] = val;
-					}*/
-			}
+	// size of tile in local memory including halo
+	int tileWidth = left + localWidth + right;
+	int tileHeight = up + localHeight + down;
+	int tileSize = tileWidth * tileHeight;
 
-			// upper border
-			else if (get_local_id(1) == 0)
-			{
-				output[col + (row * imageSize[0])] = 5;
-				/*for(int y = get_global_id(1) - up; y < get_global_id(1); y++)
-					for(int x = get_global_id(0) - left; x <= get_global_id(0) + right; x++) // ADD EXPLICIT CHECK HERE SO NO OVERLAP OCCURS
-					{
-						val = y < 0 || x < 0 || y >= imageSize[1] || x >= imageSize[0] ? 0 : image[x + (y * imageSize[0])];
-						localpos = (left + x) + ((up + y) * (left + get_local_size(0) + right));
-						localmem[localpos] = val;
-					}*/
-			}
-
-			// right border
-			else if (get_local_id(0) == get_local_size(0) - 1)
-			{
-				output[col + (row * imageSize[0])] = 6;
-				/*for(int y = get_global_id(1) - up; y < get_global_id(1); y++)
-					for(int x = get_global_id(0) + 1; x <= get_global_id(0) + right; x++) // ADD EXPLICIT CHECK HERE SO NO OVERLAP OCCURS
-					{
-						val = y < 0 || x < 0 || y >= imageSize[1] || x >= imageSize[0] ? 0 : image[x + (y * imageSize[0])];
-						localpos = (left + x) + ((up + y) * (left + get_local_size(0) + right));
-						localmem[localpos] = val;
-					}*/
-			}
-
-			// lower border
-			else if (get_local_id(1) == get_local_size(1) - 1)
-			{
-				output[col + (row * imageSize[0])] = 7;
-				/*for(int y = get_global_id(1) + 1; y <= get_global_id(1) + down; y++)
-					for(int x = get_global_id(0) - left; x <= get_global_id(0) + right; x++) // ADD EXPLICIT CHECK HERE SO NO OVERLAP OCCURS
-					{
-						val = y < 0 || x < 0 || y >= imageSize[1] || x >= imageSize[0] ? 0 : image[x + (y * imageSize[0])];
-						localpos = (left + x) + ((up + y) * (left + get_local_size(0) + right));
-						localmem[localpos] = val;
-					}*/
-			}
-
-			// left border
-			else if (get_local_id(0) == 0)
-			{
-				output[col + (row * imageSize[0])] = 8;
-				/*for(int y = get_global_id(1) - up; y <= get_global_id(1) + down; y++)
-					for(int x = get_global_id(0) - left; x < get_global_id(0); x++) // ADD EXPLICIT CHECK HERE SO NO OVERLAP OCCURS
-					{
-						val = y < 0 || x < 0 || y >= imageSize[1] || x >= imageSize[0] ? 0 : image[x + (y * imageSize[0])];
-						localpos = (left + x) + ((up + y) * (left + get_local_size(0) + right));
-						localmem[localpos] = val;
-					}*/
-			}
+	// position of first pixel covered by this work group
+	int regionX = get_group_id(0) * localWidth * blockWidth;
+	int regionY = get_group_id(1) * localHeight * blockHeight;
 
+	// calculate all tiles in block
+	for (int i = 0; i < blockHeight; i++)
+	{
+		for (int j = 0; j < blockWidth; j++)
+		{
+			// position of first pixel in current tile (without halo)
+			int tileX = regionX + j * localWidth;
+			int tileY = regionY + i * localHeight;
 
-			// Normal case - value is not a border value.
-			else
+			// copy tile plus halo into local memory - every work item
+			// loads every groupSize-th value of the tile
+			for (int index = localIndex; index < tileSize; index += groupSize)
 			{
-				// nothing else to do
+				int x = tileX - left + index % tileWidth;
+				int y = tileY - up + index / tileWidth;
+
+				// use neutral element 0 if position is out of bounds
+				localmem[index] = x < 0 ||
+				                  x >= width ||
+				                  y < 0 ||
+				                  y >= height ?
+				                  0 : LOAD(image, x + y * pitch);
 			}
 
 			// only when all work items have arrived here,
 			// computation continues - otherwise, not all needed
 			// values might be available in local memory
-			barrier (CLK_LOCAL_MEM_FENCE);
-
-
-			// check out-of-bounds conditions
-			// and resize mask if needed
-			/*if (col - left < 0)
-				left = left + (col - left);
+			barrier(CLK_LOCAL_MEM_FENCE);
 
-			if (row - up < 0)
-				up = up + (row - up);
+			// get sum of all elements inside the mask - the mask
+			// centered at (localX, localY) starts at (localX, localY)
+			// in local memory because of the halo offset
+			SUM sum = 0;
 
-			if (col + right >= imageSize[0])
-				right = right - (col + right - imageSize[0]) - 1;
+			for (int c_row = localY; c_row <= localY + up + down; c_row++)
+				for (int c_col = localX; c_col <= localX + left + right; c_col++)
+					sum += localmem[c_col + c_row * tileWidth]; // sum neighbors using local memory
 
-			if (row + down >= imageSize[1])
-				down = down - (row + down - imageSize[1]) - 1;*/
+			// divide by size of mask (left + 1 + right) * (up + 1 + down)
+			SUM pixelValue = NORMALIZE(sum);
 
-			// get sum of all elements inside the mask
-			// centered at (col, row)
-			int sum = 0;
-			int val2;
-
-			for(int c_row = row; c_row <= up + row + down; c_row++)
-				for(int c_col = col; c_col <= left + col + right; c_col++)
-				{
-					// check if value is out of bounds - if yes, use neutral element 0
-					val2 = c_row < 0 ||
-					       c_row >= up + get_local_size(1) + down ||
-						   c_col < 0 ||
-						   c_col >= left + get_local_size(0) + right ?
-						   0 : localmem[c_col + c_row * (left + get_local_size(0) + right)];
-
-					sum += val2; // sum neighbors using local memory
-				}
+			// write new pixel intensity value to output image
+			int col = tileX + localX;
+			int row = tileY + localY;
 
-			// divide by size of mask
-			int masksize = (left + 1 + right) * (up + 1 + down); // +1 because of "middle" element
-			int pixelValue = sum / masksize;
+			if (col < width && row < height)
+				STORE(output, col + row * pitch, pixelValue);
 
-			// write new pixel intensity value to output image
-			//output[col + (row * imageSize[0])] = localmem[(left + get_local_id(0)) + ((up + (get_local_id(1)) * (left + get_local_size(0) + right)))];
+			// local memory is overwritten by the next tile
+			barrier(CLK_LOCAL_MEM_FENCE);
 		}
 	}
 }
@@ -0,0 +1,177 @@
+// An openCL kernel implementation of a box blur filter
+// with selectable border handling.
+
+// Takes an intensity image represented by width * height
+// integer values. The image is split into an interior region, where the
+// whole mask lies inside of the image, and the border bands around it:
+
+// 1. boxblur        - interior pixels, no bounds checks at all
+// 2. boxblur_border - border pixels, every mask position is mapped
+//                     into the image according to BORDER_MODE
+
+// For large images nearly all pixels are interior, so the hot path
+// reads its mask without a single branch. The border kernel only covers
+// (up + down) * width + (left + right) * height pixels.
+
+// Build with -DBORDER_MODE=<mode> (same values as in cpu_boxblur.hpp).
+#define BORDER_ZERO 0 // values outside of the image are 0 (like the other kernels)
+#define BORDER_CLAMP 1 // nearest edge value
+#define BORDER_MIRROR 2 // reflection at the edge, edge value not repeated (-1 -> 1)
+#define BORDER_WRAP 3 // periodic continuation (-1 -> width - 1)
+
+#ifndef BORDER_MODE
+#define BORDER_MODE BORDER_ZERO
+#endif
+
+// compile-time kernel parameters of specialized variants (see boxblur_naive.cl)
+#ifndef IMAGE_WIDTH
+#define IMAGE_WIDTH imageSize[0]
+#endif
+#ifndef IMAGE_HEIGHT
+#define IMAGE_HEIGHT imageSize[1]
+#endif
+#ifndef MASK_SIZE_LEFT
+#define MASK_SIZE_LEFT k[0]
+#endif
+#ifndef MASK_SIZE_UP
+#define MASK_SIZE_UP k[1]
+#endif
+#ifndef MASK_SIZE_RIGHT
+#define MASK_SIZE_RIGHT k[2]
+#endif
+#ifndef MASK_SIZE_DOWN
+#define MASK_SIZE_DOWN k[3]
+#endif
+
+
+// position inside of [0, n) that replaces position x (not used for BORDER_ZERO)
+int border_index (int x, int n)
+{
+#if BORDER_MODE == BORDER_CLAMP
+	return clamp(x, 0, n - 1);
+#elif BORDER_MODE == BORDER_MIRROR
+	if (n == 1)
+		return 0;
+
+	// reflections repeat with period 2 * (n - 1), masks may be larger than the image
+	int period = 2 * (n - 1);
+	x = (x < 0 ? -x : x) % period;
+
+	return x < n ? x : period - x;
+#elif BORDER_MODE == BORDER_WRAP
+	x %= n;
+
+	return x < 0 ? x + n : x;
+#else
+	return x;
+#endif
+}
+
+
+// Interior pixels. Launch with a 2D NDRange of
+// (width - left - right, height - up - down) and a global offset of (left, up).
+__kernel void boxblur (__global int* image,
+                       __global int* imageSize,
+                       __global int* k,
+                       __global int* output)
+{
+	// retrieve this work item's global work item id in x and y dimensions (includes offset)
+	int col = get_global_id(0);
+	int row = get_global_id(1);
+
+	// extract mask dimensions for
+	// easier use
+	int left = MASK_SIZE_LEFT;
+	int up = MASK_SIZE_UP;
+	int right = MASK_SIZE_RIGHT;
+	int down = MASK_SIZE_DOWN;
+
+	int width = IMAGE_WIDTH;
+
+	// get sum of all elements inside the mask
+	// centered at (col, row) - all of them are inside of the image
+	int sum = 0;
+
+	for (int c_row = row - up; c_row <= row + down; c_row++)
+	{
+		__global int* in = image + c_row * width;
+
+		for (int c_col = col - left; c_col <= col + right; c_col++)
+			sum += in[c_col];
+	}
+
+	// divide by size of mask
+	int masksize = (left + 1 + right) * (up + 1 + down); // +1 because of "middle" element
+
+	// write new pixel intensity value to output image
+	output[col + row * width] = sum / masksize;
+}
+
+
+// Border pixels. Launch with a 1D NDRange of
+// top * width + bottom * width + (height - top - bottom) * (leftCols + rightCols)
+// work items (see below). Work items are numbered through the upper band,
+// the lower band and then row by row through the left and right bands.
+__kernel void boxblur_border (__global int* image,
+                              __global int* imageSize,
+                              __global int* k,
+                              __global int* output)
+{
+	int index = get_global_id(0);
+
+	int left = MASK_SIZE_LEFT;
+	int up = MASK_SIZE_UP;
+	int right = MASK_SIZE_RIGHT;
+	int down = MASK_SIZE_DOWN;
+
+	int width = IMAGE_WIDTH;
+	int height = IMAGE_HEIGHT;
+
+	// band sizes - if the mask is larger than the image, the bands cover all of it
+	int top = min(up, height);
+	int bottom = min(down, height - top);
+	int leftCols = min(left, width);
+	int rightCols = min(right, width - leftCols);
+	int sideCols = leftCols + rightCols;
+
+	int col, row;
+
+	if (index < top * width)
+	{
+		row = index / width;
+		col = index % width;
+	}
+	else if (index < (top + bottom) * width)
+	{
+		index -= top * width;
+		row = height - bottom + index / width;
+		col = index % width;
+	}
+	else
+	{
+		index -= (top + bottom) * width;
+		row = top + index / sideCols;
+		col = index % sideCols;
+
+		if (col >= leftCols)
+			col += width - sideCols; // right band
+	}
+
+	int sum = 0;
+
+	for (int c_row = row - up; c_row <= row + down; c_row++)
+		for (int c_col = col - left; c_col <= col + right; c_col++)
+		{
+#if BORDER_MODE == BORDER_ZERO
+			// skip values out of bounds - same as adding neutral element 0
+			if (c_row >= 0 && c_row < height && c_col >= 0 && c_col < width)
+				sum += image[c_col + c_row * width];
+#else
+			sum += image[border_index(c_col, width) + border_index(c_row, height) * width];
+#endif
+		}
+
+	int masksize = (left + 1 + right) * (up + 1 + down);
+
+	output[col + row * width] = sum / masksize;
+}
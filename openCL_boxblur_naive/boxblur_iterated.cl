@@ -0,0 +1,144 @@
+// An openCL kernel implementation of several box blur passes
+// fused into one kernel launch.
+
+// Takes an intensity image represented by width * height integer
+// values and applies numPasses box blurs to it, pass p using the mask
+// k[4 * (firstPass + p)] .. k[4 * (firstPass + p) + 3] = {left, up, right, down}.
+// Repeated box blurs approximate a Gaussian blur.
+
+// Every work group computes a tile of local size X * local size Y output
+// pixels. It loads the tile plus a halo as wide as the sum of all fused
+// masks into local memory, then runs the passes between two local
+// buffers. Every pass shrinks the valid region by its own mask, so after
+// the last pass exactly the tile is left and no intermediate image is
+// written to global memory.
+
+// The result is identical to running the passes one by one: every pass
+// divides its sums (rounding down), and pixels outside of the image are
+// set to the neutral element 0 before the next pass reads them.
+
+// The host rounds the NDRange up to whole work groups and passes two local buffers of (haloLeft + local size X + haloRight)
+// * (haloUp + local size Y + haloDown) values each.
+
+
+__kernel void boxblur_fused (__global int* image,
+                             __global int* imageSize,
+                             __global int* k,
+                             int firstPass,
+                             int numPasses,
+                             __local int* tileA,
+                             __local int* tileB,
+                             __global int* output)
+{
+	int width = imageSize[0];
+	int height = imageSize[1];
+
+	// position of this work item in its work group
+	int localX = get_local_id(0);
+	int localY = get_local_id(1);
+	int localWidth = get_local_size(0);
+	int localHeight = get_local_size(1);
+
+	int localIndex = localX + localY * localWidth; // flattened work item index
+	int groupSize = localWidth * localHeight;
+
+	__global int* masks = k + 4 * firstPass;
+
+	// halo of all fused passes
+	int haloLeft = 0, haloUp = 0, haloRight = 0, haloDown = 0;
+
+	for (int p = 0; p < numPasses; p++)
+	{
+		haloLeft += masks[4 * p];
+		haloUp += masks[4 * p + 1];
+		haloRight += masks[4 * p + 2];
+		haloDown += masks[4 * p + 3];
+	}
+
+	// size of tile in local memory including halo
+	int tileWidth = haloLeft + localWidth + haloRight;
+	int tileHeight = haloUp + localHeight + haloDown;
+	int tileSize = tileWidth * tileHeight;
+
+	// image position of the first tile value
+	int originX = (int) get_group_id(0) * localWidth - haloLeft;
+	int originY = (int) get_group_id(1) * localHeight - haloUp;
+
+	// copy tile plus halo into local memory - every work item
+	// loads every groupSize-th value of the tile
+	for (int index = localIndex; index < tileSize; index += groupSize)
+	{
+		int x = originX + index % tileWidth;
+		int y = originY + index / tileWidth;
+
+		// use neutral element 0 if position is out of bounds
+		tileA[index] = x < 0 || x >= width || y < 0 || y >= height ? 0 : image[x + y * width];
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	__local int* src = tileA;
+	__local int* dst = tileB;
+
+	// region of src that holds valid values (tile coordinates, end exclusive)
+	int x0 = 0, x1 = tileWidth;
+	int y0 = 0, y1 = tileHeight;
+
+	for (int p = 0; p < numPasses; p++)
+	{
+		int left = masks[4 * p];
+		int up = masks[4 * p + 1];
+		int right = masks[4 * p + 2];
+		int down = masks[4 * p + 3];
+
+		// only values whose whole mask lies in the valid region can be computed
+		x0 += left;
+		x1 -= right;
+		y0 += up;
+		y1 -= down;
+
+		int masksize = (left + 1 + right) * (up + 1 + down); // +1 because of "middle" element
+		int regionWidth = x1 - x0;
+		int regionSize = regionWidth * (y1 - y0);
+
+		for (int index = localIndex; index < regionSize; index += groupSize)
+		{
+			int tx = x0 + index % regionWidth;
+			int ty = y0 + index / regionWidth;
+
+			int x = originX + tx;
+			int y = originY + ty;
+
+			// pixels outside of the image stay 0 for the next pass
+			int pixelValue = 0;
+
+			if (x >= 0 && x < width && y >= 0 && y < height)
+			{
+				int sum = 0;
+
+				for (int c_row = ty - up; c_row <= ty + down; c_row++)
+					for (int c_col = tx - left; c_col <= tx + right; c_col++)
+						sum += src[c_col + c_row * tileWidth];
+
+				pixelValue = sum / masksize;
+			}
+
+			dst[tx + ty * tileWidth] = pixelValue;
+		}
+
+		// next pass reads what all work items of this pass wrote
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		__local int* swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	// the valid region is now exactly the tile - work items of the
+	// rounded up NDRange outside of the image write nothing
+	int col = originX + haloLeft + localX;
+	int row = originY + haloUp + localY;
+
+	if (col < width && row < height)
+		output[col + row * width] = src[(haloLeft + localX) + (haloUp + localY) * tileWidth];
+}
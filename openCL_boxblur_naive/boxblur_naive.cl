@@ -1,29 +1,68 @@
 // An naive openCL kernel implementation of a box blur filter.
 
 // Takes an intensity image represented by width * height
-// integer values. Then, it applies a box blur to the image and writes it
+// PIXEL values. Then, it applies a box blur to the image and writes it
 // to the output buffer.
 
-__kernel void boxblur (__read_only __global int* image,
-							 __read_only __global int* imageSize,
-                             __read_only __global int* k,
-							 __read_only __global int* blockSize,
-							 __read_write __local int* localmem, // not needed but kept so host code can stay the same
-                             __write_only __global int* output)
+// Rows of input and output are IMAGE_PITCH >= width values apart, so
+// the host can pad them to start at aligned addresses. The NDRange is
+// rounded up to a multiple of the work group size - work items outside
+// of the image have nothing to do.
+
+// Kernel parameters are read from the argument buffers unless the host
+// passes them as build options (-D IMAGE_WIDTH=... etc.) to build a
+// specialized variant. Constants allow the compiler to unroll the mask
+// loops and fold the bounds checks - the buffers are not read then.
+#ifndef IMAGE_WIDTH
+#define IMAGE_WIDTH imageSize[0]
+#endif
+#ifndef IMAGE_HEIGHT
+#define IMAGE_HEIGHT imageSize[1]
+#endif
+#ifndef IMAGE_PITCH
+#define IMAGE_PITCH imageSize[2] // row pitch in values
+#endif
+#ifndef MASK_SIZE_LEFT
+#define MASK_SIZE_LEFT k[0]
+#endif
+#ifndef MASK_SIZE_UP
+#define MASK_SIZE_UP k[1]
+#endif
+#ifndef MASK_SIZE_RIGHT
+#define MASK_SIZE_RIGHT k[2]
+#endif
+#ifndef MASK_SIZE_DOWN
+#define MASK_SIZE_DOWN k[3]
+#endif
+
+// pixel and sum types, loads, stores and division-free normalization
+#include "pixel_types.clh"
+
+
+__kernel void boxblur (__global PIXEL* image,
+							 __global int* imageSize,
+                             __global int* k,
+							 __global int* blockSize,
+							 __local SUM* localmem, // not needed but kept so host code can stay the same
+                             __global PIXEL* output)
 {
 	// retrieve this work item's global work item id in x and y dimensions
     int col = get_global_id(0);
     int row = get_global_id(1);
 
+    // remainder work item of the rounded up NDRange
+    if (col >= IMAGE_WIDTH || row >= IMAGE_HEIGHT)
+        return;
+
     // extract mask dimensions for
     // easier use
-    int left = k[0];
-    int up = k[1];
-    int right = k[2];
-    int down = k[3];
+    int left = MASK_SIZE_LEFT;
+    int up = MASK_SIZE_UP;
+    int right = MASK_SIZE_RIGHT;
+    int down = MASK_SIZE_DOWN;
 
-	int sum = 0; // sum of all mask elements
-	int val;
+	SUM sum = 0; // sum of all mask elements
+	SUM val;
 
     // get sum of all elements inside the mask
     // centered at the (col, row)
@@ -32,18 +71,17 @@ __kernel void boxblur (__read_only __global int* image,
         {
 			// check if value is out of bounds - if yes, use neutral element 0
 			val = c_row < 0 ||
-				   c_row >= imageSize[1] ||
+				   c_row >= IMAGE_HEIGHT ||
 				   c_col < 0 ||
-				   c_col >= imageSize[0] ?
-				   0 : image[c_col + c_row * imageSize[0]];
+				   c_col >= IMAGE_WIDTH ?
+				   0 : LOAD(image, c_col + c_row * IMAGE_PITCH);
 
 			sum += val;
         }
 
-    // divide by size of mask
-	int masksize = (left + 1 + right) * (up + 1 + down); // +1 because of "middle" element
-	int pixelValue = sum / masksize;
+    // divide by size of mask (left + 1 + right) * (up + 1 + down) - +1 because of "middle" element
+	SUM pixelValue = NORMALIZE(sum);
 
     // write new pixel intensity value to output image
-    output[col + row * get_global_size(0)] = pixelValue;
+    STORE(output, col + row * IMAGE_PITCH, pixelValue);
 }
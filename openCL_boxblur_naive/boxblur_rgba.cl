@@ -0,0 +1,84 @@
+// An openCL kernel implementation of a box blur filter for 8 bit images.
+
+// Takes an image represented by width * height pixels with 8 bits per
+// channel - either RGBA (uchar4, kernel "boxblur") or grayscale (uchar,
+// kernel "boxblur_gray") - and applies a box blur to every channel in
+// one pass. Sums are accumulated in 32 bit integers, so no channel can
+// overflow for masks of up to 2^24 pixels.
+
+// Storing one byte per channel instead of one int per value cuts
+// transfer size and device memory by a factor of 4 compared to the
+// cl_int kernels. Border handling is the same: values outside of the
+// image use the neutral element 0.
+
+
+// RGBA image, one work item per pixel
+__kernel void boxblur (__global uchar4* image,
+                       __global int* imageSize,
+                       __global int* k,
+                       __global uchar4* output)
+{
+	// retrieve this work item's global work item id in x and y dimensions
+	int col = get_global_id(0);
+	int row = get_global_id(1);
+
+	// extract mask dimensions for
+	// easier use
+	int left = k[0];
+	int up = k[1];
+	int right = k[2];
+	int down = k[3];
+
+	int width = imageSize[0];
+	int height = imageSize[1];
+
+	uint4 sum = (uint4) (0); // sum of all mask elements per channel
+
+	// get sum of all elements inside the mask
+	// centered at (col, row)
+	for (int c_row = row - up; c_row <= row + down; c_row++)
+		for (int c_col = col - left; c_col <= col + right; c_col++)
+		{
+			// skip values out of bounds - same as adding neutral element 0
+			if (c_row >= 0 && c_row < height && c_col >= 0 && c_col < width)
+				sum += convert_uint4(image[c_col + c_row * width]);
+		}
+
+	// divide by size of mask
+	uint masksize = (left + 1 + right) * (up + 1 + down); // +1 because of "middle" element
+
+	// write new pixel value to output image
+	output[col + row * width] = convert_uchar4(sum / masksize);
+}
+
+
+// grayscale image, one work item per pixel
+__kernel void boxblur_gray (__global uchar* image,
+                            __global int* imageSize,
+                            __global int* k,
+                            __global uchar* output)
+{
+	int col = get_global_id(0);
+	int row = get_global_id(1);
+
+	int left = k[0];
+	int up = k[1];
+	int right = k[2];
+	int down = k[3];
+
+	int width = imageSize[0];
+	int height = imageSize[1];
+
+	uint sum = 0;
+
+	for (int c_row = row - up; c_row <= row + down; c_row++)
+		for (int c_col = col - left; c_col <= col + right; c_col++)
+		{
+			if (c_row >= 0 && c_row < height && c_col >= 0 && c_col < width)
+				sum += image[c_col + c_row * width];
+		}
+
+	uint masksize = (left + 1 + right) * (up + 1 + down);
+
+	output[col + row * width] = (uchar) (sum / masksize);
+}
@@ -0,0 +1,170 @@
+// An openCL kernel implementation of a box blur filter
+// using a summed-area table (integral image).
+
+// Takes an intensity image represented by width * height
+// integer values. First, a table of size (width + 1) * (height + 1)
+// is built in which every entry holds the sum of all image values
+// above and left of it (row 0 and column 0 are zero). Then, the
+// sum of any rectangle in the image can be read from four table
+// entries, so the cost per output pixel does not depend on the
+// size of the mask.
+
+// The host has to run three kernels in order:
+// 1. sat_rows - inclusive prefix sum of every image row
+// 2. sat_cols - inclusive prefix sum of every table column (in place)
+// 3. boxblur  - four-corner lookup per output pixel
+
+// Table entries are unsigned and allowed to wrap around: the
+// difference of the four corners is still exact as long as the sum
+// of a single mask fits into 32 bits, which the other boxblur
+// kernels require anyway (they sum into an int).
+
+
+// compile-time kernel parameters of specialized variants (see boxblur_naive.cl)
+#ifndef IMAGE_WIDTH
+#define IMAGE_WIDTH imageSize[0]
+#endif
+#ifndef IMAGE_HEIGHT
+#define IMAGE_HEIGHT imageSize[1]
+#endif
+#ifndef MASK_SIZE_LEFT
+#define MASK_SIZE_LEFT k[0]
+#endif
+#ifndef MASK_SIZE_UP
+#define MASK_SIZE_UP k[1]
+#endif
+#ifndef MASK_SIZE_RIGHT
+#define MASK_SIZE_RIGHT k[2]
+#endif
+#ifndef MASK_SIZE_DOWN
+#define MASK_SIZE_DOWN k[3]
+#endif
+
+
+// Prefix sum of image rows. Launch with a 2D NDRange of
+// (SCAN_LOCAL_SIZE, height) and a work group size of (SCAN_LOCAL_SIZE, 1),
+// so every work group scans exactly one row. The row is processed in chunks
+// of work group size; each chunk is scanned in local memory and offset by
+// the total of all previous chunks.
+__kernel void sat_rows (__global int* image,
+                        __global int* imageSize,
+                        __local uint* scratch, // one entry per work item
+                        __global uint* table)
+{
+	int lx = get_local_id(0);
+	int n = get_local_size(0);
+	int row = get_global_id(1);
+
+	int width = IMAGE_WIDTH;
+	int tableWidth = width + 1;
+
+	// table row "row + 1" belongs to image row "row" (row 0 is the zero row)
+	__global uint* tableRow = table + (row + 1) * tableWidth;
+
+	// zero column
+	if (lx == 0)
+		tableRow[0] = 0;
+
+	uint carry = 0; // sum of all previous chunks
+
+	for (int base = 0; base < width; base += n)
+	{
+		int col = base + lx;
+
+		// load chunk - values behind the end of the row are neutral
+		scratch[lx] = col < width ? (uint) image[col + row * width] : 0;
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		// Hillis-Steele inclusive scan in local memory
+		for (int offset = 1; offset < n; offset *= 2)
+		{
+			uint val = lx >= offset ? scratch[lx - offset] : 0;
+			barrier(CLK_LOCAL_MEM_FENCE);
+
+			scratch[lx] += val;
+			barrier(CLK_LOCAL_MEM_FENCE);
+		}
+
+		if (col < width)
+			tableRow[col + 1] = carry + scratch[lx];
+
+		carry += scratch[n - 1];
+
+		// scratch is overwritten by the next chunk
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+}
+
+
+// Prefix sum of table columns, in place. Launch with a 1D NDRange of
+// width + 1 work items. Every work item walks down one column, so
+// neighboring work items access neighboring addresses (coalesced).
+__kernel void sat_cols (__global int* imageSize,
+                        __global uint* table)
+{
+	int col = get_global_id(0);
+
+	int width = IMAGE_WIDTH;
+	int height = IMAGE_HEIGHT;
+	int tableWidth = width + 1;
+
+	if (col > width)
+		return;
+
+	// zero row
+	table[col] = 0;
+
+	uint sum = 0;
+
+	for (int row = 1; row <= height; row++)
+	{
+		sum += table[col + row * tableWidth];
+		table[col + row * tableWidth] = sum;
+	}
+}
+
+
+// Box blur lookup. Launch with a 2D NDRange of (width, height).
+// Mask parts outside of the image are clamped to the image borders,
+// which is the same as using the neutral element 0 for them.
+__kernel void boxblur (__global uint* table,
+                       __global int* imageSize,
+                       __global int* k,
+                       __global int* output)
+{
+	// retrieve this work item's global work item id in x and y dimensions
+	int col = get_global_id(0);
+	int row = get_global_id(1);
+
+	// extract mask dimensions for
+	// easier use
+	int left = MASK_SIZE_LEFT;
+	int up = MASK_SIZE_UP;
+	int right = MASK_SIZE_RIGHT;
+	int down = MASK_SIZE_DOWN;
+
+	int width = IMAGE_WIDTH;
+	int height = IMAGE_HEIGHT;
+	int tableWidth = width + 1;
+
+	// table coordinates of the mask corners
+	// (right/bottom corner is exclusive, hence the +1)
+	int x0 = clamp(col - left, 0, width);
+	int x1 = clamp(col + right + 1, 0, width);
+	int y0 = clamp(row - up, 0, height);
+	int y1 = clamp(row + down + 1, 0, height);
+
+	// get sum of all elements inside the mask
+	// centered at (col, row)
+	uint sum = table[x1 + y1 * tableWidth]
+	         - table[x0 + y1 * tableWidth]
+	         - table[x1 + y0 * tableWidth]
+	         + table[x0 + y0 * tableWidth];
+
+	// divide by size of mask
+	int masksize = (left + 1 + right) * (up + 1 + down); // +1 because of "middle" element
+	int pixelValue = (int) sum / masksize;
+
+	// write new pixel intensity value to output image
+	output[col + row * width] = pixelValue;
+}
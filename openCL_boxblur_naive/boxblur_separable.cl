@@ -0,0 +1,131 @@
+// An openCL kernel implementation of a box blur filter
+// using two separable sliding window passes.
+
+// Takes an intensity image represented by width * height
+// integer values. A box filter is separable, so the 2D mask sum
+// equals a horizontal sum over left + 1 + right values followed by a
+// vertical sum over up + 1 + down of those row sums.
+
+// Every work item walks a whole row (first pass) or column (second pass)
+// and keeps a running sum: the value entering the mask is added, the value
+// leaving it is subtracted. The cost per pixel does not depend on the
+// size of the mask.
+
+// The host has to run two kernels in order:
+// 1. boxblur_rows - horizontal running sums into an intermediate buffer
+// 2. boxblur      - vertical running sums, normalization and output
+
+// The intermediate buffer holds undivided sums, so the result is
+// identical to dividing the full 2D mask sum once.
+
+
+// compile-time kernel parameters of specialized variants (see boxblur_naive.cl)
+#ifndef IMAGE_WIDTH
+#define IMAGE_WIDTH imageSize[0]
+#endif
+#ifndef IMAGE_HEIGHT
+#define IMAGE_HEIGHT imageSize[1]
+#endif
+#ifndef MASK_SIZE_LEFT
+#define MASK_SIZE_LEFT k[0]
+#endif
+#ifndef MASK_SIZE_UP
+#define MASK_SIZE_UP k[1]
+#endif
+#ifndef MASK_SIZE_RIGHT
+#define MASK_SIZE_RIGHT k[2]
+#endif
+#ifndef MASK_SIZE_DOWN
+#define MASK_SIZE_DOWN k[3]
+#endif
+
+
+// Horizontal pass. Launch with a 1D NDRange of height work items.
+__kernel void boxblur_rows (__global int* image,
+                            __global int* imageSize,
+                            __global int* k,
+                            __global int* rowsums)
+{
+	int row = get_global_id(0);
+
+	// extract mask dimensions for
+	// easier use
+	int left = MASK_SIZE_LEFT;
+	int right = MASK_SIZE_RIGHT;
+
+	int width = IMAGE_WIDTH;
+
+	__global int* in = image + row * width;
+	__global int* out = rowsums + row * width;
+
+	// initial mask centered at column 0 - values left of the
+	// image are out of bounds and use the neutral element 0
+	int sum = 0;
+
+	for (int c_col = 0; c_col <= right && c_col < width; c_col++)
+		sum += in[c_col];
+
+	out[0] = sum;
+
+	// slide mask to the right
+	for (int col = 1; col < width; col++)
+	{
+		int enter = col + right; // value entering the mask
+		int leave = col - left - 1; // value leaving the mask
+
+		if (enter < width)
+			sum += in[enter];
+
+		if (leave >= 0)
+			sum -= in[leave];
+
+		out[col] = sum;
+	}
+}
+
+
+// Vertical pass. Launch with a 1D NDRange of width work items.
+// Neighboring work items access neighboring addresses (coalesced).
+__kernel void boxblur (__global int* rowsums,
+                       __global int* imageSize,
+                       __global int* k,
+                       __global int* output)
+{
+	int col = get_global_id(0);
+
+	// extract mask dimensions for
+	// easier use
+	int left = MASK_SIZE_LEFT;
+	int up = MASK_SIZE_UP;
+	int right = MASK_SIZE_RIGHT;
+	int down = MASK_SIZE_DOWN;
+
+	int width = IMAGE_WIDTH;
+	int height = IMAGE_HEIGHT;
+
+	int masksize = (left + 1 + right) * (up + 1 + down); // +1 because of "middle" element
+
+	// initial mask centered at row 0
+	int sum = 0;
+
+	for (int c_row = 0; c_row <= down && c_row < height; c_row++)
+		sum += rowsums[col + c_row * width];
+
+	output[col] = sum / masksize;
+
+	// slide mask down
+	for (int row = 1; row < height; row++)
+	{
+		int enter = row + down;
+		int leave = row - up - 1;
+
+		if (enter < height)
+			sum += rowsums[col + enter * width];
+
+		if (leave >= 0)
+			sum -= rowsums[col + leave * width];
+
+		// divide by size of mask and write new pixel intensity value to output image
+		output[col + row * width] = sum / masksize;
+	}
+}
@@ -0,0 +1,149 @@
+// An openCL kernel implementation of a box blur filter for 8 bit images
+// stored in tiles (see tiled_image.hpp).
+
+// Takes a band of tile rows of an image with 8 bits per channel - RGBA
+// (uchar4, kernel "boxblur") or grayscale (uchar, kernel "boxblur_gray") -
+// and blurs the pixels of one tile row of it, the strip. The band is the
+// strip plus the tile rows above and below it that the mask reaches into,
+// passed as three buffers: "above", "center" (the input tile row of the
+// strip) and "below". Input and output keep the tile layout of the file,
+// so the host can hand over mapped file memory without rearranging it.
+// Bands of neighboring strips overlap, so the host maps only the center in
+// place and passes copies of the halo tile rows - an unused halo buffer may
+// be any buffer, it is never read.
+
+// tiles[] describes the layout:
+//   0: image width      1: image height
+//   2: tile width       3: tile height
+//   4: tiles per row    5: pixels from one tile to the next
+//   6: first image row of the band (of "above")
+//   7: first image row of the strip (of "center", "below" starts one tile row later)
+// Border handling is the same as in boxblur_rgba.cl: values outside of the
+// image use the neutral element 0.
+
+
+// offset of pixel (col, row) in a buffer of tile rows starting at image row firstRow
+int tile_offset (__global int* tiles, int col, int row, int firstRow)
+{
+	int tileWidth = tiles[2];
+	int tileHeight = tiles[3];
+	int tileRow = (row - firstRow) / tileHeight;
+
+	return (tileRow * tiles[4] + col / tileWidth) * tiles[5] + // first pixel of tile
+	       (row % tileHeight) * tileWidth + col % tileWidth; // pixel inside of tile
+}
+
+
+// first image row of the band buffer holding row - 0 = above, 1 = center, 2 = below
+int band_part (__global int* tiles, int row, int* firstRow)
+{
+	int stripRow = tiles[7];
+	int tileHeight = tiles[3];
+
+	if (row < stripRow)
+	{
+		*firstRow = tiles[6];
+		return 0;
+	}
+
+	if (row < stripRow + tileHeight)
+	{
+		*firstRow = stripRow;
+		return 1;
+	}
+
+	*firstRow = stripRow + tileHeight;
+	return 2;
+}
+
+
+// RGBA image, one work item per pixel of the strip
+__kernel void boxblur (__global uchar4* above,
+                       __global uchar4* center,
+                       __global uchar4* below,
+                       __global int* tiles,
+                       __global int* k,
+                       __global uchar4* strip)
+{
+	int col = get_global_id(0);
+	int row = tiles[7] + get_global_id(1);
+
+	int left = k[0];
+	int up = k[1];
+	int right = k[2];
+	int down = k[3];
+
+	int width = tiles[0];
+	int height = tiles[1];
+
+	// work item beyond the edge of the image - the tile is padding there
+	if (col >= width || row >= height)
+		return;
+
+	uint4 sum = (uint4) (0); // sum of all mask elements per channel
+
+	// rows and columns of the mask inside of the image - the others add 0
+	int firstRow = max(row - up, 0);
+	int lastRow = min(row + down, height - 1);
+	int firstCol = max(col - left, 0);
+	int lastCol = min(col + right, width - 1);
+
+	for (int c_row = firstRow; c_row <= lastRow; c_row++)
+	{
+		int partRow;
+		int part = band_part(tiles, c_row, &partRow);
+		__global uchar4* band = part == 0 ? above : part == 1 ? center : below;
+
+		for (int c_col = firstCol; c_col <= lastCol; c_col++)
+			sum += convert_uint4(band[tile_offset(tiles, c_col, c_row, partRow)]);
+	}
+
+	uint masksize = (left + 1 + right) * (up + 1 + down); // +1 because of "middle" element
+
+	strip[tile_offset(tiles, col, row, tiles[7])] = convert_uchar4(sum / masksize);
+}
+
+
+// grayscale image, one work item per pixel of the strip
+__kernel void boxblur_gray (__global uchar* above,
+                            __global uchar* center,
+                            __global uchar* below,
+                            __global int* tiles,
+                            __global int* k,
+                            __global uchar* strip)
+{
+	int col = get_global_id(0);
+	int row = tiles[7] + get_global_id(1);
+
+	int left = k[0];
+	int up = k[1];
+	int right = k[2];
+	int down = k[3];
+
+	int width = tiles[0];
+	int height = tiles[1];
+
+	if (col >= width || row >= height)
+		return;
+
+	uint sum = 0;
+
+	int firstRow = max(row - up, 0);
+	int lastRow = min(row + down, height - 1);
+	int firstCol = max(col - left, 0);
+	int lastCol = min(col + right, width - 1);
+
+	for (int c_row = firstRow; c_row <= lastRow; c_row++)
+	{
+		int partRow;
+		int part = band_part(tiles, c_row, &partRow);
+		__global uchar* band = part == 0 ? above : part == 1 ? center : below;
+
+		for (int c_col = firstCol; c_col <= lastCol; c_col++)
+			sum += band[tile_offset(tiles, c_col, c_row, partRow)];
+	}
+
+	uint masksize = (left + 1 + right) * (up + 1 + down);
+
+	strip[tile_offset(tiles, col, row, tiles[7])] = (uchar) (sum / masksize);
+}
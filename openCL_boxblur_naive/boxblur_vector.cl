@@ -0,0 +1,181 @@
+// An openCL kernel implementation of a box blur filter
+// computing several output pixels per work item with vector loads.
+
+// Takes an intensity image represented by width * height
+// PIXEL values. Then, it applies a box blur to the image and writes it
+// to the output buffer.
+
+// Every work item computes a block of BLOCK_WIDTH * BLOCK_HEIGHT pixels
+// (see boxblur_blocking.cl) in horizontal runs of VECTOR_WIDTH pixels. The
+// mask sum of pixel x + j of a run starting at column x is
+
+//     first + (enter[0] - leave[0]) + ... + (enter[j - 1] - leave[j - 1])
+
+// where, summed over the rows of the mask, first is the mask sum of pixel x,
+// enter[j] = image[x + j + 1 + right] and leave[j] = image[x + j - left]. enter
+// and leave are read with one vload per mask row, so a run costs
+// left + 1 + right scalar and 2 vector loads per mask row instead of
+// VECTOR_WIDTH * (left + 1 + right) loads. The sliding sum over the run stays
+// in registers and the run is written with one vstore.
+
+// Build with -D VECTOR_WIDTH=<4, 8 or 16> - the host takes it from
+// CL_DEVICE_PREFERRED_VECTOR_WIDTH_INT. BLOCK_WIDTH should be a multiple of
+// VECTOR_WIDTH, else the last run of every block is computed completely but
+// only partially written. Runs whose mask reaches beyond the left or right
+// edge of the image are computed value by value with bounds checks.
+
+// Rows are IMAGE_PITCH values apart (see boxblur_naive.cl).
+
+#ifndef VECTOR_WIDTH
+#define VECTOR_WIDTH 4
+#endif
+
+// vloadN and vstoreN for N = VECTOR_WIDTH
+#define CONCAT_(a, b) a ## b
+#define CONCAT(a, b) CONCAT_(a, b)
+#define VLOADN CONCAT(vload, VECTOR_WIDTH)
+#define VSTOREN CONCAT(vstore, VECTOR_WIDTH)
+
+// compile-time kernel parameters of specialized variants (see boxblur_naive.cl)
+#ifndef IMAGE_WIDTH
+#define IMAGE_WIDTH imageSize[0]
+#endif
+#ifndef IMAGE_HEIGHT
+#define IMAGE_HEIGHT imageSize[1]
+#endif
+#ifndef IMAGE_PITCH
+#define IMAGE_PITCH imageSize[2]
+#endif
+#ifndef MASK_SIZE_LEFT
+#define MASK_SIZE_LEFT k[0]
+#endif
+#ifndef MASK_SIZE_UP
+#define MASK_SIZE_UP k[1]
+#endif
+#ifndef MASK_SIZE_RIGHT
+#define MASK_SIZE_RIGHT k[2]
+#endif
+#ifndef MASK_SIZE_DOWN
+#define MASK_SIZE_DOWN k[3]
+#endif
+#ifndef BLOCK_WIDTH
+#define BLOCK_WIDTH blockSize[0]
+#endif
+#ifndef BLOCK_HEIGHT
+#define BLOCK_HEIGHT blockSize[1]
+#endif
+
+// pixel and sum types, loads, stores and division-free normalization
+#include "pixel_types.clh"
+
+// SUM vector of N = VECTOR_WIDTH values, N values of a row as SUMN and writing N normalized sums
+#define SUMN CONCAT(SUM, VECTOR_WIDTH)
+#ifdef HALF_PIXEL
+#define LOADN(row, i) CONCAT(vload_half, VECTOR_WIDTH)(0, (row) + (i))
+#define STOREN(row, i, values) CONCAT(vstore_half, VECTOR_WIDTH)(values, 0, (row) + (i))
+#else
+#define LOADN(row, i) CONCAT(convert_, SUMN)(VLOADN(0, (row) + (i)))
+#define STOREN(row, i, values) VSTOREN(CONCAT(convert_, CONCAT(PIXEL, VECTOR_WIDTH))(values), 0, (row) + (i))
+#endif
+
+
+__kernel void boxblur (__global PIXEL* image,
+                       __global int* imageSize,
+                       __global int* k,
+                       __global int* blockSize,
+                       __local SUM* localmem, // not needed but kept so host code can stay unchanged
+                       __global PIXEL* output)
+{
+	// extract mask dimensions for easier use
+	int left = MASK_SIZE_LEFT;
+	int up = MASK_SIZE_UP;
+	int right = MASK_SIZE_RIGHT;
+	int down = MASK_SIZE_DOWN;
+
+	int width = IMAGE_WIDTH;
+	int height = IMAGE_HEIGHT;
+	int pitch = IMAGE_PITCH;
+
+	int blockX = get_global_id(0) * BLOCK_WIDTH; // x position of first element in block
+	int blockY = get_global_id(1) * BLOCK_HEIGHT; // y position of first element in block
+
+	// get block sizes
+	int blockWidth = BLOCK_WIDTH;
+	int blockHeight = BLOCK_HEIGHT;
+
+	// end of the block's columns inside of the image
+	int blockEnd = min(blockX + blockWidth, width);
+
+	for (int i = 0; i < blockHeight; i++)
+	{
+		int row = blockY + i;
+
+		// block or work item beyond the edge of the image
+		if (row >= height)
+			break;
+
+		// rows of the mask inside of the image - the others add 0
+		int firstRow = max(row - up, 0);
+		int lastRow = min(row + down, height - 1);
+
+		for (int x = blockX; x < blockEnd; x += VECTOR_WIDTH)
+		{
+			SUM sums[VECTOR_WIDTH]; // mask sums of the run
+
+			if (x - left >= 0 && x + VECTOR_WIDTH + right < width)
+			{
+				// mask sum of the first pixel and sliding sum updates of all rows
+				SUM first = 0;
+				SUMN enter = (SUMN) (0);
+				SUMN leave = (SUMN) (0);
+
+				for (int c_row = firstRow; c_row <= lastRow; c_row++)
+				{
+					__global PIXEL* in = image + c_row * pitch;
+
+					for (int c_col = x - left; c_col <= x + right; c_col++)
+						first += LOAD(in, c_col);
+
+					enter += LOADN(in, x + 1 + right);
+					leave += LOADN(in, x - left);
+				}
+
+				// slide the mask along the run
+				SUM updates[VECTOR_WIDTH];
+				VSTOREN(enter - leave, 0, updates);
+
+				sums[0] = first;
+
+				for (int j = 1; j < VECTOR_WIDTH; j++)
+					sums[j] = sums[j - 1] + updates[j - 1];
+			}
+			else
+			{
+				// mask reaches beyond the left or right edge - skip values
+				// out of bounds, same as adding neutral element 0
+				for (int j = 0; j < VECTOR_WIDTH; j++)
+				{
+					int col = x + j;
+					int firstCol = max(col - left, 0);
+					int lastCol = min(col + right, width - 1);
+
+					sums[j] = 0;
+
+					for (int c_row = firstRow; c_row <= lastRow; c_row++)
+						for (int c_col = firstCol; c_col <= lastCol; c_col++)
+							sums[j] += LOAD(image, c_col + c_row * pitch);
+				}
+			}
+
+			// divide by size of mask (left + 1 + right) * (up + 1 + down) and write the run
+			for (int j = 0; j < VECTOR_WIDTH; j++)
+				sums[j] = NORMALIZE(sums[j]);
+
+			if (x + VECTOR_WIDTH <= blockEnd)
+				STOREN(output, x + row * pitch, VLOADN(0, sums));
+			else
+				for (int j = 0; x + j < blockEnd; j++)
+					STORE(output, x + j + row * pitch, sums[j]);
+		}
+	}
+}
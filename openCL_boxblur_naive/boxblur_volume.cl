@@ -0,0 +1,119 @@
+// An openCL kernel implementation of a 3D box blur filter for volumes
+// (e.g. CT scans or simulation grids) with 2.5D blocking.
+
+// Takes a volume of width * height * depth integer values, stored plane by
+// plane (z) and row by row within a plane, and blurs every voxel with a box
+// of six-sided mask dimensions k = {left, up, right, down, front, back} -
+// front is the number of planes before the voxel (smaller z), back the
+// number of planes after it. Values outside of the volume use the neutral
+// element 0, every sum is divided by the full mask size.
+
+// 2.5D blocking: a work group covers an xy tile of get_local_size(0) *
+// get_local_size(1) voxels and streams along z through blockDepth[0] planes
+// (the third NDRange dimension counts these z blocks). Every plane is loaded
+// into __local memory once - the tile plus the mask halo - and every work
+// item sums the xy mask of its column in it. The 3D sum is a running sum
+// over the plane sums of the last front + 1 + back planes: the plane
+// entering the mask is added, the one leaving it subtracted. Plane sums are
+// kept in a ring in __local memory, one slot per plane of the mask and work
+// item, so a voxel is read from global memory about once per work group
+// instead of once per mask element, and the cost per voxel does not grow
+// with the depth of the mask. Neighbouring z blocks re-read front + back
+// planes each.
+
+// host has to provide
+//   tile: (local size x + left + right) * (local size y + up + down) values
+//   ring: local size x * local size y * (front + 1 + back) values
+
+
+__kernel void boxblur_volume (__global int* volume,
+                              __global int* volumeSize, // width, height, depth
+                              __global int* k,
+                              __global int* blockDepth, // planes per work group
+                              __local int* tile,
+                              __local int* ring,
+                              __global int* output)
+{
+	int left = k[0];
+	int up = k[1];
+	int right = k[2];
+	int down = k[3];
+	int front = k[4];
+	int back = k[5];
+
+	int width = volumeSize[0];
+	int height = volumeSize[1];
+	int depth = volumeSize[2];
+
+	int col = get_global_id(0);
+	int row = get_global_id(1);
+
+	int localCol = get_local_id(0);
+	int localRow = get_local_id(1);
+	int localWidth = get_local_size(0);
+	int localHeight = get_local_size(1);
+
+	// tile of the work group including the halo of the mask
+	int tileCol = get_group_id(0) * localWidth - left;
+	int tileRow = get_group_id(1) * localHeight - up;
+	int tileWidth = localWidth + left + right;
+	int tileHeight = localHeight + up + down;
+
+	// output planes of the work group
+	int firstPlane = get_global_id(2) * blockDepth[0];
+	int lastPlane = min(firstPlane + blockDepth[0], depth) - 1;
+
+	int planes = front + 1 + back; // +1 because of "middle" plane
+	int masksize = (left + 1 + right) * (up + 1 + down) * planes;
+
+	__local int* planeSums = ring + (localRow * localWidth + localCol) * planes; // ring of this work item
+	int sum = 0; // sum of the plane sums of the planes inside the mask
+
+	// planes entering the mask - from the first plane the first output plane
+	// needs to the last plane the last output plane needs
+	for (int z = firstPlane - front; z <= lastPlane + back; z++)
+	{
+		int planeSum = 0;
+
+		// planes outside of the volume add 0 - z is the same for the whole
+		// work group, so either all or no work items reach the barriers
+		if (z >= 0 && z < depth)
+		{
+			__global int* plane = volume + (size_t) z * width * height;
+
+			// no work item reads the previous plane any more
+			barrier(CLK_LOCAL_MEM_FENCE);
+
+			for (int i = localRow * localWidth + localCol; i < tileWidth * tileHeight; i += localWidth * localHeight)
+			{
+				int x = tileCol + i % tileWidth;
+				int y = tileRow + i / tileWidth;
+
+				tile[i] = x >= 0 && x < width && y >= 0 && y < height ? plane[x + y * width] : 0;
+			}
+
+			barrier(CLK_LOCAL_MEM_FENCE);
+
+			for (int c_row = 0; c_row <= up + down; c_row++)
+				for (int c_col = 0; c_col <= left + right; c_col++)
+					planeSum += tile[(localRow + c_row) * tileWidth + localCol + c_col];
+		}
+
+		// plane z enters the mask and takes the slot of plane z - planes, which leaves it
+		int entered = z - (firstPlane - front);
+		int slot = entered % planes;
+
+		if (entered >= planes)
+			sum -= planeSums[slot];
+
+		planeSums[slot] = planeSum;
+		sum += planeSum;
+
+		// the mask of plane z - back is complete - work items beyond the edge
+		// of the volume only helped loading the tile
+		int outPlane = z - back;
+
+		if (outPlane >= firstPlane && col < width && row < height)
+			output[col + row * width + (size_t) outPlane * width * height] = sum / masksize;
+	}
+}
@@ -0,0 +1,308 @@
+// native host implementation of the box blur filter.
+
+// Used to verify the results of the openCL kernels and as a fallback
+// on machines without an openCL device.
+
+// Every thread computes a band of rows with two running sums:
+// a horizontal one per row and a vertical one per column. The vertical
+// update and the normalization are simple loops over a whole row which
+// the compiler vectorizes (compile with -O3 -march=native for AVX2).
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+
+#include "cpu_boxblur.hpp"
+
+using namespace std;
+
+
+// horizontal running sum of one image row, values left and right of the image are 0
+static void row_sums (const int* in, int* out, int width, int left, int right)
+{
+    int sum = 0;
+
+    for (int col = 0; col <= right && col < width; col++)
+        sum += in[col];
+
+    out[0] = sum;
+
+    for (int col = 1; col < width; col++)
+    {
+        if (col + right < width)
+            sum += in[col + right]; // value entering the mask
+
+        if (col - left - 1 >= 0)
+            sum -= in[col - left - 1]; // value leaving the mask
+
+        out[col] = sum;
+    }
+}
+
+
+// blur image rows [firstRow, lastRow)
+static void blur_band (const int* image, int* output, int width, int height, const int* k, int firstRow, int lastRow)
+{
+    int left = k[0];
+    int up = k[1];
+    int right = k[2];
+    int down = k[3];
+
+    int window = up + 1 + down;
+    double masksize = (double) (left + 1 + right) * window; // +1 because of "middle" element
+
+    // ring buffer holding the horizontal sums of the rows inside the mask
+    vector<int> ring ((size_t) window * width, 0);
+    vector<int> colsum (width, 0);
+
+    int* __restrict sums = colsum.data();
+
+    // vertical sums for the mask centered at firstRow
+    for (int c_row = max(firstRow - up, 0); c_row <= firstRow + down && c_row < height; c_row++)
+    {
+        int* __restrict hsum = &ring[(size_t) (c_row % window) * width];
+        row_sums(image + (size_t) c_row * width, hsum, width, left, right);
+
+        for (int col = 0; col < width; col++)
+            sums[col] += hsum[col];
+    }
+
+    for (int row = firstRow; row < lastRow; row++)
+    {
+        int* __restrict out = output + (size_t) row * width;
+
+        // divide by size of mask - division in double precision is exact
+        // for 32 bit integers and, unlike integer division, vectorizes
+        for (int col = 0; col < width; col++)
+            out[col] = (int) (sums[col] / masksize);
+
+        if (row + 1 == lastRow)
+            break;
+
+        // slide mask down: the row leaving the mask and the row entering
+        // it share the same slot of the ring buffer
+        int leave = row - up;
+        int enter = row + down + 1;
+
+        int* __restrict hsum = &ring[(size_t) ((enter % window + window) % window) * width];
+
+        if (leave >= 0)
+            for (int col = 0; col < width; col++)
+                sums[col] -= hsum[col];
+
+        if (enter < height)
+        {
+            row_sums(image + (size_t) enter * width, hsum, width, left, right);
+
+            for (int col = 0; col < width; col++)
+                sums[col] += hsum[col];
+        }
+    }
+}
+
+
+void cpu_boxblur (const int* image, int* output, int width, int height, const int* k, unsigned threads)
+{
+    // empty image - nothing to split into bands
+    if (width <= 0 || height <= 0)
+        return;
+
+    if (threads == 0)
+        threads = max(thread::hardware_concurrency(), 1u);
+
+    // no more threads than rows
+    threads = min(threads, (unsigned) height);
+
+    vector<thread> workers;
+    int bandHeight = (height + threads - 1) / threads;
+
+    for (int firstRow = 0; firstRow < height; firstRow += bandHeight)
+    {
+        int lastRow = min(firstRow + bandHeight, height);
+        workers.push_back(thread(blur_band, image, output, width, height, k, firstRow, lastRow));
+    }
+
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+
+// position inside of [0, n) that replaces position x
+static int border_index (int x, int n, int borderMode)
+{
+    if (borderMode == BORDER_CLAMP)
+        return min(max(x, 0), n - 1);
+
+    if (borderMode == BORDER_MIRROR)
+    {
+        if (n == 1)
+            return 0;
+
+        // reflections repeat with period 2 * (n - 1)
+        int period = 2 * (n - 1);
+        x = abs(x) % period;
+
+        return x < n ? x : period - x;
+    }
+
+    x %= n;
+
+    return x < 0 ? x + n : x;
+}
+
+
+void cpu_boxblur_border (const int* image, int* output, int width, int height, const int* k, int borderMode, unsigned threads)
+{
+    // empty image - no edge to map positions to
+    if (width <= 0 || height <= 0)
+        return;
+
+    if (borderMode == BORDER_ZERO)
+    {
+        cpu_boxblur(image, output, width, height, k, threads);
+        return;
+    }
+
+    // pad the image by the mask on every side - every mask of an image
+    // pixel then lies inside of the padded image and never sees a 0
+    int left = k[0];
+    int up = k[1];
+    int paddedWidth = left + width + k[2];
+    int paddedHeight = up + height + k[3];
+
+    vector<int> padded ((size_t) paddedWidth * paddedHeight);
+    vector<int> blurred ((size_t) paddedWidth * paddedHeight);
+
+    for (int row = 0; row < paddedHeight; row++)
+    {
+        const int* in = image + (size_t) border_index(row - up, height, borderMode) * width;
+
+        for (int col = 0; col < paddedWidth; col++)
+            padded[col + (size_t) row * paddedWidth] = in[border_index(col - left, width, borderMode)];
+    }
+
+    cpu_boxblur(padded.data(), blurred.data(), paddedWidth, paddedHeight, k, threads);
+
+    for (int row = 0; row < height; row++)
+        copy(&blurred[left + (size_t) (row + up) * paddedWidth],
+             &blurred[left + width + (size_t) (row + up) * paddedWidth],
+             output + (size_t) row * width);
+}
+
+
+// mask sums of volume planes [firstPlane, lastPlane) over the xy part of the mask, not divided
+static void sum_planes (const int* volume, int* sums, int width, int height, const int* k, int firstPlane, int lastPlane)
+{
+    int up = k[1];
+    int down = k[3];
+    size_t planeSize = (size_t) width * height;
+
+    vector<int> hsums (planeSize);
+    vector<int> colsum (width);
+
+    for (int plane = firstPlane; plane < lastPlane; plane++)
+    {
+        const int* in = volume + plane * planeSize;
+        int* __restrict out = sums + plane * planeSize;
+        int* __restrict vsum = colsum.data();
+
+        for (int row = 0; row < height; row++)
+            row_sums(in + (size_t) row * width, &hsums[(size_t) row * width], width, k[0], k[2]);
+
+        // vertical running sum of the horizontal sums, one whole row at a time
+        fill(colsum.begin(), colsum.end(), 0);
+
+        for (int c_row = 0; c_row <= down && c_row < height; c_row++)
+            for (int col = 0; col < width; col++)
+                vsum[col] += hsums[(size_t) c_row * width + col];
+
+        for (int row = 0; row < height; row++)
+        {
+            for (int col = 0; col < width; col++)
+                out[(size_t) row * width + col] = vsum[col];
+
+            int leave = row - up;
+            int enter = row + down + 1;
+
+            if (leave >= 0)
+                for (int col = 0; col < width; col++)
+                    vsum[col] -= hsums[(size_t) leave * width + col];
+
+            if (enter < height)
+                for (int col = 0; col < width; col++)
+                    vsum[col] += hsums[(size_t) enter * width + col];
+        }
+    }
+}
+
+
+// running sum of the plane sums along z for positions [first, last) of every plane, divided by the mask size
+static void sum_depth (const int* sums, int* output, int width, int height, int depth, const int* k, size_t first, size_t last)
+{
+    int front = k[4];
+    int back = k[5];
+    size_t planeSize = (size_t) width * height;
+    double masksize = (double) (k[0] + 1 + k[2]) * (k[1] + 1 + k[3]) * (front + 1 + back);
+
+    vector<int> zsum (last - first, 0);
+    int* __restrict sum = zsum.data();
+
+    for (int c_plane = 0; c_plane <= back && c_plane < depth; c_plane++)
+        for (size_t i = first; i < last; i++)
+            sum[i - first] += sums[c_plane * planeSize + i];
+
+    for (int plane = 0; plane < depth; plane++)
+    {
+        for (size_t i = first; i < last; i++)
+            output[plane * planeSize + i] = (int) (sum[i - first] / masksize);
+
+        int leave = plane - front;
+        int enter = plane + back + 1;
+
+        if (leave >= 0)
+            for (size_t i = first; i < last; i++)
+                sum[i - first] -= sums[leave * planeSize + i];
+
+        if (enter < depth)
+            for (size_t i = first; i < last; i++)
+                sum[i - first] += sums[enter * planeSize + i];
+    }
+}
+
+
+void cpu_boxblur_volume (const int* volume, int* output, int width, int height, int depth, const int* k, unsigned threads)
+{
+    // empty volume - nothing to split into bands
+    if (width <= 0 || height <= 0 || depth <= 0)
+        return;
+
+    if (threads == 0)
+        threads = max(thread::hardware_concurrency(), 1u);
+
+    size_t planeSize = (size_t) width * height;
+    vector<int> sums (planeSize * depth);
+
+    // xy sums - one band of planes per thread
+    unsigned planeThreads = min(threads, (unsigned) depth);
+    int bandDepth = (depth + planeThreads - 1) / planeThreads;
+
+    vector<thread> workers;
+
+    for (int firstPlane = 0; firstPlane < depth; firstPlane += bandDepth)
+        workers.push_back(thread(sum_planes, volume, sums.data(), width, height, k, firstPlane, min(firstPlane + bandDepth, depth)));
+
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+
+    // z sums - one range of positions per thread, every thread walks through all planes
+    size_t rangeSize = (planeSize + threads - 1) / threads;
+
+    workers.clear();
+
+    for (size_t first = 0; first < planeSize; first += rangeSize)
+        workers.push_back(thread(sum_depth, sums.data(), output, width, height, depth, k, first, min(first + rangeSize, planeSize)));
+
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
@@ -0,0 +1,30 @@
+// native host implementation of the box blur filter.
+
+#ifndef CPU_BOXBLUR_HPP
+#define CPU_BOXBLUR_HPP
+
+// Applies a box blur with mask dimensions k = {left, up, right, down}
+// to an image of width * height integer values and writes it to output.
+// Values outside of the image use the neutral element 0 and every sum is
+// divided by the full mask size, so the result is identical to boxblur_naive.cl.
+
+// The image is split into bands of rows, one per thread
+// (threads == 0 uses all hardware threads). Empty images write nothing.
+void cpu_boxblur (const int* image, int* output, int width, int height, const int* k, unsigned threads);
+
+// Same for a volume of width * height * depth values stored plane by plane,
+// with mask dimensions k = {left, up, right, down, front, back} (front: planes
+// before, back: planes after) - identical to boxblur_volume.cl.
+void cpu_boxblur_volume (const int* volume, int* output, int width, int height, int depth, const int* k, unsigned threads);
+
+// border modes - values used for positions outside of the image (see boxblur_border.cl)
+#define BORDER_ZERO 0 // neutral element 0
+#define BORDER_CLAMP 1 // nearest edge value
+#define BORDER_MIRROR 2 // reflection at the edge, edge value not repeated (-1 -> 1)
+#define BORDER_WRAP 3 // periodic continuation (-1 -> width - 1)
+
+// Same as cpu_boxblur, but positions outside of the image are
+// mapped into it according to borderMode.
+void cpu_boxblur_border (const int* image, int* output, int width, int height, const int* k, int borderMode, unsigned threads);
+
+#endif
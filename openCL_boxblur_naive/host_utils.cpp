@@ -0,0 +1,92 @@
+// small helpers shared by the host programs.
+
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "host_utils.hpp"
+
+using namespace std;
+
+
+// read a whole file into a string
+bool read_file (const char* filename, string* contents)
+{
+    ifstream file(filename, ios::binary);
+
+    if (!file)
+        return false;
+
+    stringstream buffer;
+    buffer << file.rdbuf();
+    *contents = buffer.str();
+
+    return true;
+}
+
+
+// read a kernel source file, lines '#include "name"' are replaced by the
+// file name next to the kernel
+bool read_kernel (const char* filename, string* source)
+{
+    string contents;
+
+    if (!read_file(filename, &contents))
+        return false;
+
+    string path(filename);
+    size_t slash = path.rfind('/');
+    string dir = slash == string::npos ? "" : path.substr(0, slash + 1);
+
+    istringstream lines(contents);
+    string line;
+    int number = 0;
+
+    source->clear();
+
+    while (getline(lines, line))
+    {
+        number++;
+
+        size_t open = line.find('"');
+        size_t close = open == string::npos ? string::npos : line.find('"', open + 1);
+
+        if (line.compare(0, 9, "#include ") != 0 || close == string::npos)
+        {
+            *source += line + "\n";
+            continue;
+        }
+
+        string header;
+        string name = dir + line.substr(open + 1, close - open - 1);
+
+        if (!read_kernel(name.c_str(), &header))
+            return false;
+
+        // keep line numbers of build logs pointing into the kernel file
+        *source += header + "#line " + to_string(number + 1) + "\n";
+    }
+
+    return true;
+}
+
+
+// read a kernel source file into a malloc'ed buffer
+char* read_source (const char *filename)
+{
+    string source;
+
+    if (!read_kernel(filename, &source) || source.empty())
+        return NULL;
+
+    return strdup(source.c_str());
+}
+
+
+// round value up to a multiple of multiple
+size_t round_up (size_t value, size_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
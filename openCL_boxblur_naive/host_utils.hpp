@@ -0,0 +1,24 @@
+// small helpers shared by the host programs.
+
+#ifndef HOST_UTILS_HPP
+#define HOST_UTILS_HPP
+
+#include <stddef.h>
+#include <string>
+
+// read a whole file into contents, false if it cannot be read
+bool read_file (const char* filename, std::string* contents);
+
+// Read an openCL source file. Lines '#include "name"' are replaced by the
+// (recursively read) file name in the directory of the kernel, so headers
+// need no -I build option and are part of the source the program cache
+// hashes. False if a file cannot be read.
+bool read_kernel (const char* filename, std::string* source);
+
+// read_kernel into a 0-terminated buffer allocated with malloc, NULL on failure
+char* read_source (const char* filename);
+
+// round value up to a multiple of multiple
+size_t round_up (size_t value, size_t multiple);
+
+#endif
@@ -0,0 +1,258 @@
+// approximates a Gaussian blur by several box blur passes on the device.
+
+// n box blurs of width w have the variance n * (w^2 - 1) / 12, so the ideal
+// width for a Gaussian of standard deviation sigma is sqrt(12 sigma^2 / n + 1).
+// Box widths have to be odd for symmetric masks, so m passes use the odd width
+// below and n - m passes the odd width above the ideal width.
+
+#include <CL/cl.h>
+#include <math.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "iterated_blur.hpp"
+#include "host_utils.hpp"
+
+#define FUSED_LOCAL_SIZE 16 // work items per work group per dimension of fused launches
+
+using namespace std;
+
+
+void gauss_box_masks (double sigma, cl_int passes, cl_int* k)
+{
+    double variance = sigma * sigma;
+    double ideal = sqrt(12.0 * variance / passes + 1.0);
+
+    int lower = (int) floor(ideal);
+    if (lower % 2 == 0)
+        lower--;
+
+    lower = max(lower, 1);
+    int upper = lower + 2;
+
+    // number of passes with the lower width
+    double m = (12.0 * variance - passes * lower * lower - 4.0 * passes * lower - 3.0 * passes) / (-4.0 * lower - 4.0);
+    int lowerPasses = min(max((int) floor(m + 0.5), 0), (int) passes);
+
+    for (int p = 0; p < passes; p++)
+    {
+        int radius = ((p < lowerPasses ? lower : upper) - 1) / 2;
+
+        for (int i = 0; i < 4; i++)
+            k[4 * p + i] = radius;
+    }
+}
+
+
+// local memory of a fused launch: two tiles including the halo of all its passes
+static size_t fused_localmem (const cl_int* k, cl_int first, cl_int count, const size_t* localSize)
+{
+    size_t halo[4] = {0, 0, 0, 0};
+
+    for (int p = first; p < first + count; p++)
+        for (int i = 0; i < 4; i++)
+            halo[i] += k[4 * p + i];
+
+    return 2 * (halo[0] + localSize[0] + halo[2]) * (halo[1] + localSize[1] + halo[3]) * sizeof(cl_int);
+}
+
+
+// ping-pong with the two kernels of boxblur_separable.cl, returns the buffer holding the result
+static cl_int enqueue_separable (cl_context context, cl_command_queue queue, cl_program program,
+                                 cl_mem* d_image, cl_mem d_imageSize, cl_int width, cl_int height,
+                                 const cl_int* k, cl_int passes, int* result)
+{
+    cl_int ret;
+
+    cl_kernel rows = clCreateKernel(program, "boxblur_rows", &ret);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    cl_kernel cols = clCreateKernel(program, "boxblur", &ret);
+    if (ret != CL_SUCCESS)
+    {
+        clReleaseKernel(rows);
+        return ret;
+    }
+
+    cl_mem d_rowsums = clCreateBuffer(context, CL_MEM_READ_WRITE, (size_t) width * height * sizeof(cl_int), NULL, &ret);
+
+    // the kernels read their mask from k[0] .. k[3], so every pass has its own mask buffer
+    vector<cl_mem> d_masks(passes, (cl_mem) NULL);
+
+    for (int p = 0; p < passes && ret == CL_SUCCESS; p++)
+        d_masks[p] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, 4 * sizeof(cl_int), (void*) (k + 4 * p), &ret);
+
+    int current = 0;
+
+    for (int p = 0; p < passes && ret == CL_SUCCESS; p++)
+    {
+        clSetKernelArg(rows, 0, sizeof(cl_mem), (void*) &d_image[current]);
+        clSetKernelArg(rows, 1, sizeof(cl_mem), (void*) &d_imageSize);
+        clSetKernelArg(rows, 2, sizeof(cl_mem), (void*) &d_masks[p]);
+        clSetKernelArg(rows, 3, sizeof(cl_mem), (void*) &d_rowsums);
+
+        clSetKernelArg(cols, 0, sizeof(cl_mem), (void*) &d_rowsums);
+        clSetKernelArg(cols, 1, sizeof(cl_mem), (void*) &d_imageSize);
+        clSetKernelArg(cols, 2, sizeof(cl_mem), (void*) &d_masks[p]);
+        clSetKernelArg(cols, 3, sizeof(cl_mem), (void*) &d_image[1 - current]);
+
+        const size_t rowsGlobalSize = height;
+        const size_t colsGlobalSize = width;
+
+        ret = clEnqueueNDRangeKernel(queue, rows, 1, NULL, &rowsGlobalSize, NULL, 0, NULL, NULL);
+        if (ret != CL_SUCCESS)
+            break;
+
+        ret = clEnqueueNDRangeKernel(queue, cols, 1, NULL, &colsGlobalSize, NULL, 0, NULL, NULL);
+        current = 1 - current;
+    }
+
+    // buffers and kernels are only released once the queued commands are done
+    for (int p = 0; p < passes; p++)
+        if (d_masks[p])
+            clReleaseMemObject(d_masks[p]);
+
+    if (d_rowsums)
+        clReleaseMemObject(d_rowsums);
+
+    clReleaseKernel(rows);
+    clReleaseKernel(cols);
+
+    *result = current;
+
+    return ret;
+}
+
+
+// ping-pong with boxblur_iterated.cl, returns the buffer holding the result
+static cl_int enqueue_fused (cl_context context, cl_device_id device, cl_command_queue queue, cl_program program,
+                             cl_mem* d_image, cl_mem d_imageSize, cl_int width, cl_int height,
+                             const cl_int* k, cl_int passes, int* result)
+{
+    cl_int ret;
+
+    cl_kernel kernel = clCreateKernel(program, "boxblur_fused", &ret);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    cl_mem d_masks = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, 4 * passes * sizeof(cl_int), (void*) k, &ret);
+
+    cl_ulong maxLocalmem = 0;
+    size_t maxGroupSize = 1;
+    clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &maxLocalmem, NULL);
+    clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &maxGroupSize, NULL);
+
+    // the NDRange is rounded up to whole work groups, the kernel skips pixels outside of the image
+    size_t localSize[2] = {min((size_t) FUSED_LOCAL_SIZE, (size_t) width), min((size_t) FUSED_LOCAL_SIZE, (size_t) height)};
+
+    while (localSize[0] * localSize[1] > maxGroupSize)
+    {
+        if (localSize[1] >= localSize[0])
+            localSize[1] /= 2;
+        else
+            localSize[0] /= 2;
+    }
+
+    const size_t globalSizes[2] = {round_up(width, localSize[0]), round_up(height, localSize[1])};
+    int current = 0;
+
+    for (cl_int first = 0; first < passes && ret == CL_SUCCESS; )
+    {
+        // fuse as many of the following passes as fit into local memory
+        cl_int count = 0;
+        while (first + count < passes && fused_localmem(k, first, count + 1, localSize) <= maxLocalmem)
+            count++;
+
+        if (count == 0)
+        {
+            cout << "iterated_blur: mask of pass " << first << " does not fit into local memory\n";
+            ret = CL_OUT_OF_RESOURCES;
+            break;
+        }
+
+        size_t tileBytes = fused_localmem(k, first, count, localSize) / 2;
+
+        clSetKernelArg(kernel, 0, sizeof(cl_mem), (void*) &d_image[current]);
+        clSetKernelArg(kernel, 1, sizeof(cl_mem), (void*) &d_imageSize);
+        clSetKernelArg(kernel, 2, sizeof(cl_mem), (void*) &d_masks);
+        clSetKernelArg(kernel, 3, sizeof(cl_int), (void*) &first);
+        clSetKernelArg(kernel, 4, sizeof(cl_int), (void*) &count);
+        clSetKernelArg(kernel, 5, tileBytes, NULL);
+        clSetKernelArg(kernel, 6, tileBytes, NULL);
+        clSetKernelArg(kernel, 7, sizeof(cl_mem), (void*) &d_image[1 - current]);
+
+        ret = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, globalSizes, localSize, 0, NULL, NULL);
+
+        cout << "Fused passes " << first << " to " << first + count - 1 << " into one launch\n";
+
+        first += count;
+        current = 1 - current;
+    }
+
+    if (d_masks)
+        clReleaseMemObject(d_masks);
+
+    clReleaseKernel(kernel);
+
+    *result = current;
+
+    return ret;
+}
+
+
+cl_int iterated_blur (cl_context context, cl_device_id device, cl_program program, bool fused,
+                      const cl_int* image, cl_int* output, cl_int width, cl_int height,
+                      const cl_int* k, cl_int passes)
+{
+    cl_int ret;
+    cl_int imageSize[2] = {width, height};
+    size_t imageBytes = (size_t) width * height * sizeof(cl_int);
+
+    // in-order queue - every command starts after the previous one has finished
+    cl_command_queue queue = clCreateCommandQueue(context, device, 0, &ret);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    cl_mem d_imageSize = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, 2 * sizeof(cl_int), imageSize, &ret);
+
+    // ping-pong buffers - input of one pass is output of the previous one
+    cl_mem d_image[2] = {NULL, NULL};
+
+    for (int i = 0; i < 2 && ret == CL_SUCCESS; i++)
+        d_image[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, imageBytes, NULL, &ret);
+
+    int result = 0;
+
+    if (ret == CL_SUCCESS)
+        ret = clEnqueueWriteBuffer(queue, d_image[0], CL_FALSE, 0, imageBytes, image, 0, NULL, NULL);
+
+    if (ret == CL_SUCCESS)
+    {
+        if (fused)
+            ret = enqueue_fused(context, device, queue, program, d_image, d_imageSize, width, height, k, passes, &result);
+        else
+            ret = enqueue_separable(context, queue, program, d_image, d_imageSize, width, height, k, passes, &result);
+    }
+
+    // the only point the host waits for the device
+    if (ret == CL_SUCCESS)
+        ret = clEnqueueReadBuffer(queue, d_image[result], CL_TRUE, 0, imageBytes, output, 0, NULL, NULL);
+
+    if (ret != CL_SUCCESS)
+        cout << "iterated_blur: " << ret << "\n";
+
+    clFinish(queue);
+
+    for (int i = 0; i < 2; i++)
+        if (d_image[i])
+            clReleaseMemObject(d_image[i]);
+
+    if (d_imageSize)
+        clReleaseMemObject(d_imageSize);
+
+    clReleaseCommandQueue(queue);
+
+    return ret;
+}
@@ -0,0 +1,28 @@
+// approximates a Gaussian blur by several box blur passes on the device.
+
+#ifndef ITERATED_BLUR_HPP
+#define ITERATED_BLUR_HPP
+
+#include <CL/cl.h>
+
+// Writes symmetric masks {left, up, right, down} for passes box blurs to
+// k[0] .. k[4 * passes - 1] that together approximate a Gaussian blur with
+// standard deviation sigma. Every mask width is one of the two odd widths
+// around the ideal width, mixed so that the variance of all passes is
+// as close to sigma^2 as possible.
+void gauss_box_masks (double sigma, cl_int passes, cl_int* k);
+
+// Blurs an image of width * height values passes times, pass p using the
+// mask k[4 * p] .. k[4 * p + 3]. The image is uploaded and downloaded once,
+// all passes run on one in-order command queue without waiting on the host.
+
+// If fused is false, program has to be built from boxblur_separable.cl: every
+// pass runs its two kernels, passes ping-pong between two image buffers.
+// If fused is true, program has to be built from boxblur_iterated.cl: as many
+// consecutive passes as fit into local memory run in one launch, launches
+// ping-pong between the two image buffers.
+cl_int iterated_blur (cl_context context, cl_device_id device, cl_program program, bool fused,
+                      const cl_int* image, cl_int* output, cl_int width, cl_int height,
+                      const cl_int* k, cl_int passes);
+
+#endif
@@ -0,0 +1,200 @@
+// iterative heat diffusion (Jacobi) stencil with temporal blocking.
+
+#include <CL/cl.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "jacobi.hpp"
+#include "host_utils.hpp"
+
+#define JACOBI_LOCAL_SIZE 16 // work items per work group per dimension (power of 2)
+#define REDUCE_LOCAL_SIZE 256 // work items of the residual reduction (power of 2)
+
+using namespace std;
+
+
+// local memory of one launch: two tiles with a halo of steps values and the reduction scratch
+static size_t jacobi_localmem (const size_t* localSize, cl_int steps)
+{
+    return (2 * (localSize[0] + 2 * steps) * (localSize[1] + 2 * steps) + localSize[0] * localSize[1]) * sizeof(cl_float);
+}
+
+
+cl_int jacobi_solve (cl_context context, cl_device_id device, cl_program program,
+                     float* grid, cl_int width, cl_int height, float alpha,
+                     cl_int stepsPerLaunch, cl_int checkInterval, float tolerance, cl_int maxSteps,
+                     cl_int* steps, float* residual)
+{
+    cl_int ret;
+    cl_int imageSize[2] = {width, height};
+    size_t gridBytes = (size_t) width * height * sizeof(cl_float);
+
+    *steps = 0;
+    *residual = -1;
+
+    cl_kernel stepKernel = clCreateKernel(program, "jacobi_steps", &ret);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    cl_kernel reduceKernel = clCreateKernel(program, "reduce_max", &ret);
+    if (ret != CL_SUCCESS)
+    {
+        clReleaseKernel(stepKernel);
+        return ret;
+    }
+
+    // in-order queue - every command starts after the previous one has finished
+    cl_command_queue queue = clCreateCommandQueue(context, device, 0, &ret);
+
+    cl_ulong maxLocalmem = 0;
+    size_t stepGroupSize = 1, reduceGroupSize = 1;
+    clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &maxLocalmem, NULL);
+    clGetKernelWorkGroupInfo(stepKernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &stepGroupSize, NULL);
+    clGetKernelWorkGroupInfo(reduceKernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &reduceGroupSize, NULL);
+
+    // power of 2 sizes for the residual reduction, no larger than needed for
+    // small grids - the NDRange is rounded up to whole work groups
+    size_t localSize[2] = {JACOBI_LOCAL_SIZE, JACOBI_LOCAL_SIZE};
+
+    for (int i = 0; i < 2; i++)
+        while (localSize[i] > 1 && localSize[i] / 2 >= (size_t) imageSize[i])
+            localSize[i] /= 2;
+
+    while (localSize[0] * localSize[1] > stepGroupSize)
+    {
+        if (localSize[1] >= localSize[0])
+            localSize[1] /= 2;
+        else
+            localSize[0] /= 2;
+    }
+
+    size_t reduceSize = REDUCE_LOCAL_SIZE;
+    while (reduceSize > reduceGroupSize)
+        reduceSize /= 2;
+
+    // wider halos need more local memory
+    cl_int blockSteps = max(stepsPerLaunch, 1);
+    while (blockSteps > 1 && jacobi_localmem(localSize, blockSteps) > maxLocalmem)
+        blockSteps--;
+
+    if (jacobi_localmem(localSize, blockSteps) > maxLocalmem)
+        ret = CL_OUT_OF_RESOURCES;
+
+    if (blockSteps < stepsPerLaunch)
+        cout << "jacobi_solve: " << blockSteps << " instead of " << stepsPerLaunch << " steps per launch fit into local memory\n";
+
+    const size_t globalSizes[2] = {round_up(width, localSize[0]), round_up(height, localSize[1])};
+    cl_int numGroups = (cl_int) ((globalSizes[0] / localSize[0]) * (globalSizes[1] / localSize[1]));
+
+    cl_mem d_imageSize = NULL, d_residuals = NULL, d_residual = NULL;
+    cl_mem d_grid[2] = {NULL, NULL};
+
+    if (ret == CL_SUCCESS)
+        d_imageSize = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, 2 * sizeof(cl_int), imageSize, &ret);
+
+    // ping-pong buffers - input of one launch is output of the previous one
+    for (int i = 0; i < 2 && ret == CL_SUCCESS; i++)
+        d_grid[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, gridBytes, NULL, &ret);
+
+    // largest change per work group and over all work groups
+    if (ret == CL_SUCCESS)
+        d_residuals = clCreateBuffer(context, CL_MEM_READ_WRITE, numGroups * sizeof(cl_float), NULL, &ret);
+
+    if (ret == CL_SUCCESS)
+        d_residual = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(cl_float), NULL, &ret);
+
+    if (ret == CL_SUCCESS)
+        ret = clEnqueueWriteBuffer(queue, d_grid[0], CL_FALSE, 0, gridBytes, grid, 0, NULL, NULL);
+
+    size_t tileBytes = (localSize[0] + 2 * blockSteps) * (localSize[1] + 2 * blockSteps) * sizeof(cl_float);
+    int current = 0;
+    int launches = 0;
+
+    while (ret == CL_SUCCESS && *steps < maxSteps)
+    {
+        cl_int launchSteps = min(blockSteps, maxSteps - *steps);
+
+        clSetKernelArg(stepKernel, 0, sizeof(cl_mem), (void*) &d_grid[current]);
+        clSetKernelArg(stepKernel, 1, sizeof(cl_mem), (void*) &d_imageSize);
+        clSetKernelArg(stepKernel, 2, sizeof(cl_float), (void*) &alpha);
+        clSetKernelArg(stepKernel, 3, sizeof(cl_int), (void*) &launchSteps);
+        clSetKernelArg(stepKernel, 4, tileBytes, NULL);
+        clSetKernelArg(stepKernel, 5, tileBytes, NULL);
+        clSetKernelArg(stepKernel, 6, localSize[0] * localSize[1] * sizeof(cl_float), NULL);
+        clSetKernelArg(stepKernel, 7, sizeof(cl_mem), (void*) &d_grid[1 - current]);
+        clSetKernelArg(stepKernel, 8, sizeof(cl_mem), (void*) &d_residuals);
+
+        ret = clEnqueueNDRangeKernel(queue, stepKernel, 2, NULL, globalSizes, localSize, 0, NULL, NULL);
+        if (ret != CL_SUCCESS)
+            break;
+
+        current = 1 - current;
+        *steps += launchSteps;
+        launches++;
+
+        if (launches % max(checkInterval, 1) != 0 && *steps < maxSteps)
+            continue;
+
+        // convergence check - reduce per work group changes to one value
+        clSetKernelArg(reduceKernel, 0, sizeof(cl_mem), (void*) &d_residuals);
+        clSetKernelArg(reduceKernel, 1, sizeof(cl_int), (void*) &numGroups);
+        clSetKernelArg(reduceKernel, 2, reduceSize * sizeof(cl_float), NULL);
+        clSetKernelArg(reduceKernel, 3, sizeof(cl_mem), (void*) &d_residual);
+
+        ret = clEnqueueNDRangeKernel(queue, reduceKernel, 1, NULL, &reduceSize, &reduceSize, 0, NULL, NULL);
+        if (ret != CL_SUCCESS)
+            break;
+
+        ret = clEnqueueReadBuffer(queue, d_residual, CL_TRUE, 0, sizeof(cl_float), residual, 0, NULL, NULL);
+
+        if (*residual <= tolerance)
+            break;
+    }
+
+    if (ret == CL_SUCCESS)
+        ret = clEnqueueReadBuffer(queue, d_grid[current], CL_TRUE, 0, gridBytes, grid, 0, NULL, NULL);
+
+    if (ret != CL_SUCCESS)
+        cout << "jacobi_solve: " << ret << "\n";
+
+    clFinish(queue);
+
+    cl_mem buffers[] = {d_grid[0], d_grid[1], d_imageSize, d_residuals, d_residual};
+    for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++)
+        if (buffers[i])
+            clReleaseMemObject(buffers[i]);
+
+    clReleaseKernel(stepKernel);
+    clReleaseKernel(reduceKernel);
+    clReleaseCommandQueue(queue);
+
+    return ret;
+}
+
+
+void cpu_jacobi (float* grid, cl_int width, cl_int height, float alpha, cl_int steps)
+{
+    vector<float> next(grid, grid + (size_t) width * height);
+    float* src = grid;
+    float* dst = next.data();
+
+    for (int step = 0; step < steps; step++)
+    {
+        for (int y = 1; y < height - 1; y++)
+        {
+            for (int x = 1; x < width - 1; x++)
+            {
+                int center = x + y * width;
+                float value = src[center];
+
+                dst[center] = value + alpha * (src[center - 1] + src[center + 1] + src[center - width] + src[center + width] - 4.0f * value);
+            }
+        }
+
+        swap(src, dst);
+    }
+
+    if (src != grid)
+        copy(src, src + (size_t) width * height, grid);
+}
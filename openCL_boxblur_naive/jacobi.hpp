@@ -0,0 +1,27 @@
+// iterative heat diffusion (Jacobi) stencil with temporal blocking.
+
+#ifndef JACOBI_HPP
+#define JACOBI_HPP
+
+#include <CL/cl.h>
+
+// Advances a grid of width * height values by up to maxSteps time steps of
+//   u' = u + alpha * (left + right + up + down - 4 * u)
+// with fixed border values, using jacobi_temporal.cl (program).
+
+// Every launch advances stepsPerLaunch steps (fewer if the halo does not fit
+// into local memory). Launches ping-pong between two device buffers. Every
+// checkInterval launches, the largest change of a value in the last step is
+// reduced on the device and read by the host - this is the only point the
+// host waits for the device. The iteration stops once that change is at most
+// tolerance. steps and residual receive the number of steps done and the last
+// change read.
+cl_int jacobi_solve (cl_context context, cl_device_id device, cl_program program,
+                     float* grid, cl_int width, cl_int height, float alpha,
+                     cl_int stepsPerLaunch, cl_int checkInterval, float tolerance, cl_int maxSteps,
+                     cl_int* steps, float* residual);
+
+// native host implementation of steps time steps
+void cpu_jacobi (float* grid, cl_int width, cl_int height, float alpha, cl_int steps);
+
+#endif
@@ -0,0 +1,163 @@
+// An openCL kernel implementation of an iterative heat diffusion
+// (Jacobi) stencil with temporal blocking.
+
+// Takes a grid of width * height float values and advances it by
+// "steps" time steps of
+//   u' = u + alpha * (left + right + up + down - 4 * u)
+// per launch. alpha = 0.25 is the Jacobi iteration of the Laplace
+// equation; values above 0.25 are unstable. Values on the grid border
+// are fixed (Dirichlet boundary).
+
+// Every work group computes a tile of local size X * local size Y
+// values. It loads the tile plus a halo of "steps" values on every side
+// into local memory and runs all steps between two local buffers. Every
+// step shrinks the valid region by one value per side (a trapezoid in
+// time), so after the last step exactly the tile is left. Neighboring
+// tiles overlap by their halos and compute the halo values redundantly,
+// which costs less than a round trip through global memory per step.
+
+// Every work group also writes the largest change of one of its values
+// in the last step to residuals[group]. reduce_max combines them into one
+// value, so the host can check for convergence by reading a single float.
+
+
+// Launch with a 2D NDRange of (width, height) rounded up to whole work
+// groups - work items outside of the grid write nothing and add no
+// change to the residual. The host passes two local
+// buffers of (local size X + 2 * steps) * (local size Y + 2 * steps) values
+// and one of local size X * local size Y values (power of 2).
+__kernel void jacobi_steps (__global float* grid,
+                            __global int* imageSize,
+                            float alpha,
+                            int steps,
+                            __local float* tileA,
+                            __local float* tileB,
+                            __local float* scratch,
+                            __global float* output,
+                            __global float* residuals)
+{
+	int width = imageSize[0];
+	int height = imageSize[1];
+
+	// position of this work item in its work group
+	int localX = get_local_id(0);
+	int localY = get_local_id(1);
+	int localWidth = get_local_size(0);
+	int localHeight = get_local_size(1);
+
+	int localIndex = localX + localY * localWidth; // flattened work item index
+	int groupSize = localWidth * localHeight;
+
+	// size of tile in local memory including halo
+	int tileWidth = localWidth + 2 * steps;
+	int tileHeight = localHeight + 2 * steps;
+	int tileSize = tileWidth * tileHeight;
+
+	// grid position of the first tile value
+	int originX = (int) get_group_id(0) * localWidth - steps;
+	int originY = (int) get_group_id(1) * localHeight - steps;
+
+	// copy tile plus halo into local memory - values outside of the
+	// grid are never used because the border does not change
+	for (int index = localIndex; index < tileSize; index += groupSize)
+	{
+		int x = originX + index % tileWidth;
+		int y = originY + index / tileWidth;
+
+		tileA[index] = x < 0 || x >= width || y < 0 || y >= height ? 0.0f : grid[x + y * width];
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	__local float* src = tileA;
+	__local float* dst = tileB;
+
+	for (int step = 1; step <= steps; step++)
+	{
+		// values whose neighbors were computed by the previous step
+		int regionWidth = tileWidth - 2 * step;
+		int regionSize = regionWidth * (tileHeight - 2 * step);
+
+		for (int index = localIndex; index < regionSize; index += groupSize)
+		{
+			int tx = step + index % regionWidth;
+			int ty = step + index / regionWidth;
+			int center = tx + ty * tileWidth;
+
+			int x = originX + tx;
+			int y = originY + ty;
+
+			float value = src[center];
+
+			// border values are fixed
+			if (x > 0 && x < width - 1 && y > 0 && y < height - 1)
+				value += alpha * (src[center - 1] + src[center + 1] + src[center - tileWidth] + src[center + tileWidth] - 4.0f * value);
+
+			dst[center] = value;
+		}
+
+		// next step reads what all work items of this step wrote
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		__local float* swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	// src holds the last step, dst the step before
+	int center = (steps + localX) + (steps + localY) * tileWidth;
+	float value = src[center];
+
+	int x = originX + steps + localX;
+	int y = originY + steps + localY;
+
+	if (x < width && y < height)
+		output[x + y * width] = value;
+
+	// largest change in the work group - tree reduction in local memory
+	scratch[localIndex] = fabs(value - dst[center]);
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int offset = groupSize / 2; offset > 0; offset /= 2)
+	{
+		if (localIndex < offset)
+			scratch[localIndex] = fmax(scratch[localIndex], scratch[localIndex + offset]);
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	if (localIndex == 0)
+		residuals[get_group_id(0) + get_group_id(1) * get_num_groups(0)] = scratch[0];
+}
+
+
+// Largest of count values. Launch with a single work group of a
+// power of 2 size, the host passes one local value per work item.
+__kernel void reduce_max (__global float* values,
+                          int count,
+                          __local float* scratch,
+                          __global float* result)
+{
+	int lx = get_local_id(0);
+	int n = get_local_size(0);
+
+	// every work item combines every n-th value
+	float largest = 0.0f;
+
+	for (int i = lx; i < count; i += n)
+		largest = fmax(largest, values[i]);
+
+	scratch[lx] = largest;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int offset = n / 2; offset > 0; offset /= 2)
+	{
+		if (lx < offset)
+			scratch[lx] = fmax(scratch[lx], scratch[lx + offset]);
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	if (lx == 0)
+		result[0] = scratch[0];
+}
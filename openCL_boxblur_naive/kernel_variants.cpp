@@ -0,0 +1,81 @@
+// builds and caches specialized variants of a kernel program.
+
+#include <CL/cl.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "kernel_variants.hpp"
+#include "pixel_types.hpp"
+#include "program_cache.hpp"
+
+using namespace std;
+
+
+bool VariantParams::operator< (const VariantParams& other) const
+{
+    return memcmp(this, &other, sizeof(VariantParams)) < 0;
+}
+
+
+VariantCache::VariantCache (cl_context context, cl_device_id device, const char* source, const char* options, const char* cacheDir)
+    : context(context), device(device), source(source), options(options), cacheDir(cacheDir)
+{
+    clRetainContext(context);
+}
+
+
+VariantCache::~VariantCache ()
+{
+    for (map<VariantParams, cl_program>::iterator it = programs.begin(); it != programs.end(); ++it)
+        clReleaseProgram(it->second);
+
+    clReleaseContext(context);
+}
+
+
+string VariantCache::build_options (const VariantParams& params) const
+{
+    char defines[512];
+
+    // reciprocal of the mask size used by the direct kernels
+    cl_int mask[MASK_PARAMS];
+    mask_params(params.mask, mask);
+
+    snprintf(defines, sizeof(defines),
+             " -D IMAGE_WIDTH=%d -D IMAGE_HEIGHT=%d -D IMAGE_PITCH=%d"
+             " -D MASK_SIZE_LEFT=%d -D MASK_SIZE_UP=%d -D MASK_SIZE_RIGHT=%d -D MASK_SIZE_DOWN=%d"
+             " -D MASK_MULTIPLIER=%uu -D MASK_SHIFT1=%d -D MASK_SHIFT2=%d -D MASK_RECIPROCAL=as_float(%d)"
+             " -D BLOCK_WIDTH=%d -D BLOCK_HEIGHT=%d",
+             params.imageWidth, params.imageHeight, params.imagePitch,
+             params.mask[0], params.mask[1], params.mask[2], params.mask[3],
+             (cl_uint) mask[4], mask[5], mask[6], mask[7],
+             params.block[0], params.block[1]);
+
+    return options + defines;
+}
+
+
+cl_program VariantCache::get (const VariantParams& params, cl_int* ret)
+{
+    map<VariantParams, cl_program>::iterator it = programs.find(params);
+
+    if (it != programs.end())
+    {
+        *ret = CL_SUCCESS;
+        return it->second;
+    }
+
+    cl_program program = build_program(context, device, source.c_str(), build_options(params).c_str(), cacheDir, ret);
+
+    if (*ret != CL_SUCCESS)
+    {
+        if (program)
+            clReleaseProgram(program);
+
+        return NULL;
+    }
+
+    programs[params] = program;
+
+    return program;
+}
@@ -0,0 +1,50 @@
+// builds and caches specialized variants of a kernel program.
+
+#ifndef KERNEL_VARIANTS_HPP
+#define KERNEL_VARIANTS_HPP
+
+#include <CL/cl.h>
+#include <map>
+#include <string>
+
+// parameters baked into a specialized variant as build options
+struct VariantParams
+{
+    cl_int imageWidth;
+    cl_int imageHeight;
+    cl_int imagePitch; // row pitch in values
+    cl_int mask[4]; // left, up, right, down
+    cl_int block[2]; // block width, block height
+
+    bool operator< (const VariantParams& other) const;
+};
+
+// Builds a program once per parameter tuple, passing the parameters as
+// -D constants so the kernels do not need to read them from buffers.
+// Built programs are kept until the cache is destroyed.
+class VariantCache
+{
+public:
+    VariantCache (cl_context context, cl_device_id device, const char* source, const char* options, const char* cacheDir);
+    ~VariantCache ();
+
+    // returns the program for params, building it on first use (owned by the cache)
+    cl_program get (const VariantParams& params, cl_int* ret);
+
+    // build options used for params
+    std::string build_options (const VariantParams& params) const;
+
+private:
+    VariantCache (const VariantCache&);
+    VariantCache& operator= (const VariantCache&);
+
+    cl_context context;
+    cl_device_id device;
+    std::string source;
+    std::string options; // common build options of all variants
+    const char* cacheDir; // on-disk binary cache, may be NULL
+
+    std::map<VariantParams, cl_program> programs;
+};
+
+#endif
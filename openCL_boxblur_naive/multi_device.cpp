@@ -0,0 +1,340 @@
+// blurs one image on all openCL devices of a node at once.
+
+// A band with its halo is blurred as if it was a complete image (see
+// strip_stream.cpp). The kernel treats the band edges as image borders,
+// which only affects the halo rows - those are not downloaded.
+
+#include <CL/cl.h>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+#include "multi_device.hpp"
+#include "pixel_types.hpp"
+#include "program_cache.hpp"
+
+using namespace std;
+
+
+// buffers and events of one band
+struct Band
+{
+    cl_int firstRow, lastRow; // rows of the band
+    cl_int firstInput, lastInput; // rows uploaded including halo
+    cl_int imageSize[3]; // width, rows and row pitch of the uploaded part
+    cl_int blockSize[2];
+
+    cl_mem input, output, size, mask, block;
+    cl_event uploaded, downloaded;
+};
+
+
+static void release_device (SplitDevice* split)
+{
+    if (split->kernel)
+        clReleaseKernel(split->kernel);
+
+    if (split->program)
+        clReleaseProgram(split->program);
+
+    if (split->queue)
+        clReleaseCommandQueue(split->queue);
+
+    if (split->context)
+        clReleaseContext(split->context);
+
+    if (split->subDevice)
+        clReleaseDevice(split->device);
+}
+
+
+// create context, queue and kernel of a device and add it to devices
+static void add_device (cl_device_id device, bool subDevice, const string& name,
+                        const char* source, const char* options, const char* cacheDir, vector<SplitDevice>* devices)
+{
+    cl_int ret;
+
+    SplitDevice split;
+    split.device = device;
+    split.subDevice = subDevice;
+    split.name = name;
+    split.context = NULL;
+    split.queue = NULL;
+    split.program = NULL;
+    split.kernel = NULL;
+    split.rows = 0;
+
+    // first guess of the throughput - replaced by the measurement of the first run
+    cl_uint units = 1, clock = 1;
+    clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(cl_uint), &units, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_MAX_CLOCK_FREQUENCY, sizeof(cl_uint), &clock, NULL);
+    split.rowsPerMs = (double) max(units, 1u) * max(clock, 1u);
+
+    split.context = clCreateContext(NULL, 1, &device, NULL, NULL, &ret);
+
+    if (ret == CL_SUCCESS)
+        split.queue = clCreateCommandQueue(split.context, device, CL_QUEUE_PROFILING_ENABLE, &ret);
+
+    if (ret == CL_SUCCESS)
+        split.program = build_program(split.context, device, source, options, cacheDir, &ret);
+
+    if (ret == CL_SUCCESS)
+        split.kernel = clCreateKernel(split.program, "boxblur", &ret);
+
+    if (ret != CL_SUCCESS)
+    {
+        cout << "Skipping " << name << ": " << ret << "\n";
+        release_device(&split);
+
+        return;
+    }
+
+    devices->push_back(split);
+}
+
+
+vector<SplitDevice> open_split_devices (const char* source, const char* options, const char* cacheDir, cl_int cpuUnits)
+{
+    vector<SplitDevice> devices;
+
+    cl_uint numPlatforms = 0;
+    if (clGetPlatformIDs(0, NULL, &numPlatforms) != CL_SUCCESS || numPlatforms == 0)
+        return devices;
+
+    vector<cl_platform_id> platforms(numPlatforms);
+    clGetPlatformIDs(numPlatforms, platforms.data(), NULL);
+
+    for (cl_uint p = 0; p < numPlatforms; p++)
+    {
+        cl_uint numDevices = 0;
+        if (clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_ALL, 0, NULL, &numDevices) != CL_SUCCESS || numDevices == 0)
+            continue;
+
+        vector<cl_device_id> platformDevices(numDevices);
+        clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_ALL, numDevices, platformDevices.data(), NULL);
+
+        for (cl_uint d = 0; d < numDevices; d++)
+        {
+            cl_device_id device = platformDevices[d];
+
+            char name[256] = "";
+            clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(name), name, NULL);
+
+            cl_device_type type = 0;
+            clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof(cl_device_type), &type, NULL);
+
+            // split CPUs into sub-devices of cpuUnits compute units
+            cl_uint numSubDevices = 0;
+            cl_device_partition_property partition[] = {CL_DEVICE_PARTITION_EQUALLY, (cl_device_partition_property) cpuUnits, 0};
+
+            if ((type & CL_DEVICE_TYPE_CPU) && cpuUnits > 0 &&
+                clCreateSubDevices(device, partition, 0, NULL, &numSubDevices) == CL_SUCCESS && numSubDevices > 1)
+            {
+                vector<cl_device_id> subDevices(numSubDevices);
+
+                if (clCreateSubDevices(device, partition, numSubDevices, subDevices.data(), NULL) == CL_SUCCESS)
+                {
+                    for (cl_uint s = 0; s < numSubDevices; s++)
+                    {
+                        ostringstream subName;
+                        subName << name << " [" << s << "]";
+
+                        add_device(subDevices[s], true, subName.str(), source, options, cacheDir, &devices);
+                    }
+
+                    continue;
+                }
+            }
+
+            add_device(device, false, name, source, options, cacheDir, &devices);
+        }
+    }
+
+    return devices;
+}
+
+
+void close_split_devices (vector<SplitDevice>* devices)
+{
+    for (size_t i = 0; i < devices->size(); i++)
+        release_device(&(*devices)[i]);
+
+    devices->clear();
+}
+
+
+// band heights proportional to the throughput of every device
+static void balance_bands (vector<SplitDevice>& devices, cl_int height)
+{
+    double total = 0;
+    for (size_t i = 0; i < devices.size(); i++)
+        total += devices[i].rowsPerMs;
+
+    // round the band boundaries, so the heights always add up to height
+    double sum = 0;
+    cl_int first = 0;
+
+    for (size_t i = 0; i < devices.size(); i++)
+    {
+        sum += devices[i].rowsPerMs;
+        cl_int last = i + 1 == devices.size() ? height : (cl_int) (height * sum / total + 0.5);
+
+        devices[i].rows = last - first;
+        first = last;
+    }
+}
+
+
+static void release_band (Band* band)
+{
+    cl_mem* mems[] = {&band->input, &band->output, &band->size, &band->mask, &band->block};
+
+    for (size_t i = 0; i < sizeof(mems) / sizeof(mems[0]); i++)
+        if (*mems[i])
+            clReleaseMemObject(*mems[i]);
+
+    if (band->uploaded)
+        clReleaseEvent(band->uploaded);
+
+    if (band->downloaded)
+        clReleaseEvent(band->downloaded);
+}
+
+
+// enqueue upload, kernel and download of one band without waiting for them
+static cl_int enqueue_band (SplitDevice& split, Band* band, const cl_int* image, cl_int* output, cl_int width, const cl_int* k)
+{
+    cl_int ret;
+    size_t rowBytes = (size_t) width * sizeof(cl_int);
+    size_t inputBytes = (band->lastInput - band->firstInput) * rowBytes;
+
+    band->input = clCreateBuffer(split.context, CL_MEM_READ_ONLY, inputBytes, NULL, &ret);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    band->output = clCreateBuffer(split.context, CL_MEM_WRITE_ONLY, inputBytes, NULL, &ret);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    band->size = clCreateBuffer(split.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, 3 * sizeof(cl_int), band->imageSize, &ret);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    // mask dimensions and the reciprocal of the mask size
+    cl_int params[MASK_PARAMS];
+    mask_params(k, params);
+
+    band->mask = clCreateBuffer(split.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(params), params, &ret);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    band->block = clCreateBuffer(split.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, 2 * sizeof(cl_int), band->blockSize, &ret);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    ret = clEnqueueWriteBuffer(split.queue, band->input, CL_FALSE, 0, inputBytes, image + (size_t) band->firstInput * width,
+                               0, NULL, &band->uploaded);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    clSetKernelArg(split.kernel, 0, sizeof(cl_mem), (void*) &band->input);
+    clSetKernelArg(split.kernel, 1, sizeof(cl_mem), (void*) &band->size);
+    clSetKernelArg(split.kernel, 2, sizeof(cl_mem), (void*) &band->mask);
+    clSetKernelArg(split.kernel, 3, sizeof(cl_mem), (void*) &band->block);
+    clSetKernelArg(split.kernel, 4, sizeof(cl_int), NULL); // local memory is not used
+    clSetKernelArg(split.kernel, 5, sizeof(cl_mem), (void*) &band->output);
+
+    // one work item per pixel of the band including halo
+    const size_t globalSizes[2] = {(size_t) width, (size_t) (band->lastInput - band->firstInput)};
+
+    ret = clEnqueueNDRangeKernel(split.queue, split.kernel, 2, NULL, globalSizes, NULL, 0, NULL, NULL);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    // download band rows without halo
+    ret = clEnqueueReadBuffer(split.queue, band->output, CL_FALSE,
+                              (band->firstRow - band->firstInput) * rowBytes, // skip upper halo
+                              (band->lastRow - band->firstRow) * rowBytes,
+                              output + (size_t) band->firstRow * width,
+                              0, NULL, &band->downloaded);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    // start the device right away - the next device is set up meanwhile
+    return clFlush(split.queue);
+}
+
+
+cl_int split_blur (vector<SplitDevice>& devices, const cl_int* image, cl_int* output,
+                   cl_int width, cl_int height, const cl_int* k)
+{
+    cl_int ret = CL_SUCCESS;
+
+    balance_bands(devices, height);
+
+    vector<Band> bands(devices.size());
+    cl_int firstRow = 0;
+
+    for (size_t i = 0; i < devices.size(); i++)
+    {
+        Band& band = bands[i];
+
+        band.firstRow = firstRow;
+        band.lastRow = firstRow + devices[i].rows;
+        band.firstInput = max(band.firstRow - k[1], 0);
+        band.lastInput = min(band.lastRow + k[3], height);
+
+        band.imageSize[0] = width;
+        band.imageSize[1] = band.lastInput - band.firstInput;
+        band.imageSize[2] = width; // packed rows
+
+        band.blockSize[0] = 1;
+        band.blockSize[1] = 1;
+
+        band.input = band.output = band.size = band.mask = band.block = NULL;
+        band.uploaded = band.downloaded = NULL;
+
+        firstRow = band.lastRow;
+
+        // devices without rows sit this one out
+        if (ret == CL_SUCCESS && devices[i].rows > 0)
+            ret = enqueue_band(devices[i], &band, image, output, width, k);
+    }
+
+    for (size_t i = 0; i < devices.size(); i++)
+    {
+        Band& band = bands[i];
+
+        if (!band.downloaded)
+            continue;
+
+        cl_int waited = clWaitForEvents(1, &band.downloaded);
+
+        if (waited != CL_SUCCESS)
+        {
+            ret = waited;
+            continue;
+        }
+
+        // throughput of the whole band including transfers
+        cl_ulong start, end;
+        clGetEventProfilingInfo(band.uploaded, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start, NULL);
+        clGetEventProfilingInfo(band.downloaded, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, NULL);
+
+        double milliseconds = (end - start) * 1e-6;
+
+        if (milliseconds > 0)
+            devices[i].rowsPerMs = devices[i].rows / milliseconds;
+    }
+
+    for (size_t i = 0; i < devices.size(); i++)
+    {
+        clFinish(devices[i].queue);
+        release_band(&bands[i]);
+    }
+
+    if (ret != CL_SUCCESS)
+        cout << "split_blur: " << ret << "\n";
+
+    return ret;
+}
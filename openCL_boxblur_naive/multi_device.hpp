@@ -0,0 +1,45 @@
+// blurs one image on all openCL devices of a node at once.
+
+#ifndef MULTI_DEVICE_HPP
+#define MULTI_DEVICE_HPP
+
+#include <CL/cl.h>
+#include <string>
+#include <vector>
+
+// a device (or sub-device) taking part in a split blur
+struct SplitDevice
+{
+    cl_device_id device;
+    bool subDevice; // created by clCreateSubDevices, released with the device
+    std::string name;
+
+    cl_context context; // one context per device - devices may belong to different platforms
+    cl_command_queue queue; // with profiling enabled
+    cl_program program;
+    cl_kernel kernel;
+
+    double rowsPerMs; // throughput of the last split_blur (before: estimate from compute units and clock)
+    cl_int rows; // band height of the last split_blur
+};
+
+// Opens every device of every platform and builds source (a kernel "boxblur"
+// with the arguments of boxblur_naive.cl) for it. CPU devices are split into
+// sub-devices of cpuUnits compute units each (cpuUnits == 0 or partitioning
+// not supported: whole device), every sub-device gets its own queue.
+// Devices whose context, queue or program cannot be created are skipped.
+std::vector<SplitDevice> open_split_devices (const char* source, const char* options, const char* cacheDir, cl_int cpuUnits);
+
+void close_split_devices (std::vector<SplitDevice>* devices);
+
+// Blurs an image of width * height values on all devices at once. The image
+// is split into one band of rows per device, with band heights proportional
+// to rowsPerMs. Every band is uploaded with its up/down halo rows, so the
+// devices do not need to exchange anything. All devices run in parallel, each
+// on its own queue. Afterwards, rows and rowsPerMs hold the band height and
+// measured throughput (upload to download) of every device, so repeated calls
+// rebalance the bands.
+cl_int split_blur (std::vector<SplitDevice>& devices, const cl_int* image, cl_int* output,
+                   cl_int width, cl_int height, const cl_int* k);
+
+#endif
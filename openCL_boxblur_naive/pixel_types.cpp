@@ -0,0 +1,228 @@
+// pixel types of the direct kernels and division-free normalization of mask sums.
+
+#include <CL/cl.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "pixel_types.hpp"
+#include "cpu_boxblur.hpp"
+
+using namespace std;
+
+static const char* pixelNames[] = {"int", "uint8", "uint16", "float", "half"};
+static const size_t pixelSizes[] = {sizeof(cl_int), sizeof(cl_uchar), sizeof(cl_ushort), sizeof(cl_float), sizeof(cl_half)};
+static const char* pixelOptions[] = {
+    "",
+    "-D PIXEL=uchar -D SUM=uint",
+    "-D PIXEL=ushort -D SUM=uint",
+    "-D PIXEL=float -D SUM=float -D FLOAT_SUM",
+    "-D PIXEL=half -D SUM=float -D FLOAT_SUM -D HALF_PIXEL"
+};
+
+
+int pixel_type (const char* name)
+{
+    for (int i = 0; i < (int) (sizeof(pixelNames) / sizeof(pixelNames[0])); i++)
+        if (strcmp(name, pixelNames[i]) == 0)
+            return i;
+
+    return -1;
+}
+
+
+const char* pixel_name (int pixelType)
+{
+    return pixelNames[pixelType];
+}
+
+
+size_t pixel_size (int pixelType)
+{
+    return pixelSizes[pixelType];
+}
+
+
+const char* pixel_build_options (int pixelType)
+{
+    return pixelOptions[pixelType];
+}
+
+
+void mask_params (const cl_int* k, cl_int* params)
+{
+    cl_uint masksize = (k[0] + 1 + k[2]) * (k[1] + 1 + k[3]); // +1 because of "middle" element
+
+    // smallest l with 2^l >= masksize
+    int l = 0;
+    while (((cl_ulong) 1 << l) < masksize)
+        l++;
+
+    // multiplier = floor(2^32 * (2^l - masksize) / masksize) + 1, fits into 32 bits
+    cl_uint multiplier = (cl_uint) (((((cl_ulong) 1 << l) - masksize) << 32) / masksize + 1);
+    cl_float reciprocal = 1.0f / masksize;
+
+    copy(k, k + 4, params);
+    params[4] = (cl_int) multiplier;
+    params[5] = min(l, 1);
+    params[6] = max(l - 1, 0);
+    memcpy(&params[7], &reciprocal, sizeof(cl_float));
+}
+
+
+cl_half float_to_half (float value)
+{
+    cl_uint bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    cl_uint sign = (bits >> 16) & 0x8000;
+    cl_uint mantissa = bits & 0x7fffff;
+    int exponent = (int) ((bits >> 23) & 0xff) - 127 + 15; // rebiased for half
+
+    // infinity and NaN (kept quiet)
+    if (((bits >> 23) & 0xff) == 0xff)
+        return (cl_half) (sign | 0x7c00 | (mantissa ? 0x200 | (mantissa >> 13) : 0));
+
+    if (exponent >= 0x1f)
+        return (cl_half) (sign | 0x7c00);
+
+    cl_uint half;
+    cl_uint rest;
+    cl_uint halfway;
+
+    if (exponent <= 0)
+    {
+        // below 2^-25 - rounds to zero
+        if (exponent < -10)
+            return (cl_half) sign;
+
+        // subnormal: units of 2^-24, implicit leading bit included
+        int shift = 14 - exponent;
+        mantissa |= 0x800000;
+
+        half = mantissa >> shift;
+        rest = mantissa & ((1u << shift) - 1);
+        halfway = 1u << (shift - 1);
+    }
+    else
+    {
+        half = ((cl_uint) exponent << 10) | (mantissa >> 13);
+        rest = mantissa & 0x1fff;
+        halfway = 0x1000;
+    }
+
+    // round to nearest even - a carry moves on to the next exponent (or infinity)
+    if (rest > halfway || (rest == halfway && (half & 1)))
+        half++;
+
+    return (cl_half) (sign | half);
+}
+
+
+float half_to_float (cl_half value)
+{
+    cl_uint sign = (cl_uint) (value & 0x8000) << 16;
+    cl_uint exponent = (value >> 10) & 0x1f;
+    cl_uint mantissa = value & 0x3ff;
+    cl_uint bits;
+
+    if (exponent == 0)
+    {
+        // zero or subnormal - mantissa units of 2^-24 are exact in float
+        float magnitude = mantissa * (1.0f / 16777216.0f);
+        return sign ? -magnitude : magnitude;
+    }
+
+    if (exponent == 0x1f)
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    else
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+
+    return result;
+}
+
+
+void pixels_from_int (const cl_int* values, void* pixels, size_t count, int pixelType)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        switch (pixelType)
+        {
+        case PIXEL_INT: ((cl_int*) pixels)[i] = values[i]; break;
+        case PIXEL_UINT8: ((cl_uchar*) pixels)[i] = (cl_uchar) values[i]; break;
+        case PIXEL_UINT16: ((cl_ushort*) pixels)[i] = (cl_ushort) values[i]; break;
+        case PIXEL_FLOAT: ((cl_float*) pixels)[i] = (cl_float) values[i]; break;
+        case PIXEL_HALF: ((cl_half*) pixels)[i] = float_to_half((float) values[i]); break;
+        }
+    }
+}
+
+
+double pixel_value (const void* pixels, size_t i, int pixelType)
+{
+    switch (pixelType)
+    {
+    case PIXEL_UINT8: return ((const cl_uchar*) pixels)[i];
+    case PIXEL_UINT16: return ((const cl_ushort*) pixels)[i];
+    case PIXEL_FLOAT: return ((const cl_float*) pixels)[i];
+    case PIXEL_HALF: return half_to_float(((const cl_half*) pixels)[i]);
+    default: return ((const cl_int*) pixels)[i];
+    }
+}
+
+
+void cpu_boxblur_pixels (const void* image, void* output, int width, int height, const cl_int* k, int pixelType)
+{
+    size_t count = (size_t) width * height;
+
+    if (pixelType != PIXEL_FLOAT && pixelType != PIXEL_HALF)
+    {
+        // integer sums rounded toward zero - the fixed-point reciprocal is exact
+        vector<cl_int> values (count);
+        vector<cl_int> blurred (count);
+
+        for (size_t i = 0; i < count; i++)
+            values[i] = (cl_int) pixel_value(image, i, pixelType);
+
+        cpu_boxblur(values.data(), blurred.data(), width, height, k, 0);
+        pixels_from_int(blurred.data(), output, count, pixelType);
+
+        return;
+    }
+
+    cl_int params[MASK_PARAMS];
+    mask_params(k, params);
+
+    cl_float reciprocal;
+    memcpy(&reciprocal, &params[7], sizeof(reciprocal));
+
+    // sums in double - exact wherever the float sums of the kernels are
+    vector<double> rowsums (count, 0);
+
+    for (int row = 0; row < height; row++)
+        for (int col = 0; col < width; col++)
+            for (int c_col = max(col - k[0], 0); c_col <= min(col + k[2], width - 1); c_col++)
+                rowsums[col + (size_t) row * width] += pixel_value(image, c_col + (size_t) row * width, pixelType);
+
+    for (int row = 0; row < height; row++)
+    {
+        for (int col = 0; col < width; col++)
+        {
+            double sum = 0;
+
+            for (int c_row = max(row - k[1], 0); c_row <= min(row + k[3], height - 1); c_row++)
+                sum += rowsums[col + (size_t) c_row * width];
+
+            cl_float value = (cl_float) sum * reciprocal;
+            size_t i = col + (size_t) row * width;
+
+            if (pixelType == PIXEL_FLOAT)
+                ((cl_float*) output)[i] = value;
+            else
+                ((cl_half*) output)[i] = float_to_half(value);
+        }
+    }
+}
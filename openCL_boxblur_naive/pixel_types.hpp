@@ -0,0 +1,57 @@
+// pixel types of the direct kernels and division-free normalization of mask sums.
+
+#ifndef PIXEL_TYPES_HPP
+#define PIXEL_TYPES_HPP
+
+#include <CL/cl.h>
+#include <stddef.h>
+
+// Pixel types of boxblur_naive.cl, boxblur_blocking.cl, boxblur_blocking_local.cl
+// and boxblur_vector.cl, defined in pixel_types.clh. Mask sums are accumulated
+// in a 32 bit type wide enough for the pixels, so local memory per value stays
+// sizeof(cl_int).
+#define PIXEL_INT 0 // cl_int, sums in cl_int - the default of the kernels
+#define PIXEL_UINT8 1 // cl_uchar, sums in cl_uint
+#define PIXEL_UINT16 2 // cl_ushort, sums in cl_uint (masks of up to 65537 values)
+#define PIXEL_FLOAT 3 // cl_float, sums in cl_float
+#define PIXEL_HALF 4 // cl_half, sums in cl_float - converted by vload_half/vstore_half, so no cl_khr_fp16 needed
+
+// type by name ("int", "uint8", "uint16", "float", "half"), -1 if unknown
+int pixel_type (const char* name);
+const char* pixel_name (int pixelType);
+
+// bytes per pixel
+size_t pixel_size (int pixelType);
+
+// build options selecting the pixel type in the kernels ("" for PIXEL_INT)
+const char* pixel_build_options (int pixelType);
+
+// Values of the mask argument k of the direct kernels:
+//   0 - 3: left, up, right, down
+//   4 - 6: multiplier and shifts dividing a 32 bit sum by the mask size
+//          exactly, rounding toward zero (Granlund/Montgomery):
+//          t = mulhi(sum, multiplier), sum / masksize = (t + ((sum - t) >> shift1)) >> shift2
+//   7:     bits of the float reciprocal 1.0f / masksize (float sums)
+#define MASK_PARAMS 8
+
+// fill params (MASK_PARAMS values) for mask dimensions k
+void mask_params (const cl_int* k, cl_int* params);
+
+// IEEE 754 half precision conversion, rounding to nearest even like vstore_half
+cl_half float_to_half (float value);
+float half_to_float (cl_half value);
+
+// convert count int values into pixels of pixelType
+void pixels_from_int (const cl_int* values, void* pixels, size_t count, int pixelType);
+
+// pixel i as double
+double pixel_value (const void* pixels, size_t i, int pixelType);
+
+// Native host implementation for width * height pixels (rows are packed)
+// with the results of the kernels: integer pixels are blurred by cpu_boxblur,
+// float and half sums are multiplied by the float reciprocal of the mask
+// size. Float results are identical as long as all sums are exact in float
+// (integer values below 2^24), else they depend on the order of summation.
+void cpu_boxblur_pixels (const void* image, void* output, int width, int height, const cl_int* k, int pixelType);
+
+#endif
@@ -19,133 +19,232 @@
 #define PNG_DEBUG 3
 #include <png.h> // libpng
 
-void abort_(const char * s, ...)
+#include "png_ops.hpp"
+
+static bool error_(const char * s, ...)
 {
         va_list args;
         va_start(args, s);
         vfprintf(stderr, s, args);
         fprintf(stderr, "\n");
         va_end(args);
-        abort();
+        return false;
 }
 
-int x, y;
+static void free_rows(PngRows* image)
+{
+        if (!image->row_pointers)
+                return;
 
-int width, height;
-png_byte color_type;
-png_byte bit_depth;
+        for (int y=0; y<image->height; y++)
+                free(image->row_pointers[y]);
+        free(image->row_pointers);
 
-png_structp png_ptr;
-png_infop info_ptr;
-int number_of_passes;
-png_bytep* row_pointers;
+        image->row_pointers = NULL;
+}
 
-void read_png_file(char* file_name)
+bool read_png_file(const char* file_name, PngRows* image)
 {
-        char header[8];    // 8 is the maximum size that can be checked
+        png_byte header[8];    // 8 is the maximum size that can be checked
+
+        image->row_pointers = NULL;
 
         /* open file and test for it being a png */
         FILE *fp = fopen(file_name, "rb");
         if (!fp)
-                abort_("[read_png_file] File %s could not be opened for reading", file_name);
-        fread(header, 1, 8, fp);
-        if (png_sig_cmp(header, 0, 8))
-                abort_("[read_png_file] File %s is not recognized as a PNG file", file_name);
+                return error_("[read_png_file] File %s could not be opened for reading", file_name);
+        if (fread(header, 1, 8, fp) != 8 || png_sig_cmp(header, 0, 8))
+        {
+                fclose(fp);
+                return error_("[read_png_file] File %s is not recognized as a PNG file", file_name);
+        }
 
 
         /* initialize stuff */
-        png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+        png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 
         if (!png_ptr)
-                abort_("[read_png_file] png_create_read_struct failed");
+        {
+                fclose(fp);
+                return error_("[read_png_file] png_create_read_struct failed");
+        }
 
-        info_ptr = png_create_info_struct(png_ptr);
+        png_infop info_ptr = png_create_info_struct(png_ptr);
         if (!info_ptr)
-                abort_("[read_png_file] png_create_info_struct failed");
+        {
+                png_destroy_read_struct(&png_ptr, NULL, NULL);
+                fclose(fp);
+                return error_("[read_png_file] png_create_info_struct failed");
+        }
 
+        /* libpng jumps back here on any error below */
         if (setjmp(png_jmpbuf(png_ptr)))
-                abort_("[read_png_file] Error during init_io");
+        {
+                free_rows(image);
+                png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+                fclose(fp);
+                return error_("[read_png_file] Error while reading %s", file_name);
+        }
 
         png_init_io(png_ptr, fp);
         png_set_sig_bytes(png_ptr, 8);
 
         png_read_info(png_ptr, info_ptr);
 
-        width = png_get_image_width(png_ptr, info_ptr);
-        height = png_get_image_height(png_ptr, info_ptr);
-        color_type = png_get_color_type(png_ptr, info_ptr);
-        bit_depth = png_get_bit_depth(png_ptr, info_ptr);
-
-        number_of_passes = png_set_interlace_handling(png_ptr);
+        image->width = png_get_image_width(png_ptr, info_ptr);
+        image->height = png_get_image_height(png_ptr, info_ptr);
+        png_byte color_type = png_get_color_type(png_ptr, info_ptr);
+        png_byte bit_depth = png_get_bit_depth(png_ptr, info_ptr);
+
+        /* normalize to 8 bit grayscale or 8 bit RGBA */
+        int has_trns = png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS);
+
+        if (color_type == PNG_COLOR_TYPE_PALETTE)
+                png_set_palette_to_rgb(png_ptr);
+        if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8)
+                png_set_expand_gray_1_2_4_to_8(png_ptr);
+        if (has_trns)
+                png_set_tRNS_to_alpha(png_ptr);
+        if (bit_depth == 16)
+                png_set_strip_16(png_ptr);
+        if (color_type == PNG_COLOR_TYPE_GRAY_ALPHA ||
+            (color_type == PNG_COLOR_TYPE_GRAY && has_trns))
+                png_set_gray_to_rgb(png_ptr);
+        if ((color_type == PNG_COLOR_TYPE_RGB || color_type == PNG_COLOR_TYPE_PALETTE) && !has_trns)
+                png_set_filler(png_ptr, 0xFF, PNG_FILLER_AFTER);
+
+        png_set_interlace_handling(png_ptr);
         png_read_update_info(png_ptr, info_ptr);
 
+        image->color_type = png_get_color_type(png_ptr, info_ptr);
+        image->bit_depth = png_get_bit_depth(png_ptr, info_ptr);
 
-        /* read file */
-        if (setjmp(png_jmpbuf(png_ptr)))
-                abort_("[read_png_file] Error during read_image");
 
-        row_pointers = (png_bytep*) malloc(sizeof(png_bytep) * height);
-        for (y=0; y<height; y++)
-                row_pointers[y] = (png_byte*) malloc(png_get_rowbytes(png_ptr,info_ptr));
+        /* read file */
+        image->row_pointers = (png_bytep*) calloc(image->height, sizeof(png_bytep));
+        for (int y=0; y<image->height; y++)
+                image->row_pointers[y] = (png_byte*) malloc(png_get_rowbytes(png_ptr,info_ptr));
 
-        png_read_image(png_ptr, row_pointers);
+        png_read_image(png_ptr, image->row_pointers);
 
+        png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
         fclose(fp);
+
+        return true;
 }
 
 
-void write_png_file(char* file_name)
+bool write_png_file(const char* file_name, PngRows* image)
 {
         /* create file */
         FILE *fp = fopen(file_name, "wb");
         if (!fp)
-                abort_("[write_png_file] File %s could not be opened for writing", file_name);
+        {
+                free_rows(image);
+                return error_("[write_png_file] File %s could not be opened for writing", file_name);
+        }
 
 
         /* initialize stuff */
-        png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+        png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 
         if (!png_ptr)
-                abort_("[write_png_file] png_create_write_struct failed");
+        {
+                free_rows(image);
+                fclose(fp);
+                return error_("[write_png_file] png_create_write_struct failed");
+        }
 
-        info_ptr = png_create_info_struct(png_ptr);
+        png_infop info_ptr = png_create_info_struct(png_ptr);
         if (!info_ptr)
-                abort_("[write_png_file] png_create_info_struct failed");
-
+        {
+                png_destroy_write_struct(&png_ptr, NULL);
+                free_rows(image);
+                fclose(fp);
+                return error_("[write_png_file] png_create_info_struct failed");
+        }
+
+        /* libpng jumps back here on any error below */
         if (setjmp(png_jmpbuf(png_ptr)))
-                abort_("[write_png_file] Error during init_io");
+        {
+                png_destroy_write_struct(&png_ptr, &info_ptr);
+                free_rows(image);
+                fclose(fp);
+                return error_("[write_png_file] Error while writing %s", file_name);
+        }
 
         png_init_io(png_ptr, fp);
 
 
         /* write header */
-        if (setjmp(png_jmpbuf(png_ptr)))
-                abort_("[write_png_file] Error during writing header");
-
-        png_set_IHDR(png_ptr, info_ptr, width, height,
-                     bit_depth, color_type, PNG_INTERLACE_NONE,
+        png_set_IHDR(png_ptr, info_ptr, image->width, image->height,
+                     image->bit_depth, image->color_type, PNG_INTERLACE_NONE,
                      PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
 
         png_write_info(png_ptr, info_ptr);
 
 
         /* write bytes */
-        if (setjmp(png_jmpbuf(png_ptr)))
-                abort_("[write_png_file] Error during writing bytes");
-
-        png_write_image(png_ptr, row_pointers);
+        png_write_image(png_ptr, image->row_pointers);
 
 
         /* end write */
-        if (setjmp(png_jmpbuf(png_ptr)))
-                abort_("[write_png_file] Error during end of write");
-
         png_write_end(png_ptr, NULL);
 
         /* cleanup heap allocation */
-        for (y=0; y<height; y++)
-                free(row_pointers[y]);
-        free(row_pointers);
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        free_rows(image);
 
         fclose(fp);
+
+        return true;
+}
+
+
+unsigned char* load_png(const char* file_name, int* image_width, int* image_height, int* channels)
+{
+        PngRows image;
+
+        if (!read_png_file(file_name, &image))
+                return NULL;
+
+        *image_width = image.width;
+        *image_height = image.height;
+        *channels = image.color_type == PNG_COLOR_TYPE_GRAY ? 1 : 4;
+
+        size_t row_size = (size_t) image.width * *channels;
+        unsigned char* pixels = (unsigned char*) malloc(row_size * image.height);
+
+        /* copy rows into one contiguous buffer */
+        if (pixels)
+                for (int y=0; y<image.height; y++)
+                        memcpy(pixels + y * row_size, image.row_pointers[y], row_size);
+        else
+                error_("[load_png] Could not allocate %d x %d pixels", image.width, image.height);
+
+        free_rows(&image);
+
+        return pixels;
+}
+
+
+bool save_png(const char* file_name, const unsigned char* pixels, int image_width, int image_height, int channels)
+{
+        PngRows image;
+        image.width = image_width;
+        image.height = image_height;
+        image.color_type = channels == 1 ? PNG_COLOR_TYPE_GRAY : PNG_COLOR_TYPE_RGBA;
+        image.bit_depth = 8;
+
+        size_t row_size = (size_t) image_width * channels;
+
+        /* write_png_file frees the rows */
+        image.row_pointers = (png_bytep*) malloc(sizeof(png_bytep) * image_height);
+        for (int y=0; y<image_height; y++)
+        {
+                image.row_pointers[y] = (png_byte*) malloc(row_size);
+                memcpy(image.row_pointers[y], pixels + y * row_size, row_size);
+        }
+
+        return write_png_file(file_name, &image);
 }
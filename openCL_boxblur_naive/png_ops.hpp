@@ -0,0 +1,31 @@
+// defines operations on PNG images, using libpng.
+
+#ifndef PNG_OPS_HPP
+#define PNG_OPS_HPP
+
+// rows of one PNG image - every read or write has its own, so any number
+// of threads can read and write files at the same time
+struct PngRows
+{
+    int width;
+    int height;
+    unsigned char color_type; // PNG_COLOR_TYPE_*
+    unsigned char bit_depth;
+    unsigned char** row_pointers; // height malloc'ed rows
+};
+
+// read/write a PNG file (read images are normalized to 8 bit grayscale or
+// 8 bit RGBA, write_png_file frees the rows). On failure, the reason is
+// printed to stderr and false is returned.
+bool read_png_file(const char* file_name, PngRows* image);
+bool write_png_file(const char* file_name, PngRows* image);
+
+// Load a PNG file as 8 bit grayscale (channels = 1) or 8 bit RGBA (channels = 4).
+// Returns a malloc'ed buffer of width * height * channels bytes, row by row,
+// or NULL if the file cannot be read.
+unsigned char* load_png(const char* file_name, int* image_width, int* image_height, int* channels);
+
+// save width * height pixels with 1 (grayscale) or 4 (RGBA) channels as PNG file
+bool save_png(const char* file_name, const unsigned char* pixels, int image_width, int image_height, int channels);
+
+#endif
@@ -0,0 +1,151 @@
+// collects host and device timings and writes them as JSON or CSV report.
+
+// Device times are given in ns relative to the first queued command,
+// host times in ms relative to the first host phase. Every record holds
+// its duration, effective bandwidth (GB/s) and throughput (megapixels/s).
+
+#include <CL/cl.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "profiling.hpp"
+
+using namespace std;
+
+
+double host_time_ms ()
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+ProfileReport::ProfileReport (cl_int width, cl_int height)
+    : width(width), height(height)
+{
+}
+
+
+ProfileReport::~ProfileReport ()
+{
+    for (size_t i = 0; i < entries.size(); i++)
+        if (entries[i].event)
+            clReleaseEvent(entries[i].event);
+}
+
+
+void ProfileReport::add_host (const char* name, double startMs, double endMs)
+{
+    Entry entry = {name, NULL, startMs, endMs, 0, 0};
+    entries.push_back(entry);
+}
+
+
+void ProfileReport::add_event (const char* name, cl_event event, size_t bytes, size_t pixels)
+{
+    clRetainEvent(event);
+
+    Entry entry = {name, event, 0, 0, bytes, pixels};
+    entries.push_back(entry);
+}
+
+
+bool ProfileReport::write (const char* path) const
+{
+    FILE* file = fopen(path, "w");
+
+    if (!file)
+        return false;
+
+    size_t len = strlen(path);
+    bool csv = len >= 4 && strcmp(path + len - 4, ".csv") == 0;
+
+    // reference points for relative times
+    cl_ulong firstQueued = 0;
+    double firstHost = 0;
+    bool haveDevice = false;
+    bool haveHost = false;
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (entries[i].event)
+        {
+            clWaitForEvents(1, &entries[i].event);
+
+            cl_ulong queued;
+            clGetEventProfilingInfo(entries[i].event, CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &queued, NULL);
+
+            if (!haveDevice || queued < firstQueued)
+                firstQueued = queued;
+
+            haveDevice = true;
+        }
+        else if (!haveHost || entries[i].hostStart < firstHost)
+        {
+            firstHost = entries[i].hostStart;
+            haveHost = true;
+        }
+    }
+
+    if (csv)
+        fprintf(file, "name,type,queued_ns,submit_ns,start_ns,end_ns,duration_ms,bytes,gb_per_s,megapixels_per_s\n");
+    else
+        fprintf(file, "{\n  \"width\": %d,\n  \"height\": %d,\n  \"records\": [", width, height);
+
+    double deviceMs = 0;
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const Entry& entry = entries[i];
+        cl_ulong times[4] = {0, 0, 0, 0}; // queued, submit, start, end
+        double duration;
+
+        if (entry.event)
+        {
+            clGetEventProfilingInfo(entry.event, CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &times[0], NULL);
+            clGetEventProfilingInfo(entry.event, CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &times[1], NULL);
+            clGetEventProfilingInfo(entry.event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &times[2], NULL);
+            clGetEventProfilingInfo(entry.event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &times[3], NULL);
+
+            for (int t = 0; t < 4; t++)
+                times[t] -= firstQueued;
+
+            duration = (times[3] - times[2]) * 1e-6;
+            deviceMs += duration;
+        }
+        else
+        {
+            // host phases have no queue - queued/submit/start are the same
+            times[0] = times[1] = times[2] = (cl_ulong) ((entry.hostStart - firstHost) * 1e6);
+            times[3] = (cl_ulong) ((entry.hostEnd - firstHost) * 1e6);
+            duration = entry.hostEnd - entry.hostStart;
+        }
+
+        double seconds = duration * 1e-3;
+        double gbps = seconds > 0 ? entry.bytes / seconds * 1e-9 : 0;
+        double mpps = seconds > 0 ? entry.pixels / seconds * 1e-6 : 0;
+        const char* type = entry.event ? "device" : "host";
+
+        if (csv)
+            fprintf(file, "%s,%s,%llu,%llu,%llu,%llu,%.6f,%zu,%.3f,%.3f\n",
+                    entry.name.c_str(), type,
+                    (unsigned long long) times[0], (unsigned long long) times[1],
+                    (unsigned long long) times[2], (unsigned long long) times[3],
+                    duration, entry.bytes, gbps, mpps);
+        else
+            fprintf(file, "%s\n    {\"name\": \"%s\", \"type\": \"%s\", \"queued_ns\": %llu, \"submit_ns\": %llu, "
+                          "\"start_ns\": %llu, \"end_ns\": %llu, \"duration_ms\": %.6f, \"bytes\": %zu, "
+                          "\"gb_per_s\": %.3f, \"megapixels_per_s\": %.3f}",
+                    i == 0 ? "" : ",", entry.name.c_str(), type,
+                    (unsigned long long) times[0], (unsigned long long) times[1],
+                    (unsigned long long) times[2], (unsigned long long) times[3],
+                    duration, entry.bytes, gbps, mpps);
+    }
+
+    if (!csv)
+        fprintf(file, "\n  ],\n  \"device_ms\": %.6f\n}\n", deviceMs);
+
+    fclose(file);
+
+    return true;
+}
@@ -0,0 +1,52 @@
+// collects host and device timings and writes them as JSON or CSV report.
+
+#ifndef PROFILING_HPP
+#define PROFILING_HPP
+
+#include <CL/cl.h>
+#include <string>
+#include <vector>
+
+// milliseconds since an arbitrary fixed point, for timing host phases
+double host_time_ms ();
+
+// One report per run. Device commands are added with their events (the
+// command queue needs CL_QUEUE_PROFILING_ENABLE), host phases with their
+// start and end time. Events are retained until the report is destroyed,
+// their times are read when the report is written.
+class ProfileReport
+{
+public:
+    ProfileReport (cl_int width, cl_int height);
+    ~ProfileReport ();
+
+    // host phase, e.g. source load or program build
+    void add_host (const char* name, double startMs, double endMs);
+
+    // device command - bytes is the amount of data transferred (or read
+    // and written by a kernel), pixels the number of pixels processed
+    void add_event (const char* name, cl_event event, size_t bytes, size_t pixels);
+
+    // write report as CSV if path ends in ".csv", else as JSON
+    bool write (const char* path) const;
+
+private:
+    ProfileReport (const ProfileReport&);
+    ProfileReport& operator= (const ProfileReport&);
+
+    struct Entry
+    {
+        std::string name;
+        cl_event event; // NULL for host phases
+        double hostStart; // host phases only (ms)
+        double hostEnd;
+        size_t bytes;
+        size_t pixels;
+    };
+
+    std::vector<Entry> entries;
+    cl_int width;
+    cl_int height;
+};
+
+#endif
@@ -0,0 +1,273 @@
+// builds openCL programs and caches their binaries on disk.
+
+#include <CL/cl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+
+#include "program_cache.hpp"
+
+using namespace std;
+
+
+// FNV-1a hash, continued from a previous hash value
+static uint64_t hash_bytes (uint64_t hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*) data;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+
+// hash a string including its terminating 0, so "ab" + "c" differs from "a" + "bc"
+static uint64_t hash_string (uint64_t hash, const char* str)
+{
+    return hash_bytes(hash, str, strlen(str) + 1);
+}
+
+
+// query a string property of a device
+static string device_string (cl_device_id device, cl_device_info param)
+{
+    size_t len = 0;
+    clGetDeviceInfo(device, param, 0, NULL, &len);
+
+    string value(len, '\0');
+    clGetDeviceInfo(device, param, len, &value[0], NULL);
+
+    return value;
+}
+
+
+// name of cache file for a source/options/device combination
+static string cache_path (cl_device_id device, const char* source, const char* options, const char* cacheDir)
+{
+    cl_platform_id platform;
+    clGetDeviceInfo(device, CL_DEVICE_PLATFORM, sizeof(cl_platform_id), &platform, NULL);
+
+    size_t len = 0;
+    clGetPlatformInfo(platform, CL_PLATFORM_NAME, 0, NULL, &len);
+    string platformName(len, '\0');
+    clGetPlatformInfo(platform, CL_PLATFORM_NAME, len, &platformName[0], NULL);
+
+    uint64_t hash = 14695981039346656037ULL; // FNV offset basis
+    hash = hash_string(hash, source);
+    hash = hash_string(hash, options ? options : ""); // NULL options build like ""
+    hash = hash_string(hash, platformName.c_str());
+    hash = hash_string(hash, device_string(device, CL_DEVICE_NAME).c_str());
+    hash = hash_string(hash, device_string(device, CL_DRIVER_VERSION).c_str());
+
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long) hash);
+
+    return string(cacheDir) + name;
+}
+
+
+// print build log of a program
+static void print_build_log (cl_program program, cl_device_id device)
+{
+    size_t len = 0;
+    char* buffer;
+
+    // check length of build log string
+    clGetProgramBuildInfo(program, // program object to request info on
+                          device, // device whose log to request
+                          CL_PROGRAM_BUILD_LOG, // type of information to request
+                          0, // memory pointer to which information is written
+                          NULL, // size of returned information
+                          &len); // pointer to memory where to save length of returned string
+
+    buffer = static_cast<char*>(calloc(len, sizeof(char)));
+
+    // copy build log to buffer
+    clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, len, buffer, NULL);
+
+    // print build log
+    fprintf(stderr, "%s\n", buffer);
+
+    free(buffer);
+}
+
+
+// try to create and build a program from a cached binary, returns NULL if not possible
+static cl_program load_binary (cl_context context, cl_device_id device, const char* options, const string& path)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+
+    if (!file)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+
+    if (size <= 0)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    unsigned char* binary = (unsigned char*) malloc(size);
+    size_t res = fread(binary, 1, size, file);
+    fclose(file);
+
+    if (res != (size_t) size)
+    {
+        free(binary);
+        return NULL;
+    }
+
+    size_t binarySize = size;
+    cl_int binaryStatus;
+    cl_int ret;
+
+    cl_program program = clCreateProgramWithBinary(context,
+                                                   1, // number of devices
+                                                   &device, // list of devices
+                                                   &binarySize, // size of each binary
+                                                   (const unsigned char**) &binary, // one binary per device
+                                                   &binaryStatus, // load status per device
+                                                   &ret); // return value
+    free(binary);
+
+    if (ret != CL_SUCCESS || binaryStatus != CL_SUCCESS)
+    {
+        if (program)
+            clReleaseProgram(program);
+
+        return NULL;
+    }
+
+    // binaries still need to be built (linked) for the device
+    ret = clBuildProgram(program, 1, &device, options, NULL, NULL);
+
+    if (ret != CL_SUCCESS)
+    {
+        clReleaseProgram(program);
+        return NULL;
+    }
+
+    return program;
+}
+
+
+// store the binary of a built program, written to a uniquely named
+// temporary file first so concurrent runs never read half-written
+// binaries or write to the same temporary file
+static void store_binary (cl_program program, const char* cacheDir, const string& path)
+{
+    size_t binarySize = 0;
+
+    if (clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &binarySize, NULL) != CL_SUCCESS || binarySize == 0)
+        return;
+
+    unsigned char* binary = (unsigned char*) malloc(binarySize);
+
+    if (clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(unsigned char*), &binary, NULL) == CL_SUCCESS)
+    {
+        mkdir(cacheDir, 0755); // fails harmlessly if directory exists
+
+        string tempPath = path + ".XXXXXX";
+        int fd = mkstemp(&tempPath[0]);
+
+        if (fd != -1)
+            fchmod(fd, 0644); // mkstemp creates files only readable by the owner
+
+        FILE* file = fd != -1 ? fdopen(fd, "wb") : NULL;
+
+        if (file)
+        {
+            size_t res = fwrite(binary, 1, binarySize, file);
+
+            if (fclose(file) == 0 && res == binarySize)
+                rename(tempPath.c_str(), path.c_str());
+            else
+                remove(tempPath.c_str());
+        }
+        else if (fd != -1)
+        {
+            close(fd);
+            remove(tempPath.c_str());
+        }
+    }
+
+    free(binary);
+}
+
+
+cl_program build_program (cl_context context, cl_device_id device, const char* source, const char* options, const char* cacheDir, cl_int* ret)
+{
+    string path;
+
+    // read_source returns NULL for missing kernel files
+    if (!source)
+    {
+        cout << "build_program: no kernel source\n";
+        *ret = CL_INVALID_VALUE;
+
+        return NULL;
+    }
+
+    // callers like the benchmark may have no options at all
+    if (!options)
+        options = "";
+
+    if (cacheDir)
+    {
+        path = cache_path(device, source, options, cacheDir);
+        cl_program program = load_binary(context, device, options, path);
+
+        if (program)
+        {
+            *ret = CL_SUCCESS;
+            return program;
+        }
+    }
+
+    // no (usable) cached binary - build from source
+    size_t source_size = strlen(source) * sizeof(char);
+
+    cl_program program = clCreateProgramWithSource(context,
+                                                   1, // number of program strings
+                                                   &source, // kernel source code
+                                                   &source_size, // size of string
+                                                   ret); // return value
+    if (*ret != CL_SUCCESS)
+    {
+        cout << "clCreateProgramWithSource: " << *ret << "\n";
+        return program;
+    }
+
+    *ret = clBuildProgram (program, // program object
+                           1, // number of devices
+                           &device, // list of devices
+                           options, // compiler options
+                           NULL, // callback function pointer for debug output
+                           NULL); // callback function arguments
+
+    // if build failed, output debug info
+    if (*ret != CL_SUCCESS)
+    {
+        cout << "clBuildProgram: " << *ret << "\n";
+        print_build_log(program, device);
+
+        return program;
+    }
+
+    if (cacheDir)
+        store_binary(program, cacheDir, path);
+
+    return program;
+}
@@ -0,0 +1,19 @@
+// builds openCL programs and caches their binaries on disk.
+
+#ifndef PROGRAM_CACHE_HPP
+#define PROGRAM_CACHE_HPP
+
+#include <CL/cl.h>
+
+// Builds a program from source for one device. If cacheDir is not NULL,
+// the program binary is stored in cacheDir, keyed by a hash of source,
+// build options, platform name, device name and driver version. Later
+// calls with the same key load the binary instead of compiling the source.
+// A cached binary that cannot be loaded or built is replaced by a new source build.
+// As with clBuildProgram, options may be NULL. A NULL source (e.g. a kernel
+// file that could not be read) returns NULL with ret = CL_INVALID_VALUE.
+
+// On failure, the build log is printed and ret holds the error code.
+cl_program build_program (cl_context context, cl_device_id device, const char* source, const char* options, const char* cacheDir, cl_int* ret);
+
+#endif
@@ -0,0 +1,598 @@
+// weighted stencils and a generator for specialized openCL kernels applying them.
+
+// The generated kernel uses the blocking strategy of boxblur_blocking.cl:
+// every work item computes a block of BLOCK_WIDTH * BLOCK_HEIGHT pixels.
+// Taps are grouped by row, so every input row is bounds checked once per
+// output pixel and every tap only checks its column.
+
+#include <CL/cl.h>
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#include "stencil.hpp"
+#include "host_utils.hpp"
+
+using namespace std;
+
+// descriptions of the built-in stencils
+static const char* builtinNames[] = {"box", "sobel_x", "sobel_y", "laplacian", "sharpen", "box3d", "laplacian3d"};
+static const char* builtinStencils[] = {
+    // 3x3 box blur - same as mask {1, 1, 1, 1}
+    "divisor 9\n"
+    "matrix 3 3\n"
+    "1 1 1\n"
+    "1 1 1\n"
+    "1 1 1\n",
+
+    // horizontal gradient
+    "matrix 3 3\n"
+    "-1 0 1\n"
+    "-2 0 2\n"
+    "-1 0 1\n",
+
+    // vertical gradient
+    "matrix 3 3\n"
+    "-1 -2 -1\n"
+    " 0  0  0\n"
+    " 1  2  1\n",
+
+    "matrix 3 3\n"
+    "0  1 0\n"
+    "1 -4 1\n"
+    "0  1 0\n",
+
+    "matrix 3 3\n"
+    " 0 -1  0\n"
+    "-1  5 -1\n"
+    " 0 -1  0\n",
+
+    // 3x3x3 box blur - same as volume mask {1, 1, 1, 1, 1, 1}
+    "divisor 27\n"
+    "plane -1\n"
+    "matrix 3 3\n"
+    "1 1 1\n"
+    "1 1 1\n"
+    "1 1 1\n"
+    "plane 0\n"
+    "matrix 3 3\n"
+    "1 1 1\n"
+    "1 1 1\n"
+    "1 1 1\n"
+    "plane 1\n"
+    "matrix 3 3\n"
+    "1 1 1\n"
+    "1 1 1\n"
+    "1 1 1\n",
+
+    // 7 point laplacian
+    "plane -1\n"
+    "tap 0 0 1\n"
+    "plane 0\n"
+    "matrix 3 3\n"
+    "0  1 0\n"
+    "1 -6 1\n"
+    "0  1 0\n"
+    "plane 1\n"
+    "tap 0 0 1\n"
+};
+
+
+bool parse_stencil (const string& description, Stencil* stencil, string* error)
+{
+    istringstream in(description);
+    string line;
+    int lineNumber = 0;
+
+    // weights per offset (dz, dy, dx) - sorted by plane, then row, then column
+    map<tuple<cl_int, cl_int, cl_int>, cl_int> weights;
+    cl_int divisor = 1;
+    cl_int dz = 0; // plane of the following matrices and taps
+
+    while (getline(in, line))
+    {
+        lineNumber++;
+
+        // strip comment
+        line = line.substr(0, line.find('#'));
+
+        istringstream fields(line);
+        string keyword;
+
+        if (!(fields >> keyword))
+            continue;
+
+        ostringstream where;
+        where << "line " << lineNumber << ": ";
+
+        if (keyword == "divisor")
+        {
+            if (!(fields >> divisor) || divisor == 0)
+            {
+                *error = where.str() + "divisor has to be a non-zero integer";
+                return false;
+            }
+        }
+        else if (keyword == "tap")
+        {
+            cl_int dx, dy, weight;
+
+            if (!(fields >> dx >> dy >> weight))
+            {
+                *error = where.str() + "expected \"tap <dx> <dy> <weight>\"";
+                return false;
+            }
+
+            weights[make_tuple(dz, dy, dx)] += weight;
+        }
+        else if (keyword == "plane")
+        {
+            if (!(fields >> dz))
+            {
+                *error = where.str() + "expected \"plane <dz>\"";
+                return false;
+            }
+        }
+        else if (keyword == "matrix")
+        {
+            cl_int w, h, cx, cy;
+
+            if (!(fields >> w >> h) || w <= 0 || h <= 0)
+            {
+                *error = where.str() + "expected \"matrix <w> <h> [<cx> <cy>]\"";
+                return false;
+            }
+
+            // output pixel defaults to the center
+            if (!(fields >> cx >> cy))
+            {
+                cx = w / 2;
+                cy = h / 2;
+            }
+
+            for (cl_int row = 0; row < h; row++)
+            {
+                if (!getline(in, line))
+                {
+                    *error = where.str() + "matrix has fewer rows than its height";
+                    return false;
+                }
+
+                lineNumber++;
+                istringstream values(line.substr(0, line.find('#')));
+
+                for (cl_int col = 0; col < w; col++)
+                {
+                    cl_int weight;
+
+                    if (!(values >> weight))
+                    {
+                        ostringstream message;
+                        message << "line " << lineNumber << ": expected " << w << " weights";
+                        *error = message.str();
+                        return false;
+                    }
+
+                    weights[make_tuple(dz, row - cy, col - cx)] += weight;
+                }
+            }
+        }
+        else
+        {
+            *error = where.str() + "unknown keyword \"" + keyword + "\"";
+            return false;
+        }
+    }
+
+    stencil->taps.clear();
+    stencil->divisor = divisor;
+
+    for (map<tuple<cl_int, cl_int, cl_int>, cl_int>::const_iterator it = weights.begin(); it != weights.end(); ++it)
+    {
+        if (it->second == 0)
+            continue;
+
+        StencilTap tap = {get<2>(it->first), get<1>(it->first), it->second, get<0>(it->first)};
+        stencil->taps.push_back(tap);
+    }
+
+    if (stencil->taps.empty())
+    {
+        *error = "stencil has no non-zero weights";
+        return false;
+    }
+
+    return true;
+}
+
+
+bool load_stencil (const char* name, Stencil* stencil)
+{
+    string description;
+    bool builtin = false;
+
+    for (size_t i = 0; i < sizeof(builtinNames) / sizeof(builtinNames[0]); i++)
+    {
+        if (string(name) == builtinNames[i])
+        {
+            description = builtinStencils[i];
+            builtin = true;
+        }
+    }
+
+    if (!builtin)
+    {
+        if (!read_file(name, &description))
+        {
+            cout << "load_stencil: " << name << " is neither a built-in stencil nor a readable file\n";
+            return false;
+        }
+    }
+
+    string error;
+
+    if (!parse_stencil(description, stencil, &error))
+    {
+        cout << "load_stencil: " << name << ": " << error << "\n";
+        return false;
+    }
+
+    stencil->name = name;
+
+    return true;
+}
+
+
+bool stencil_is_planar (const Stencil& stencil)
+{
+    for (size_t i = 0; i < stencil.taps.size(); i++)
+        if (stencil.taps[i].dz != 0)
+            return false;
+
+    return true;
+}
+
+
+void stencil_extent (const Stencil& stencil, cl_int* k)
+{
+    k[0] = k[1] = k[2] = k[3] = 0;
+
+    for (size_t i = 0; i < stencil.taps.size(); i++)
+    {
+        k[0] = max(k[0], -stencil.taps[i].dx);
+        k[1] = max(k[1], -stencil.taps[i].dy);
+        k[2] = max(k[2], stencil.taps[i].dx);
+        k[3] = max(k[3], stencil.taps[i].dy);
+    }
+}
+
+
+void stencil_extent_volume (const Stencil& stencil, cl_int* k)
+{
+    stencil_extent(stencil, k);
+    k[4] = k[5] = 0;
+
+    for (size_t i = 0; i < stencil.taps.size(); i++)
+    {
+        k[4] = max(k[4], -stencil.taps[i].dz);
+        k[5] = max(k[5], stencil.taps[i].dz);
+    }
+}
+
+
+// "row", "row + 2" or "row - 2" for offset 0, 2 or -2
+static string offset_expr (const char* name, cl_int offset)
+{
+    ostringstream expr;
+    expr << name;
+
+    if (offset > 0)
+        expr << " + " << offset;
+    else if (offset < 0)
+        expr << " - " << -offset;
+
+    return expr.str();
+}
+
+
+string generate_stencil_source (const Stencil& stencil)
+{
+    ostringstream src;
+
+    src << "// generated by generate_stencil_source - stencil \"" << stencil.name << "\"\n"
+        << "// " << stencil.taps.size() << " taps, divisor " << stencil.divisor << "\n\n"
+        << "// compile-time kernel parameters of specialized variants (see boxblur_naive.cl)\n"
+        << "#ifndef IMAGE_WIDTH\n#define IMAGE_WIDTH imageSize[0]\n#endif\n"
+        << "#ifndef IMAGE_HEIGHT\n#define IMAGE_HEIGHT imageSize[1]\n#endif\n"
+        << "#ifndef IMAGE_PITCH\n#define IMAGE_PITCH imageSize[2]\n#endif\n"
+        << "#ifndef BLOCK_WIDTH\n#define BLOCK_WIDTH blockSize[0]\n#endif\n"
+        << "#ifndef BLOCK_HEIGHT\n#define BLOCK_HEIGHT blockSize[1]\n#endif\n\n"
+        << "// value of the current input row at column col + dx - neutral element 0 if out of bounds\n"
+        << "#define VALUE(dx) (col + (dx) >= 0 && col + (dx) < IMAGE_WIDTH ? in[col + (dx)] : 0)\n\n\n"
+        << "__kernel void boxblur (__global int* image,\n"
+        << "                       __global int* imageSize,\n"
+        << "                       __global int* k, // not needed, the stencil is inlined\n"
+        << "                       __global int* blockSize,\n"
+        << "                       __local int* localmem, // not needed but kept so host code can stay unchanged\n"
+        << "                       __global int* output)\n"
+        << "{\n"
+        << "\tint blockX = get_global_id(0) * BLOCK_WIDTH; // x position of first element in block\n"
+        << "\tint blockY = get_global_id(1) * BLOCK_HEIGHT; // y position of first element in block\n\n"
+        << "\tint blockWidth = BLOCK_WIDTH;\n"
+        << "\tint blockHeight = BLOCK_HEIGHT;\n\n"
+        << "\tfor (int i = 0; i < blockHeight; i++)\n"
+        << "\t{\n"
+        << "\t\tfor (int j = 0; j < blockWidth; j++)\n"
+        << "\t\t{\n"
+        << "\t\t\tint col = blockX + j;\n"
+        << "\t\t\tint row = blockY + i;\n\n"
+        << "\t\t\t// block or work item beyond the edge of the image\n"
+        << "\t\t\tif (col >= IMAGE_WIDTH || row >= IMAGE_HEIGHT)\n"
+        << "\t\t\t\tcontinue;\n\n"
+        << "\t\t\tint sum = 0;\n"
+        << "\t\t\t__global int* in;\n";
+
+    // taps are sorted by row - one bounds check per input row
+    for (size_t i = 0; i < stencil.taps.size(); )
+    {
+        cl_int dy = stencil.taps[i].dy;
+        string inputRow = offset_expr("row", dy);
+
+        src << "\n"
+            << "\t\t\tif (" << inputRow << " >= 0 && " << inputRow << " < IMAGE_HEIGHT)\n"
+            << "\t\t\t{\n"
+            << "\t\t\t\tin = image + (" << inputRow << ") * IMAGE_PITCH;\n";
+
+        for (; i < stencil.taps.size() && stencil.taps[i].dy == dy; i++)
+        {
+            const StencilTap& tap = stencil.taps[i];
+            cl_int weight = tap.weight < 0 ? -tap.weight : tap.weight;
+
+            src << "\t\t\t\tsum " << (tap.weight < 0 ? "-=" : "+=") << " ";
+
+            if (weight != 1)
+                src << weight << " * ";
+
+            src << "VALUE(" << tap.dx << ");\n";
+        }
+
+        src << "\t\t\t}\n";
+    }
+
+    src << "\n\t\t\toutput[col + row * IMAGE_PITCH] = ";
+
+    if (stencil.divisor == 1)
+        src << "sum;\n";
+    else
+        src << "sum / " << stencil.divisor << ";\n";
+
+    src << "\t\t}\n"
+        << "\t}\n"
+        << "}\n";
+
+    return src.str();
+}
+
+
+// apply stencil to image rows [firstRow, lastRow)
+static void stencil_band (const int* image, int* output, int width, int height, const Stencil* stencil, int firstRow, int lastRow)
+{
+    const vector<StencilTap>& taps = stencil->taps;
+
+    for (int row = firstRow; row < lastRow; row++)
+    {
+        for (int col = 0; col < width; col++)
+        {
+            int sum = 0;
+
+            for (size_t i = 0; i < taps.size(); i++)
+            {
+                int x = col + taps[i].dx;
+                int y = row + taps[i].dy;
+
+                if (x >= 0 && x < width && y >= 0 && y < height)
+                    sum += taps[i].weight * image[x + (size_t) y * width];
+            }
+
+            output[col + (size_t) row * width] = sum / stencil->divisor;
+        }
+    }
+}
+
+
+void cpu_stencil (const int* image, int* output, int width, int height, const Stencil& stencil, unsigned threads)
+{
+    // empty image - nothing to split into bands
+    if (width <= 0 || height <= 0)
+        return;
+
+    if (threads == 0)
+        threads = max(thread::hardware_concurrency(), 1u);
+
+    // no more threads than rows
+    threads = min(threads, (unsigned) height);
+
+    vector<thread> workers;
+    int bandHeight = (height + threads - 1) / threads;
+
+    for (int firstRow = 0; firstRow < height; firstRow += bandHeight)
+    {
+        int lastRow = min(firstRow + bandHeight, height);
+        workers.push_back(thread(stencil_band, image, output, width, height, &stencil, firstRow, lastRow));
+    }
+
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+
+// statements of the generated volume kernels loading plane z into the tile, the
+// same as in boxblur_volume.cl - planes outside of the volume are skipped (they add 0)
+static const char* volumeTileLoad =
+    "\t\t\t__global int* plane = volume + (size_t) z * width * height;\n\n"
+    "\t\t\t// no work item reads the previous plane any more\n"
+    "\t\t\tbarrier(CLK_LOCAL_MEM_FENCE);\n\n"
+    "\t\t\tfor (int i = localRow * localWidth + localCol; i < tileWidth * tileHeight; i += localWidth * localHeight)\n"
+    "\t\t\t{\n"
+    "\t\t\t\tint x = tileCol + i % tileWidth;\n"
+    "\t\t\t\tint y = tileRow + i / tileWidth;\n\n"
+    "\t\t\t\ttile[i] = x >= 0 && x < width && y >= 0 && y < height ? plane[x + y * width] : 0;\n"
+    "\t\t\t}\n\n"
+    "\t\t\tbarrier(CLK_LOCAL_MEM_FENCE);\n";
+
+
+string generate_volume_stencil_source (const Stencil& stencil)
+{
+    cl_int k[6];
+    stencil_extent_volume(stencil, k);
+
+    cl_int planes = k[4] + 1 + k[5];
+    ostringstream src;
+
+    src << "// generated by generate_volume_stencil_source - stencil \"" << stencil.name << "\"\n"
+        << "// " << stencil.taps.size() << " taps in " << planes << " planes, divisor " << stencil.divisor << "\n\n"
+        << "// reach of the stencil - the tile holds this halo around the work group\n"
+        << "#define LEFT " << k[0] << "\n#define UP " << k[1] << "\n#define RIGHT " << k[2] << "\n#define DOWN " << k[3] << "\n"
+        << "#define FRONT " << k[4] << "\n#define BACK " << k[5] << "\n\n"
+        << "// value at offset (dx, dy) from the current voxel in the current plane - the tile is zero outside of the volume\n"
+        << "#define VALUE(dx, dy) tile[(localRow + UP + (dy)) * tileWidth + localCol + LEFT + (dx)]\n\n\n"
+        << "__kernel void boxblur_volume (__global int* volume,\n"
+        << "                              __global int* volumeSize,\n"
+        << "                              __global int* k, // not needed, the stencil is inlined\n"
+        << "                              __global int* blockDepth,\n"
+        << "                              __local int* tile,\n"
+        << "                              __local int* ring, // not needed, partial sums are kept in registers\n"
+        << "                              __global int* output)\n"
+        << "{\n"
+        << "\tint width = volumeSize[0];\n"
+        << "\tint height = volumeSize[1];\n"
+        << "\tint depth = volumeSize[2];\n\n"
+        << "\tint col = get_global_id(0);\n"
+        << "\tint row = get_global_id(1);\n\n"
+        << "\tint localCol = get_local_id(0);\n"
+        << "\tint localRow = get_local_id(1);\n"
+        << "\tint localWidth = get_local_size(0);\n"
+        << "\tint localHeight = get_local_size(1);\n\n"
+        << "\tint tileCol = get_group_id(0) * localWidth - LEFT;\n"
+        << "\tint tileRow = get_group_id(1) * localHeight - UP;\n"
+        << "\tint tileWidth = localWidth + LEFT + RIGHT;\n"
+        << "\tint tileHeight = localHeight + UP + DOWN;\n\n"
+        << "\tint firstPlane = get_global_id(2) * blockDepth[0];\n"
+        << "\tint lastPlane = min(firstPlane + blockDepth[0], depth) - 1;\n\n"
+        << "\t// partial sums of output planes z - BACK (sum0) to z + FRONT while plane z is streamed\n"
+        << "\tint sum0 = 0";
+
+    for (cl_int j = 1; j < planes; j++)
+        src << ", sum" << j << " = 0";
+
+    src << ";\n\n"
+        << "\tfor (int z = firstPlane - FRONT; z <= lastPlane + BACK; z++)\n"
+        << "\t{\n"
+        << "\t\tif (z >= 0 && z < depth)\n"
+        << "\t\t{\n"
+        << volumeTileLoad;
+
+    // taps are sorted by plane - plane z is plane dz of output plane z - dz
+    for (size_t i = 0; i < stencil.taps.size(); )
+    {
+        cl_int dz = stencil.taps[i].dz;
+
+        src << "\n\t\t\t// plane " << dz << "\n";
+
+        for (; i < stencil.taps.size() && stencil.taps[i].dz == dz; i++)
+        {
+            const StencilTap& tap = stencil.taps[i];
+            cl_int weight = tap.weight < 0 ? -tap.weight : tap.weight;
+
+            src << "\t\t\tsum" << k[5] - dz << " " << (tap.weight < 0 ? "-=" : "+=") << " ";
+
+            if (weight != 1)
+                src << weight << " * ";
+
+            src << "VALUE(" << tap.dx << ", " << tap.dy << ");\n";
+        }
+    }
+
+    src << "\t\t}\n\n"
+        << "\t\t// plane z was the last one of output plane z - BACK\n"
+        << "\t\tint outPlane = z - BACK;\n\n"
+        << "\t\tif (outPlane >= firstPlane && col < width && row < height)\n"
+        << "\t\t\toutput[col + row * width + (size_t) outPlane * width * height] = ";
+
+    if (stencil.divisor == 1)
+        src << "sum0;\n\n";
+    else
+        src << "sum0 / " << stencil.divisor << ";\n\n";
+
+    src << "\t\t// next plane - the partial sums move on by one output plane\n\t\t";
+
+    for (cl_int j = 1; j < planes; j++)
+        src << "sum" << j - 1 << " = sum" << j << "; ";
+
+    src << "sum" << planes - 1 << " = 0;\n"
+        << "\t}\n"
+        << "}\n";
+
+    return src.str();
+}
+
+
+// apply stencil to volume planes [firstPlane, lastPlane)
+static void stencil_planes (const int* volume, int* output, int width, int height, int depth, const Stencil* stencil, int firstPlane, int lastPlane)
+{
+    const vector<StencilTap>& taps = stencil->taps;
+    size_t planeSize = (size_t) width * height;
+
+    for (int plane = firstPlane; plane < lastPlane; plane++)
+    {
+        for (int row = 0; row < height; row++)
+        {
+            for (int col = 0; col < width; col++)
+            {
+                int sum = 0;
+
+                for (size_t i = 0; i < taps.size(); i++)
+                {
+                    int x = col + taps[i].dx;
+                    int y = row + taps[i].dy;
+                    int z = plane + taps[i].dz;
+
+                    if (x >= 0 && x < width && y >= 0 && y < height && z >= 0 && z < depth)
+                        sum += taps[i].weight * volume[x + (size_t) y * width + z * planeSize];
+                }
+
+                output[col + (size_t) row * width + plane * planeSize] = sum / stencil->divisor;
+            }
+        }
+    }
+}
+
+
+void cpu_stencil_volume (const int* volume, int* output, int width, int height, int depth, const Stencil& stencil, unsigned threads)
+{
+    // empty volume - nothing to split into bands
+    if (width <= 0 || height <= 0 || depth <= 0)
+        return;
+
+    if (threads == 0)
+        threads = max(thread::hardware_concurrency(), 1u);
+
+    // no more threads than planes
+    threads = min(threads, (unsigned) depth);
+
+    vector<thread> workers;
+    int bandDepth = (depth + threads - 1) / threads;
+
+    for (int firstPlane = 0; firstPlane < depth; firstPlane += bandDepth)
+    {
+        int lastPlane = min(firstPlane + bandDepth, depth);
+        workers.push_back(thread(stencil_planes, volume, output, width, height, depth, &stencil, firstPlane, lastPlane));
+    }
+
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
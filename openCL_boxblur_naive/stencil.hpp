@@ -0,0 +1,75 @@
+// weighted stencils and a generator for specialized openCL kernels applying them.
+
+#ifndef STENCIL_HPP
+#define STENCIL_HPP
+
+#include <CL/cl.h>
+#include <string>
+#include <vector>
+
+// weight of the input value at offset (dx, dy, dz) from the output pixel -
+// dz is the plane offset of volume stencils and 0 for images
+struct StencilTap
+{
+    cl_int dx;
+    cl_int dy;
+    cl_int weight;
+    cl_int dz;
+};
+
+// output = (sum of weight * input over all taps) / divisor, rounding toward zero,
+// input values outside of the image use the neutral element 0
+struct Stencil
+{
+    std::string name;
+    std::vector<StencilTap> taps; // one tap per offset, no zero weights
+    cl_int divisor;
+};
+
+// Parses a stencil description. Lines are
+//   divisor <n>                  - default 1
+//   matrix <w> <h> [<cx> <cy>]   - followed by h lines of w weights; the output
+//                                  pixel is at column cx, row cy (default center)
+//   tap <dx> <dy> <weight>       - single weight at an offset
+//   plane <dz>                   - following matrices and taps belong to plane
+//                                  dz of a volume stencil (default 0)
+// and "#" starts a comment. Weights of the same offset are added, zero weights
+// are dropped. On failure, error describes the problem.
+bool parse_stencil (const std::string& description, Stencil* stencil, std::string* error);
+
+// Loads a built-in stencil (box, sobel_x, sobel_y, laplacian, sharpen and the
+// volume stencils box3d, laplacian3d) or, if name is none of them, a description file.
+bool load_stencil (const char* name, Stencil* stencil);
+
+// true if all taps lie in the plane of the output pixel (dz == 0) - the image
+// functions below ignore dz, volume stencils need the volume functions
+bool stencil_is_planar (const Stencil& stencil);
+
+// number of columns/rows the stencil reaches {left, up, right, down}
+void stencil_extent (const Stencil& stencil, cl_int* k);
+
+// number of columns/rows/planes a volume stencil reaches {left, up, right, down, front, back}
+void stencil_extent_volume (const Stencil& stencil, cl_int* k);
+
+// Generates openCL source of a kernel "boxblur" with the arguments of
+// boxblur_blocking.cl that applies the stencil. Weights, offsets and divisor
+// are inlined, so the mask buffer is not read and zero taps cost nothing.
+std::string generate_stencil_source (const Stencil& stencil);
+
+// native host implementation, rows are split into one band per thread
+// (threads == 0 uses all hardware threads)
+void cpu_stencil (const int* image, int* output, int width, int height, const Stencil& stencil, unsigned threads);
+
+// Generates openCL source of a kernel "boxblur_volume" with the arguments of
+// boxblur_volume.cl that applies a volume stencil with the same 2.5D blocking:
+// planes are streamed through a __local tile, and every plane adds its taps
+// to the partial sums of the output planes it belongs to. Those partial sums
+// are registers - one per plane of the stencil, shifted by one plane per
+// step - so the ring buffer argument is not used.
+std::string generate_volume_stencil_source (const Stencil& stencil);
+
+// native host implementation for volumes of width * height * depth values,
+// planes are split into one band per thread (threads == 0 uses all hardware threads)
+void cpu_stencil_volume (const int* volume, int* output, int width, int height, int depth, const Stencil& stencil, unsigned threads);
+
+#endif
@@ -0,0 +1,235 @@
+// blurs images in horizontal strips so device memory does not limit the image size.
+
+// A strip with its halo is blurred as if it was a complete image of
+// (halo + strip) rows. The kernel treats the strip edges as image
+// borders, which only affects the halo rows - those are not downloaded.
+// At the real image borders there is no halo, so the border rule of the
+// kernel applies as usual.
+
+#include <CL/cl.h>
+#include <algorithm>
+#include <iostream>
+
+#include "strip_stream.hpp"
+
+#define STREAM_SLOTS 2 // sets of device buffers (2 = double buffering)
+
+using namespace std;
+
+
+cl_int stream_strip_rows (cl_device_id device, cl_int width, cl_int height, cl_int pixelBytes, const cl_int* k)
+{
+    cl_ulong globalMem, maxAlloc;
+    clGetDeviceInfo(device, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(cl_ulong), &globalMem, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(cl_ulong), &maxAlloc, NULL);
+
+    cl_ulong rowBytes = (cl_ulong) width * pixelBytes;
+    cl_int halo = k[1] + k[3];
+
+    // use half of device memory for input and output buffers of all slots,
+    // no single buffer may exceed the maximum allocation size
+    cl_ulong rows = (globalMem / 2) / (2 * STREAM_SLOTS * rowBytes);
+    rows = min(rows, maxAlloc / rowBytes);
+
+    if (rows <= (cl_ulong) halo)
+        return 1;
+
+    return (cl_int) min(rows - halo, (cl_ulong) height);
+}
+
+
+cl_int stream_blur (cl_context context, cl_device_id device, cl_kernel kernel,
+                    const unsigned char* image, unsigned char* output,
+                    cl_int width, cl_int height, cl_int pixelBytes, const cl_int* k, cl_int stripRows)
+{
+    cl_int ret = CL_SUCCESS;
+
+    if (stripRows <= 0)
+        stripRows = stream_strip_rows(device, width, height, pixelBytes, k);
+
+    stripRows = min(stripRows, height);
+
+    int up = k[1];
+    int down = k[3];
+
+    size_t rowBytes = (size_t) width * pixelBytes;
+    size_t slotBytes = (size_t) (up + stripRows + down) * rowBytes;
+    int strips = (height + stripRows - 1) / stripRows;
+
+    cout << "Streaming " << strips << " strips of " << stripRows << " rows\n";
+
+    // separate queues for upload, kernel and download
+    cl_command_queue queues[3] = {NULL, NULL, NULL};
+
+    for (int i = 0; i < 3; i++)
+    {
+        queues[i] = clCreateCommandQueue(context, device, 0, &ret);
+
+        if (ret != CL_SUCCESS)
+        {
+            cout << "stream_blur: clCreateCommandQueue: " << ret << "\n";
+
+            for (int j = 0; j < i; j++)
+                clReleaseCommandQueue(queues[j]);
+
+            return ret;
+        }
+    }
+
+    cl_command_queue uploadQueue = queues[0];
+    cl_command_queue computeQueue = queues[1];
+    cl_command_queue downloadQueue = queues[2];
+
+    cl_mem d_masksize = clCreateBuffer(context, CL_MEM_READ_ONLY, 4 * sizeof(cl_int), NULL, &ret);
+    clEnqueueWriteBuffer(uploadQueue, d_masksize, CL_TRUE, 0, 4 * sizeof(cl_int), k, 0, NULL, NULL);
+
+    // per-slot buffers and size of the image part held by the slot
+    cl_mem d_strip[STREAM_SLOTS];
+    cl_mem d_blurred[STREAM_SLOTS];
+    cl_mem d_stripSize[STREAM_SLOTS];
+    cl_int h_stripSize[STREAM_SLOTS][2];
+
+    // last download of each slot - the slot may only be reused after it
+    cl_event downloaded[STREAM_SLOTS];
+
+    // last upload of h_stripSize of each slot - the non-blocking write reads
+    // h_stripSize until it completes, so the host may only change it after that
+    cl_event sizeUploaded[STREAM_SLOTS];
+
+    for (int slot = 0; slot < STREAM_SLOTS; slot++)
+    {
+        d_strip[slot] = NULL;
+        d_blurred[slot] = NULL;
+        d_stripSize[slot] = NULL;
+        downloaded[slot] = NULL;
+        sizeUploaded[slot] = NULL;
+    }
+
+    for (int slot = 0; slot < STREAM_SLOTS; slot++)
+    {
+        d_strip[slot] = clCreateBuffer(context, CL_MEM_READ_ONLY, slotBytes, NULL, &ret);
+        d_blurred[slot] = clCreateBuffer(context, CL_MEM_WRITE_ONLY, slotBytes, NULL, &ret);
+        d_stripSize[slot] = clCreateBuffer(context, CL_MEM_READ_ONLY, 2 * sizeof(cl_int), NULL, &ret);
+
+        if (ret != CL_SUCCESS)
+        {
+            cout << "stream_blur: could not allocate strip buffers: " << ret << "\n";
+            break;
+        }
+    }
+
+    for (int strip = 0; strip < strips && ret == CL_SUCCESS; strip++)
+    {
+        int slot = strip % STREAM_SLOTS;
+
+        // rows of this strip and rows uploaded including halo
+        int firstRow = strip * stripRows;
+        int lastRow = min(firstRow + stripRows, height);
+        int firstInput = max(firstRow - up, 0);
+        int lastInput = min(lastRow + down, height);
+
+        if (sizeUploaded[slot])
+        {
+            clWaitForEvents(1, &sizeUploaded[slot]);
+            clReleaseEvent(sizeUploaded[slot]);
+            sizeUploaded[slot] = NULL;
+        }
+
+        h_stripSize[slot][0] = width;
+        h_stripSize[slot][1] = lastInput - firstInput;
+
+        cl_uint waitCount = downloaded[slot] ? 1 : 0;
+        cl_event uploaded[2];
+        cl_event computed;
+        cl_event done;
+
+        // upload strip once the previous strip of this slot has been downloaded
+        ret = clEnqueueWriteBuffer(uploadQueue, d_stripSize[slot], CL_FALSE, 0, 2 * sizeof(cl_int), h_stripSize[slot],
+                                   waitCount, waitCount ? &downloaded[slot] : NULL, &uploaded[0]);
+        if (ret != CL_SUCCESS)
+            break;
+
+        clRetainEvent(uploaded[0]);
+        sizeUploaded[slot] = uploaded[0];
+
+        ret = clEnqueueWriteBuffer(uploadQueue, d_strip[slot], CL_FALSE, 0, (lastInput - firstInput) * rowBytes,
+                                   image + firstInput * rowBytes,
+                                   waitCount, waitCount ? &downloaded[slot] : NULL, &uploaded[1]);
+        if (ret != CL_SUCCESS)
+        {
+            clReleaseEvent(uploaded[0]);
+            break;
+        }
+
+        clFlush(uploadQueue);
+
+        if (downloaded[slot])
+            clReleaseEvent(downloaded[slot]);
+
+        downloaded[slot] = NULL;
+
+        // blur strip including halo rows
+        clSetKernelArg(kernel, 0, sizeof(cl_mem), (void*) &d_strip[slot]);
+        clSetKernelArg(kernel, 1, sizeof(cl_mem), (void*) &d_stripSize[slot]);
+        clSetKernelArg(kernel, 2, sizeof(cl_mem), (void*) &d_masksize);
+        clSetKernelArg(kernel, 3, sizeof(cl_mem), (void*) &d_blurred[slot]);
+
+        const size_t globalSizes[2] = {(size_t) width, (size_t) (lastInput - firstInput)};
+
+        ret = clEnqueueNDRangeKernel(computeQueue, kernel, 2, NULL, globalSizes, NULL, 2, uploaded, &computed);
+        clReleaseEvent(uploaded[0]);
+        clReleaseEvent(uploaded[1]);
+
+        if (ret != CL_SUCCESS)
+            break;
+
+        clFlush(computeQueue);
+
+        // download strip rows without halo
+        ret = clEnqueueReadBuffer(downloadQueue, d_blurred[slot], CL_FALSE,
+                                  (firstRow - firstInput) * rowBytes, // skip upper halo
+                                  (lastRow - firstRow) * rowBytes,
+                                  output + firstRow * rowBytes,
+                                  1, &computed, &done);
+        clReleaseEvent(computed);
+
+        if (ret != CL_SUCCESS)
+            break;
+
+        clFlush(downloadQueue);
+
+        downloaded[slot] = done;
+    }
+
+    if (ret != CL_SUCCESS)
+        cout << "stream_blur: " << ret << "\n";
+
+    clFinish(uploadQueue);
+    clFinish(computeQueue);
+    clFinish(downloadQueue);
+
+    for (int slot = 0; slot < STREAM_SLOTS; slot++)
+    {
+        if (downloaded[slot])
+            clReleaseEvent(downloaded[slot]);
+
+        if (sizeUploaded[slot])
+            clReleaseEvent(sizeUploaded[slot]);
+
+        if (d_strip[slot])
+            clReleaseMemObject(d_strip[slot]);
+
+        if (d_blurred[slot])
+            clReleaseMemObject(d_blurred[slot]);
+
+        if (d_stripSize[slot])
+            clReleaseMemObject(d_stripSize[slot]);
+    }
+
+    clReleaseMemObject(d_masksize);
+    clReleaseCommandQueue(uploadQueue);
+    clReleaseCommandQueue(computeQueue);
+    clReleaseCommandQueue(downloadQueue);
+
+    return ret;
+}
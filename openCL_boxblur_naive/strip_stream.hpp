@@ -0,0 +1,26 @@
+// blurs images in horizontal strips so device memory does not limit the image size.
+
+#ifndef STRIP_STREAM_HPP
+#define STRIP_STREAM_HPP
+
+#include <CL/cl.h>
+
+// Blurs an image of width * height pixels with pixelBytes bytes per pixel
+// in strips of stripRows rows, using a kernel with the arguments
+// (image, imageSize, k, output) such as those of boxblur_rgba.cl.
+
+// Every strip is uploaded together with its up/down halo rows. Strips
+// alternate between STREAM_SLOTS sets of device buffers, and upload,
+// kernel and download run on separate command queues chained by events.
+// That way, uploading strip N+1 overlaps computing strip N and
+// downloading strip N-1. Device memory is bounded by the strip size.
+
+// stripRows == 0 picks the largest strip that fits the device memory.
+cl_int stream_blur (cl_context context, cl_device_id device, cl_kernel kernel,
+                    const unsigned char* image, unsigned char* output,
+                    cl_int width, cl_int height, cl_int pixelBytes, const cl_int* k, cl_int stripRows);
+
+// number of rows per strip used for stripRows == 0
+cl_int stream_strip_rows (cl_device_id device, cl_int width, cl_int height, cl_int pixelBytes, const cl_int* k);
+
+#endif
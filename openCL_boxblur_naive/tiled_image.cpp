@@ -0,0 +1,234 @@
+// memory-mapped tiled raw image files and conversion from/to PNG.
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iostream>
+
+#include "tiled_image.hpp"
+#include "host_utils.hpp"
+#include "png_ops.hpp"
+
+using namespace std;
+
+
+// map a whole file, the descriptor can be closed afterwards
+static bool map_file (int fd, bool writable, TiledImage* image)
+{
+    struct stat info;
+
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(TiledHeader))
+        return false;
+
+    void* map = mmap(NULL, info.st_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+
+    if (map == MAP_FAILED)
+        return false;
+
+    image->map = (unsigned char*) map;
+    image->mapBytes = info.st_size;
+    memcpy(&image->header, map, sizeof(TiledHeader));
+
+    return true;
+}
+
+
+bool tiled_create (const char* path, int width, int height, int channels, int tileWidth, int tileHeight, TiledImage* image)
+{
+    image->map = NULL;
+
+    TiledHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TILED_MAGIC, sizeof(header.magic));
+    header.width = width;
+    header.height = height;
+    header.channels = channels;
+    header.tileWidth = tileWidth;
+    header.tileHeight = tileHeight;
+    header.tilesX = (width + tileWidth - 1) / tileWidth;
+    header.tilesY = (height + tileHeight - 1) / tileHeight;
+    header.tileStride = round_up((size_t) tileWidth * tileHeight * channels, TILED_ALIGN);
+    header.dataOffset = round_up(sizeof(TiledHeader), TILED_ALIGN);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        cout << "tiled_create: cannot create " << path << "\n";
+        return false;
+    }
+
+    // the file starts sparse - tiles read as zero until they are written
+    size_t fileBytes = header.dataOffset + (size_t) header.tilesX * header.tilesY * header.tileStride;
+
+    bool created = ftruncate(fd, fileBytes) == 0 &&
+                   pwrite(fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header) &&
+                   map_file(fd, true, image);
+
+    close(fd);
+
+    if (!created)
+        cout << "tiled_create: cannot write " << path << "\n";
+
+    return created;
+}
+
+
+// check a header read from a file - every size the blur and the copies
+// derive from it has to stay inside of the mapping
+static bool valid_header (const TiledHeader& header, size_t mapBytes)
+{
+    if (memcmp(header.magic, TILED_MAGIC, sizeof(header.magic)) != 0)
+        return false;
+
+    if (header.channels != 1 && header.channels != 4)
+        return false;
+
+    // sizes are passed to the kernels as int
+    if (header.width == 0 || header.height == 0 || header.tileWidth == 0 || header.tileHeight == 0 ||
+        header.width > INT_MAX || header.height > INT_MAX || header.tileWidth > INT_MAX || header.tileHeight > INT_MAX)
+        return false;
+
+    if (header.tilesX != (header.width + (uint64_t) header.tileWidth - 1) / header.tileWidth ||
+        header.tilesY != (header.height + (uint64_t) header.tileHeight - 1) / header.tileHeight)
+        return false;
+
+    // tiles are page aligned, which also aligns every pixel
+    if (header.tileStride < (uint64_t) header.tileWidth * header.tileHeight * header.channels ||
+        header.tileStride % TILED_ALIGN != 0 ||
+        header.dataOffset < sizeof(TiledHeader) || header.dataOffset % TILED_ALIGN != 0 ||
+        header.dataOffset > mapBytes)
+        return false;
+
+    // tilesX * tilesY < 2^62 as width and height are below 2^31
+    return (uint64_t) header.tilesX * header.tilesY <= (mapBytes - header.dataOffset) / header.tileStride;
+}
+
+
+bool tiled_open (const char* path, bool writable, TiledImage* image)
+{
+    image->map = NULL;
+
+    int fd = open(path, writable ? O_RDWR : O_RDONLY);
+    if (fd < 0)
+    {
+        cout << "tiled_open: cannot open " << path << "\n";
+        return false;
+    }
+
+    bool mapped = map_file(fd, writable, image);
+    close(fd);
+
+    if (!mapped || !valid_header(image->header, image->mapBytes))
+    {
+        cout << "tiled_open: " << path << " is not a tiled image\n";
+        tiled_close(image);
+
+        return false;
+    }
+
+    return true;
+}
+
+
+void tiled_close (TiledImage* image)
+{
+    if (image->map)
+        munmap(image->map, image->mapBytes);
+
+    image->map = NULL;
+}
+
+
+unsigned char* tiled_tile_row (const TiledImage& image, int tileRow)
+{
+    return image.map + image.header.dataOffset + (size_t) tileRow * image.header.tilesX * image.header.tileStride;
+}
+
+
+// copy between a row-major image and the tiles (toTiles) or back
+static void copy_tiles (const TiledImage& image, unsigned char* pixels, bool toTiles)
+{
+    const TiledHeader& header = image.header;
+    size_t rowBytes = (size_t) header.width * header.channels;
+
+    for (uint32_t y = 0; y < header.height; y++)
+    {
+        unsigned char* tileRow = tiled_tile_row(image, y / header.tileHeight) + (size_t) (y % header.tileHeight) * header.tileWidth * header.channels;
+
+        for (uint32_t tx = 0; tx < header.tilesX; tx++)
+        {
+            uint32_t x = tx * header.tileWidth;
+            size_t bytes = (size_t) min(header.tileWidth, header.width - x) * header.channels;
+
+            unsigned char* tile = tileRow + (size_t) tx * header.tileStride;
+            unsigned char* row = pixels + y * rowBytes + (size_t) x * header.channels;
+
+            if (toTiles)
+                memcpy(tile, row, bytes);
+            else
+                memcpy(row, tile, bytes);
+        }
+    }
+}
+
+
+unsigned char* tiled_load (const TiledImage& image)
+{
+    unsigned char* pixels = (unsigned char*) malloc ((size_t) image.header.width * image.header.height * image.header.channels);
+
+    if (pixels)
+        copy_tiles(image, pixels, false);
+
+    return pixels;
+}
+
+
+void tiled_store (TiledImage* image, const unsigned char* pixels)
+{
+    copy_tiles(*image, (unsigned char*) pixels, true);
+}
+
+
+bool tiled_from_png (const char* pngFile, const char* tiledFile, int tileWidth, int tileHeight)
+{
+    int width, height, channels;
+    unsigned char* pixels = load_png(pngFile, &width, &height, &channels);
+
+    if (!pixels)
+        return false;
+
+    TiledImage image;
+    bool converted = tiled_create(tiledFile, width, height, channels, tileWidth, tileHeight, &image);
+
+    if (converted)
+    {
+        tiled_store(&image, pixels);
+        tiled_close(&image);
+    }
+
+    free(pixels);
+
+    return converted;
+}
+
+
+bool tiled_to_png (const char* tiledFile, const char* pngFile)
+{
+    TiledImage image;
+
+    if (!tiled_open(tiledFile, false, &image))
+        return false;
+
+    unsigned char* pixels = tiled_load(image);
+    bool converted = pixels && save_png(pngFile, pixels, image.header.width, image.header.height, image.header.channels);
+
+    free(pixels);
+    tiled_close(&image);
+
+    return converted;
+}
@@ -0,0 +1,61 @@
+// memory-mapped tiled raw image files and conversion from/to PNG.
+
+#ifndef TILED_IMAGE_HPP
+#define TILED_IMAGE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TILED_MAGIC "BBTILES1"
+#define TILED_ALIGN 4096 // tiles start at multiples of this (page size), so strips can be mapped and used in place
+
+// Header at the start of a tiled file. The image is cut into tilesX * tilesY
+// tiles of tileWidth * tileHeight pixels, stored tile row by tile row, left to
+// right. Pixels are row-major within a tile, 8 bit per channel. Tiles at the
+// right and bottom edge are padded to full size with zeros.
+struct TiledHeader
+{
+    char magic[8]; // TILED_MAGIC without terminating 0
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels; // 1 (grayscale) or 4 (RGBA)
+    uint32_t tileWidth;
+    uint32_t tileHeight;
+    uint32_t tilesX;
+    uint32_t tilesY;
+    uint32_t tileStride; // bytes from one tile to the next - tile size rounded up to TILED_ALIGN
+    uint64_t dataOffset; // first tile
+};
+
+// mapped tiled file - pages are only read from disk once they are touched
+struct TiledImage
+{
+    TiledHeader header;
+    unsigned char* map; // whole file, NULL if not open
+    size_t mapBytes;
+};
+
+// create a tiled file with zero pixels and map it writable
+bool tiled_create (const char* path, int width, int height, int channels, int tileWidth, int tileHeight, TiledImage* image);
+
+// map an existing tiled file, read-only unless writable - files whose header
+// does not describe a layout of this format inside of the file are rejected
+bool tiled_open (const char* path, bool writable, TiledImage* image);
+
+// unmap (changes of writable images are written back by the page cache)
+void tiled_close (TiledImage* image);
+
+// first byte of a row of tiles - consecutive tile rows are contiguous
+unsigned char* tiled_tile_row (const TiledImage& image, int tileRow);
+
+// copy all pixels into a malloc'ed buffer of width * height * channels bytes, row by row
+unsigned char* tiled_load (const TiledImage& image);
+
+// copy width * height * channels bytes, row by row, into the tiles
+void tiled_store (TiledImage* image, const unsigned char* pixels);
+
+// converters - PNG files are normalized to grayscale or RGBA (see png_ops.hpp)
+bool tiled_from_png (const char* pngFile, const char* tiledFile, int tileWidth, int tileHeight);
+bool tiled_to_png (const char* tiledFile, const char* pngFile);
+
+#endif
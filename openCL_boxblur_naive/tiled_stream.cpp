@@ -0,0 +1,199 @@
+// blurs memory-mapped tiled images strip by strip, in place of the mapping.
+
+#include <CL/cl.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <iostream>
+
+#include "tiled_stream.hpp"
+
+using namespace std;
+
+#define STRIPS_IN_FLIGHT 2 // strips enqueued before waiting for the oldest one
+
+
+// buffers of one strip
+struct TiledStrip
+{
+    cl_mem above; // copy of the input tile rows above the strip, NULL if none
+    cl_mem center; // input tile row of the strip, on the input mapping
+    cl_mem below; // copy of the input tile rows below the strip, NULL if none
+    cl_mem strip; // output tile row, on the output mapping
+    cl_mem tiles; // layout, see boxblur_tiled.cl
+    cl_int layout[8];
+    cl_event mapped; // output visible in the mapping
+    void* mappedPtr;
+};
+
+
+// wait for a strip and release its buffers
+static cl_int retire_strip (cl_command_queue queue, TiledStrip* strip)
+{
+    cl_int ret = CL_SUCCESS;
+
+    if (strip->mapped)
+    {
+        ret = clWaitForEvents(1, &strip->mapped);
+        clReleaseEvent(strip->mapped);
+
+        clEnqueueUnmapMemObject(queue, strip->strip, strip->mappedPtr, 0, NULL, NULL);
+    }
+
+    // buffers live on until the unmap is done
+    cl_mem mems[] = {strip->above, strip->center, strip->below, strip->strip, strip->tiles};
+
+    for (int i = 0; i < 5; i++)
+        if (mems[i])
+            clReleaseMemObject(mems[i]);
+
+    strip->above = strip->center = strip->below = strip->strip = strip->tiles = NULL;
+    strip->mapped = NULL;
+
+    return ret;
+}
+
+
+// tile rows of the band of strip tileRow - first and last
+static void band_rows (const TiledHeader& header, const cl_int* k, cl_int tileRow, cl_int* first, cl_int* last)
+{
+    cl_int haloUp = (k[1] + header.tileHeight - 1) / header.tileHeight;
+    cl_int haloDown = (k[3] + header.tileHeight - 1) / header.tileHeight;
+
+    *first = max(tileRow - haloUp, 0);
+    *last = min(tileRow + haloDown, (cl_int) header.tilesY - 1);
+}
+
+
+cl_int tiled_blur (cl_context context, cl_device_id device, cl_program program,
+                   const TiledImage& input, const TiledImage& output, const cl_int* k)
+{
+    cl_int ret;
+    const TiledHeader& header = input.header;
+    size_t tileRowBytes = (size_t) header.tilesX * header.tileStride;
+
+    cl_command_queue queue = clCreateCommandQueue(context, device, 0, &ret);
+    if (ret != CL_SUCCESS)
+        return ret;
+
+    cl_kernel kernel = clCreateKernel(program, header.channels == 1 ? "boxblur_gray" : "boxblur", &ret);
+    cl_mem d_mask = NULL;
+
+    if (ret == CL_SUCCESS)
+        d_mask = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, 4 * sizeof(cl_int), (void*) k, &ret);
+
+    TiledStrip strips[STRIPS_IN_FLIGHT];
+
+    for (int s = 0; s < STRIPS_IN_FLIGHT; s++)
+    {
+        strips[s].above = strips[s].center = strips[s].below = strips[s].strip = strips[s].tiles = NULL;
+        strips[s].mapped = NULL;
+    }
+
+    for (cl_int tileRow = 0; tileRow < (cl_int) header.tilesY && ret == CL_SUCCESS; tileRow++)
+    {
+        TiledStrip& strip = strips[tileRow % STRIPS_IN_FLIGHT];
+
+        ret = retire_strip(queue, &strip);
+        if (ret != CL_SUCCESS)
+            break;
+
+        cl_int first, last;
+        band_rows(header, k, tileRow, &first, &last);
+
+        // page in the next band while this one is computed
+        if (tileRow + 1 < (cl_int) header.tilesY)
+        {
+            cl_int nextFirst, nextLast;
+            band_rows(header, k, tileRow + 1, &nextFirst, &nextLast);
+
+            madvise(tiled_tile_row(input, nextFirst), (nextLast - nextFirst + 1) * tileRowBytes, MADV_WILLNEED);
+        }
+
+        // bands of strips in flight overlap, but buffers on overlapping host memory
+        // must not be used at the same time - only the tile row of the strip is used
+        // in place, the halo tile rows are copied when the buffers are created
+        strip.center = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
+                                      tileRowBytes, tiled_tile_row(input, tileRow), &ret);
+        if (ret != CL_SUCCESS)
+            break;
+
+        if (first < tileRow)
+        {
+            strip.above = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                         (tileRow - first) * tileRowBytes, tiled_tile_row(input, first), &ret);
+            if (ret != CL_SUCCESS)
+                break;
+        }
+
+        if (last > tileRow)
+        {
+            strip.below = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                         (last - tileRow) * tileRowBytes, tiled_tile_row(input, tileRow + 1), &ret);
+            if (ret != CL_SUCCESS)
+                break;
+        }
+
+        strip.strip = clCreateBuffer(context, CL_MEM_WRITE_ONLY | CL_MEM_USE_HOST_PTR,
+                                     tileRowBytes, tiled_tile_row(output, tileRow), &ret);
+        if (ret != CL_SUCCESS)
+            break;
+
+        strip.layout[0] = header.width;
+        strip.layout[1] = header.height;
+        strip.layout[2] = header.tileWidth;
+        strip.layout[3] = header.tileHeight;
+        strip.layout[4] = header.tilesX;
+        strip.layout[5] = header.tileStride / header.channels; // pixels - TILED_ALIGN is a multiple of every pixel size
+        strip.layout[6] = first * header.tileHeight;
+        strip.layout[7] = tileRow * header.tileHeight;
+
+        strip.tiles = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(strip.layout), strip.layout, &ret);
+        if (ret != CL_SUCCESS)
+            break;
+
+        // a missing halo is never read - pass the center instead
+        clSetKernelArg(kernel, 0, sizeof(cl_mem), (void*) (strip.above ? &strip.above : &strip.center));
+        clSetKernelArg(kernel, 1, sizeof(cl_mem), (void*) &strip.center);
+        clSetKernelArg(kernel, 2, sizeof(cl_mem), (void*) (strip.below ? &strip.below : &strip.center));
+        clSetKernelArg(kernel, 3, sizeof(cl_mem), (void*) &strip.tiles);
+        clSetKernelArg(kernel, 4, sizeof(cl_mem), (void*) &d_mask);
+        clSetKernelArg(kernel, 5, sizeof(cl_mem), (void*) &strip.strip);
+
+        // one work item per pixel of the strip
+        const size_t globalSizes[2] = {header.width, min(header.tileHeight, header.height - strip.layout[7])};
+
+        ret = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, globalSizes, NULL, 0, NULL, NULL);
+        if (ret != CL_SUCCESS)
+            break;
+
+        // mapping makes the result visible in the host memory behind the buffer
+        strip.mappedPtr = clEnqueueMapBuffer(queue, strip.strip, CL_FALSE, CL_MAP_READ, 0, tileRowBytes, 0, NULL, &strip.mapped, &ret);
+        if (ret != CL_SUCCESS)
+            break;
+
+        clFlush(queue);
+    }
+
+    for (int s = 0; s < STRIPS_IN_FLIGHT; s++)
+    {
+        cl_int retired = retire_strip(queue, &strips[s]);
+
+        if (ret == CL_SUCCESS)
+            ret = retired;
+    }
+
+    clFinish(queue);
+
+    if (d_mask)
+        clReleaseMemObject(d_mask);
+
+    if (kernel)
+        clReleaseKernel(kernel);
+
+    clReleaseCommandQueue(queue);
+
+    if (ret != CL_SUCCESS)
+        cout << "tiled_blur: " << ret << "\n";
+
+    return ret;
+}
@@ -0,0 +1,24 @@
+// blurs memory-mapped tiled images strip by strip, in place of the mapping.
+
+#ifndef TILED_STREAM_HPP
+#define TILED_STREAM_HPP
+
+#include <CL/cl.h>
+
+#include "tiled_image.hpp"
+
+// Blurs input into output (same size, channels and tiles) with the kernels
+// of boxblur_tiled.cl, one row of tiles (strip) per launch.
+
+// Device buffers are created with CL_MEM_USE_HOST_PTR straight on the
+// mappings - the input tile row of a strip and the output tile row. Nothing
+// is parsed or rearranged on the host, and devices sharing memory with the
+// host read and write the page cache directly. The tile rows above and below
+// the strip that the mask reaches into are also part of the bands of the
+// neighboring strips, so they are copied into their own buffers instead.
+// Only the tile rows of the strips in flight are paged in, the next band is
+// prefetched with madvise.
+cl_int tiled_blur (cl_context context, cl_device_id device, cl_program program,
+                   const TiledImage& input, const TiledImage& output, const cl_int* k);
+
+#endif
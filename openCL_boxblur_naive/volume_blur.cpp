@@ -0,0 +1,121 @@
+// 3D box blur and stencils of volumes with 2.5D blocking.
+
+#include <CL/cl.h>
+#include <algorithm>
+#include <iostream>
+
+#include "volume_blur.hpp"
+#include "host_utils.hpp"
+
+using namespace std;
+
+
+// local memory of a work group - plane tile with halo and ring of plane sums
+static size_t volume_localmem (const size_t* localSize, const cl_int* k)
+{
+    size_t tile = (localSize[0] + k[0] + k[2]) * (localSize[1] + k[1] + k[3]);
+    size_t ring = localSize[0] * localSize[1] * (k[4] + 1 + k[5]);
+
+    return (tile + ring) * sizeof(cl_int);
+}
+
+
+cl_int volume_blur (cl_context context, cl_device_id device, cl_program program,
+                    const cl_int* volume, cl_int* output, cl_int width, cl_int height, cl_int depth,
+                    const cl_int* k, const size_t* localSize, cl_int blockDepth)
+{
+    cl_int ret;
+    cl_int volumeSize[3] = {width, height, depth};
+    size_t volumeBytes = (size_t) width * height * depth * sizeof(cl_int);
+
+    if (blockDepth <= 0 || blockDepth > depth)
+        blockDepth = depth;
+
+    cl_kernel kernel = clCreateKernel(program, "boxblur_volume", &ret);
+    if (ret != CL_SUCCESS)
+    {
+        cout << "volume_blur: " << ret << "\n";
+        return ret;
+    }
+
+    cl_command_queue queue = clCreateCommandQueue(context, device, 0, &ret);
+
+    cl_ulong maxLocalmem = 0;
+    size_t maxGroupSize = 1;
+    clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &maxLocalmem, NULL);
+    clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &maxGroupSize, NULL);
+
+    // halve the larger side of the work group until it fits
+    size_t groupSize[3] = {max(localSize[0], (size_t) 1), max(localSize[1], (size_t) 1), 1};
+
+    while ((groupSize[0] * groupSize[1] > maxGroupSize || volume_localmem(groupSize, k) > maxLocalmem) &&
+           groupSize[0] * groupSize[1] > 1)
+    {
+        if (groupSize[1] >= groupSize[0])
+            groupSize[1] /= 2;
+        else
+            groupSize[0] /= 2;
+    }
+
+    if (ret == CL_SUCCESS && volume_localmem(groupSize, k) > maxLocalmem)
+        ret = CL_OUT_OF_RESOURCES;
+
+    if (groupSize[0] != localSize[0] || groupSize[1] != localSize[1])
+        cout << "volume_blur: using work groups of " << groupSize[0] << "x" << groupSize[1] << "\n";
+
+    cl_mem d_volume = NULL, d_volumeSize = NULL, d_mask = NULL, d_blockDepth = NULL, d_output = NULL;
+
+    if (ret == CL_SUCCESS)
+        d_volume = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, volumeBytes, (void*) volume, &ret);
+
+    if (ret == CL_SUCCESS)
+        d_volumeSize = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(volumeSize), volumeSize, &ret);
+
+    if (ret == CL_SUCCESS)
+        d_mask = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, 6 * sizeof(cl_int), (void*) k, &ret);
+
+    if (ret == CL_SUCCESS)
+        d_blockDepth = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(cl_int), &blockDepth, &ret);
+
+    if (ret == CL_SUCCESS)
+        d_output = clCreateBuffer(context, CL_MEM_WRITE_ONLY, volumeBytes, NULL, &ret);
+
+    if (ret == CL_SUCCESS)
+    {
+        size_t tileBytes = (groupSize[0] + k[0] + k[2]) * (groupSize[1] + k[1] + k[3]) * sizeof(cl_int);
+        size_t ringBytes = groupSize[0] * groupSize[1] * (k[4] + 1 + k[5]) * sizeof(cl_int);
+
+        clSetKernelArg(kernel, 0, sizeof(cl_mem), (void*) &d_volume);
+        clSetKernelArg(kernel, 1, sizeof(cl_mem), (void*) &d_volumeSize);
+        clSetKernelArg(kernel, 2, sizeof(cl_mem), (void*) &d_mask);
+        clSetKernelArg(kernel, 3, sizeof(cl_mem), (void*) &d_blockDepth);
+        clSetKernelArg(kernel, 4, tileBytes, NULL);
+        clSetKernelArg(kernel, 5, ringBytes, NULL);
+        clSetKernelArg(kernel, 6, sizeof(cl_mem), (void*) &d_output);
+
+        // xy rounded up to whole work groups, one work item per block of planes in z
+        const size_t globalSizes[3] = {round_up(width, groupSize[0]),
+                                       round_up(height, groupSize[1]),
+                                       (size_t) (depth + blockDepth - 1) / blockDepth};
+
+        ret = clEnqueueNDRangeKernel(queue, kernel, 3, NULL, globalSizes, groupSize, 0, NULL, NULL);
+    }
+
+    if (ret == CL_SUCCESS)
+        ret = clEnqueueReadBuffer(queue, d_output, CL_TRUE, 0, volumeBytes, output, 0, NULL, NULL);
+
+    if (ret != CL_SUCCESS)
+        cout << "volume_blur: " << ret << "\n";
+
+    clFinish(queue);
+
+    cl_mem buffers[] = {d_volume, d_volumeSize, d_mask, d_blockDepth, d_output};
+    for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++)
+        if (buffers[i])
+            clReleaseMemObject(buffers[i]);
+
+    clReleaseKernel(kernel);
+    clReleaseCommandQueue(queue);
+
+    return ret;
+}
@@ -0,0 +1,23 @@
+// 3D box blur and stencils of volumes with 2.5D blocking.
+
+#ifndef VOLUME_BLUR_HPP
+#define VOLUME_BLUR_HPP
+
+#include <CL/cl.h>
+
+// Blurs a volume of width * height * depth values, stored plane by plane,
+// into output with the kernel "boxblur_volume" of program - boxblur_volume.cl
+// for the box mask k = {left, up, right, down, front, back}, or a kernel of
+// generate_volume_stencil_source (then k is the extent of the stencil).
+
+// The NDRange is three-dimensional: work groups of localSize[0] * localSize[1]
+// work items tile the xy plane, the third dimension splits the depth into
+// blocks of blockDepth planes (blockDepth <= 0: one block) that a work group
+// streams through. Smaller blocks give more work groups, but every block
+// re-reads front + back planes. The local size is reduced if the tile, its
+// halo and the ring of plane sums do not fit into the device's local memory.
+cl_int volume_blur (cl_context context, cl_device_id device, cl_program program,
+                    const cl_int* volume, cl_int* output, cl_int width, cl_int height, cl_int depth,
+                    const cl_int* k, const size_t* localSize, cl_int blockDepth);
+
+#endif